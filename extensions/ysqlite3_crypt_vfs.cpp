@@ -1,4 +1,5 @@
 #include <ysqlite3/vfs/crypt_file.hpp>
+#include <ysqlite3/vfs/pipeline_vfs.hpp>
 #include <ysqlite3/vfs/sqlite3_file_wrapper.hpp>
 #include <ysqlite3/vfs/sqlite3_vfs_wrapper.hpp>
 
@@ -51,3 +52,27 @@ __declspec(dllexport)
 
 	return SQLITE_OK_LOAD_PERMANENTLY;
 }
+
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+    extern "C" int ysqlite3_register_pipeline_vfs(sqlite3* db, char** error_message,
+                                                  const sqlite3_api_routines* api) noexcept
+{
+	SQLITE_EXTENSION_INIT2(api);
+
+	// check version
+	if (sqlite3_libversion_number() < 3032000) {
+		*error_message = sqlite3_mprintf("incompatible SQLite3 version; min 3.32.0");
+		return SQLITE_ERROR;
+	}
+
+	try {
+		vfs::register_vfs(std::make_shared<vfs::Pipeline_vfs>(vfs::find_vfs(nullptr), YSQLITE3_PIPELINE_VFS_NAME),
+		                  false);
+	} catch (...) {
+		return SQLITE_ERROR;
+	}
+
+	return SQLITE_OK_LOAD_PERMANENTLY;
+}
@@ -1,4 +1,10 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ysqlite3/csv_loader.hpp>
 #include <ysqlite3/vfs/crypt_file.hpp>
+#include <ysqlite3/vfs/pipeline_vfs.hpp>
 #include <ysqlite3/vfs/sqlite3_file_wrapper.hpp>
 #include <ysqlite3/vfs/sqlite3_vfs_wrapper.hpp>
 
@@ -11,8 +17,52 @@ extern "C" int ysqlite3_init() noexcept
 		    std::make_shared<vfs::SQLite3_vfs_wrapper<vfs::Crypt_file<vfs::SQLite3_file_wrapper>>>(
 		        vfs::find_vfs(nullptr), YSQLITE3_CRYPT_VFS_NAME),
 		    false);
+		vfs::register_vfs(std::make_shared<vfs::Pipeline_vfs>(vfs::find_vfs(nullptr), YSQLITE3_PIPELINE_VFS_NAME),
+		                  false);
 	} catch (...) {
 		return SQLITE_ERROR;
 	}
 	return SQLITE_OK;
 }
+
+/// Implements `.bulkload FILE TABLE ?--header? ?--threads N? ?--tsv?` of the shell.
+extern "C" int ysqlite3_bulkload(sqlite3* database, int argc, char** argv, std::FILE* out) noexcept
+{
+	const char* file  = nullptr;
+	const char* table = nullptr;
+	Csv_options options;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--header") == 0) {
+			options.header = true;
+		} else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			options.threads = std::strtoul(argv[++i], nullptr, 10);
+		} else if (std::strcmp(argv[i], "--tsv") == 0) {
+			options.separator = '\t';
+		} else if (argv[i][0] != '-' && !file) {
+			file = argv[i];
+		} else if (argv[i][0] != '-' && !table) {
+			table = argv[i];
+		} else {
+			std::fprintf(stderr, "Error: unknown option: %s\n", argv[i]);
+			table = nullptr;
+			break;
+		}
+	}
+	if (!table) {
+		std::fprintf(stderr, "Usage: .bulkload FILE TABLE ?--header? ?--threads N? ?--tsv?\n");
+		return 1;
+	}
+
+	try {
+		const auto status  = load_csv(database, file, table, options);
+		const auto seconds = [](std::chrono::nanoseconds time) { return time.count() / 1e9; };
+		std::fprintf(out,
+		             "%llu rows in %.3f s (%.0f rows/s); parsing %.3f s over all threads, inserting %.3f s\n",
+		             static_cast<unsigned long long>(status.rows), seconds(status.elapsed),
+		             status.rows_per_second(), seconds(status.parse_time), seconds(status.insert_time));
+	} catch (const std::exception& e) {
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -15045,6 +15045,13 @@ static const char *(azHelp[]) = {
   "       --async             Write to FILE without journal and fsync()",
   ".bail on|off             Stop after hitting an error.  Default OFF",
   ".binary on|off           Turn binary output on or off.  Default OFF",
+  ".bulkload FILE TABLE     Load CSV from FILE into TABLE with parallel parsing",
+  "   Options:",
+  "     --header              The first row names the columns",
+  "     --threads N           Parse with N threads.  Default: one per core",
+  "     --tsv                 Use \\t instead of , as column separator",
+  "   Notes:",
+  "     *  If TABLE does not exist, it is created with inferred column types.",
   ".cd DIRECTORY            Change the working directory to DIRECTORY",
   ".changes on|off          Show number of rows changed by SQL",
   ".check GLOB              Fail if output since .testcase does not match",
@@ -18778,6 +18785,14 @@ static int do_meta_command(char *zLine, ShellState *p){
     test_breakpoint();
   }else
 
+  if( c=='b' && n>=3 && strncmp(azArg[0], "bulkload", n)==0 ){
+    /* Implemented with the ysqlite3 library in entrypoint.cpp */
+    extern int ysqlite3_bulkload(sqlite3*, int, char**, FILE*);
+    failIfSafeMode(p, "cannot run .bulkload in safe mode");
+    open_db(p, 0);
+    rc = ysqlite3_bulkload(p->db, nArg, azArg, p->out);
+  }else
+
   if( c=='c' && strcmp(azArg[0],"cd")==0 ){
     failIfSafeMode(p, "cannot run .cd in safe mode");
     if( nArg==2 ){
@@ -0,0 +1,1094 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <ysqlite3/arrow.hpp>
+#include <ysqlite3/async_database.hpp>
+#include <ysqlite3/blob_stream.hpp>
+#include <ysqlite3/connection_pool.hpp>
+#include <ysqlite3/csv_loader.hpp>
+#include <ysqlite3/database.hpp>
+#include <ysqlite3/table_exporter.hpp>
+#include <ysqlite3/transaction.hpp>
+#include <ysqlite3/writer_queue.hpp>
+
+using namespace ysqlite3;
+
+TEST_CASE("statement cache")
+{
+	Database db{ ":memory:" };
+	db.execute("CREATE TABLE t(a INTEGER)");
+	db.set_statement_cache_size(2);
+
+	const char* insert = "INSERT INTO t(a) VALUES(?)";
+	for (sqlite3_int64 i = 0; i < 10; ++i) {
+		auto stmt = db.prepare_cached(insert);
+		stmt.bind(0, i);
+		stmt.finish();
+	}
+	REQUIRE(db.statement_cache_status().misses == 1);
+	REQUIRE(db.statement_cache_status().hits == 9);
+	REQUIRE(db.statement_cache_status().size == 1);
+
+	// returned statements are reset and have no bindings
+	sqlite3_stmt* handle = nullptr;
+	{
+		auto stmt = db.prepare_cached("SELECT ?, count(*) FROM t");
+		stmt.bind(0, sqlite3_int64{ 42 });
+		REQUIRE(stmt.step().integer(0) == 42);
+		handle = stmt.handle();
+	}
+	{
+		auto stmt = db.prepare_cached("SELECT ?, count(*) FROM t");
+		REQUIRE(stmt.handle() == handle);
+		auto results = stmt.step();
+		REQUIRE(results.is_null(0));
+		REQUIRE(results.integer(1) == 10);
+
+		// the same SQL may be used twice at once
+		auto other = db.prepare_cached("SELECT ?, count(*) FROM t");
+		REQUIRE(other.handle() != handle);
+	}
+	REQUIRE(db.statement_cache_status().size == 2);
+
+	// least recently used is evicted
+	db.prepare_cached("SELECT 1");
+	REQUIRE(db.statement_cache_status().size == 2);
+	db.prepare_cached(insert);
+	REQUIRE(db.statement_cache_status().misses == 5);
+
+	// schema changes recompile the statements
+	{
+		auto stmt = db.prepare_cached("SELECT * FROM t");
+		REQUIRE(stmt.column_count() == 1);
+	}
+	db.execute("ALTER TABLE t ADD COLUMN b TEXT DEFAULT 'x'");
+	{
+		auto stmt = db.prepare_cached("SELECT * FROM t");
+		auto results = stmt.step();
+		REQUIRE(results.text(1) == std::string{ "x" });
+		REQUIRE(stmt.column_count() == 2);
+	}
+
+	// idle statements do not keep the database open
+	db.close();
+	REQUIRE(db.statement_cache_status().size == 0);
+
+	// statements outliving the database are finalized
+	db.open(":memory:");
+	auto stmt = db.prepare_cached("SELECT 1");
+	db.close(true);
+}
+
+TEST_CASE("connection pool")
+{
+	std::remove("pool.db");
+	std::remove("pool.db-wal");
+	std::remove("pool.db-shm");
+
+	Connection_pool_options options;
+	options.readers = 2;
+	options.warm_statements.push_back("SELECT count(*) FROM t");
+	{
+		Database db{ "pool.db" };
+		db.execute("CREATE TABLE t(a INTEGER)");
+	}
+	Connection_pool pool{ "file:pool.db", options };
+
+	// readers never wait for the writer
+	auto writer = pool.write();
+	writer->execute("BEGIN IMMEDIATE");
+	writer->execute("INSERT INTO t(a) VALUES(1)");
+	{
+		auto reader = pool.read();
+		REQUIRE(reader->prepare_cached("SELECT count(*) FROM t").step().integer(0) == 0);
+		REQUIRE(reader->statement_cache_status().hits == 1);
+		REQUIRE_THROWS(reader->execute("INSERT INTO t(a) VALUES(2)"));
+	}
+	writer->execute("COMMIT");
+
+	{
+		Transaction transaction{ writer.shared() };
+		writer->execute("INSERT INTO t(a) VALUES(2)");
+		transaction.commit();
+	}
+
+	// a transaction left open is rolled back
+	writer->execute("BEGIN");
+	writer->execute("INSERT INTO t(a) VALUES(3)");
+	writer.release();
+	REQUIRE(pool.read()->prepare_cached("SELECT count(*) FROM t").step().integer(0) == 2);
+
+	// a busy statement is reset
+	{
+		auto reader = pool.read();
+		auto stmt   = reader->prepare_statement("SELECT a FROM t");
+		REQUIRE(stmt.step());
+		reader.release();
+		REQUIRE(!sqlite3_stmt_busy(stmt.handle()));
+	}
+
+	// all readers are checked out
+	{
+		auto first  = pool.read();
+		auto second = pool.read();
+		std::thread waiting{ [&] { pool.read(); } };
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+		first.release();
+		waiting.join();
+		REQUIRE(pool.status().read_waits == 1);
+		REQUIRE(pool.status().read_wait_time.count() > 0);
+	}
+
+	std::atomic<int> sum{ 0 };
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 8; ++i) {
+		threads.emplace_back([&] {
+			for (int j = 0; j < 100; ++j) {
+				auto reader = pool.read();
+				sum += static_cast<int>(reader->prepare_cached("SELECT count(*) FROM t").step().integer(0));
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	REQUIRE(sum == 1600);
+
+	const auto status = pool.status();
+	REQUIRE(status.readers == 2);
+	REQUIRE(status.readers_in_use == 0);
+	REQUIRE(!status.writer_in_use);
+	REQUIRE(status.read_checkouts == 806);
+	REQUIRE(status.write_checkouts == 1);
+	REQUIRE(status.reopened == 0);
+}
+
+TEST_CASE("async database")
+{
+	Async_database db{ Database{ ":memory:" } };
+	db.async_execute("CREATE TABLE t(a INTEGER, b TEXT)");
+	for (int i = 0; i < 10; ++i) {
+		db.async_query("INSERT INTO t(a, b) VALUES(?, 'x')",
+		               [i](Statement& statement) { statement.bind(0, sqlite3_int64{ i }); });
+	}
+
+	// tasks run in order
+	auto result = db.async_query("SELECT a, b FROM t WHERE a >= ? ORDER BY a",
+	                             [](Statement& statement) { statement.bind(0, sqlite3_int64{ 5 }); })
+	                  .get();
+	REQUIRE(result.done);
+	REQUIRE(result.columns.size() == 2);
+	REQUIRE(result.rows.size() == 5);
+	REQUIRE(result.rows[0].integer(0) == 5);
+	REQUIRE(result.rows[0].text(1) == std::string{ "x" });
+	REQUIRE_THROWS(result.rows[0].integer(2));
+
+	REQUIRE_THROWS_AS(db.async_execute("SELECT * FROM missing").get(), std::system_error);
+
+	// batches
+	auto cursor = db.cursor("SELECT a FROM t ORDER BY a");
+	auto first  = db.async_step_batch(cursor, 4);
+	auto second = db.async_step_batch(cursor, 4);
+	auto third  = db.async_step_batch(cursor, 4);
+	REQUIRE(first.get().rows.size() == 4);
+	REQUIRE(second.get().rows[0].integer(0) == 4);
+	result = third.get();
+	REQUIRE(result.rows.size() == 2);
+	REQUIRE(result.done);
+
+	// callbacks
+	std::promise<std::size_t> rows;
+	db.async_execute("SELECT a FROM t",
+	                 [&](std::exception_ptr error, std::size_t count) { rows.set_value(error ? 0 : count); });
+	REQUIRE(rows.get_future().get() == 10);
+
+	// cancellation of a queued task
+	Cancellation cancelled;
+	cancelled.cancel();
+	try {
+		db.async_execute("SELECT 1", cancelled).get();
+		FAIL();
+	} catch (const std::system_error& e) {
+		REQUIRE(e.code() == SQLite3_code::operation_interrupted);
+	}
+
+	// cancellation of a running task
+	Cancellation cancellation;
+	auto endless = db.async_query("WITH RECURSIVE r(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM r) "
+	                              "SELECT count(*) FROM r",
+	                              nullptr, cancellation);
+	std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+	cancellation.cancel();
+	try {
+		endless.get();
+		FAIL();
+	} catch (const std::system_error& e) {
+		REQUIRE(e.code() == SQLite3_code::operation_interrupted);
+	}
+	REQUIRE(db.async_query("SELECT count(*) FROM t").get().rows[0].integer(0) == 10);
+
+	// a task which the executor rejected does not run later
+	struct Rejecting_executor : Executor
+	{
+		bool reject = true;
+
+		void post(std::function<void()> task) override
+		{
+			if (reject) {
+				throw std::system_error{ Error::bad_arguments };
+			}
+			task();
+		}
+	};
+	const auto rejecting = std::make_shared<Rejecting_executor>();
+	Async_database rejected{ Database{ ":memory:" }, rejecting };
+	int callbacks       = 0;
+	const auto callback = [&callbacks](std::exception_ptr, std::size_t) { ++callbacks; };
+	REQUIRE_THROWS_AS(rejected.async_execute("CREATE TABLE r(a)", callback), std::system_error);
+	rejecting->reject = false;
+	REQUIRE(rejected.async_query("SELECT count(*) FROM sqlite_master").get().rows[0].integer(0) == 0);
+	REQUIRE(callbacks == 0);
+
+	// many databases share one executor
+	const auto executor = std::make_shared<Thread_executor>(4);
+	std::vector<std::unique_ptr<Async_database>> databases;
+	std::vector<std::future<Query_result>> results;
+	for (int i = 0; i < 8; ++i) {
+		databases.emplace_back(new Async_database{ Database{ ":memory:" }, executor });
+		for (int j = 0; j < 20; ++j) {
+			results.push_back(databases.back()->async_query("SELECT ?",
+			                                                [j](Statement& statement) {
+				                                                statement.bind(0, sqlite3_int64{ j });
+			                                                }));
+		}
+	}
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		REQUIRE(results[i].get().rows[0].integer(0) == static_cast<sqlite3_int64>(i % 20));
+	}
+}
+
+TEST_CASE("execute many")
+{
+	Database db{ ":memory:" };
+	db.execute("CREATE TABLE t(a INTEGER, b REAL, c TEXT, d BLOB)");
+
+	std::vector<sqlite3_int64> a;
+	std::vector<double> b;
+	std::vector<std::string> c;
+	std::vector<std::vector<std::uint8_t>> d;
+	std::vector<bool> nulls;
+	for (int i = 0; i < 1000; ++i) {
+		a.push_back(i);
+		b.push_back(i / 2.0);
+		c.push_back(std::to_string(i));
+		d.push_back({ static_cast<std::uint8_t>(i) });
+		nulls.push_back(i % 10 == 0);
+	}
+
+	Bulk_options options;
+	options.rows_per_transaction = 300;
+	auto insert = db.prepare_statement("insert into t(a, b, c, d) values (?, ?, ?,?);");
+	auto status = insert.execute_many({ a, b, c, Bulk_column{ d }.set_nulls(nulls) }, options);
+	REQUIRE(status.rows == 1000);
+	REQUIRE(status.rows_per_statement == 64);
+	REQUIRE(status.transactions == 4);
+	REQUIRE(status.statements < 1000 / 64 + 4 * 64);
+	REQUIRE(status.rows_per_second() > 0);
+
+	auto check = db.prepare_statement("SELECT count(*), sum(a), sum(b), count(d), sum(length(c)) FROM t");
+	auto results = check.step();
+	REQUIRE(results.integer(0) == 1000);
+	REQUIRE(results.integer(1) == 499500);
+	REQUIRE(results.real(2) == 249750.0);
+	REQUIRE(results.integer(3) == 900);
+	check.reset();
+
+	// rows of a query; the statement is not rewritten inside a transaction
+	std::vector<Row> rows;
+	auto select = db.prepare_statement("SELECT a + 1000, b, c, d FROM t");
+	while (select.step()) {
+		rows.emplace_back(select.handle());
+	}
+	db.execute("BEGIN");
+	auto copy = db.prepare_statement("INSERT INTO t(a, b, c, d) SELECT ?, ?, ?, ?");
+	status    = copy.execute_many(rows);
+	db.execute("COMMIT");
+	REQUIRE(status.rows == 1000);
+	REQUIRE(status.rows_per_statement == 1);
+	REQUIRE(status.transactions == 0);
+	REQUIRE(db.prepare_statement("SELECT count(*) FROM t").step().integer(0) == 2000);
+
+	// a failing chunk is rolled back
+	db.execute("CREATE UNIQUE INDEX i ON t(a)");
+	a.back() = 0;
+	REQUIRE_THROWS_AS(insert.execute_many({ a, b, c, d }, options), std::system_error);
+	REQUIRE(db.prepare_statement("SELECT count(*) FROM t").step().integer(0) == 2000);
+	REQUIRE_THROWS_AS(insert.execute_many({ a, b, c }), std::system_error);
+}
+
+namespace {
+
+struct User
+{
+	std::int64_t id;
+	std::string name;
+	double score;
+	std::vector<std::uint8_t> avatar;
+};
+
+} // namespace
+
+TEST_CASE("typed rows")
+{
+	Database db{ ":memory:" };
+	db.execute("CREATE TABLE users(id INTEGER PRIMARY KEY, name TEXT, score REAL, avatar BLOB)");
+
+	auto insert = db.prepare_statement("INSERT INTO users VALUES(?, ?, ?, ?)");
+	insert.bind_all(1, "alice", 2.5, std::vector<std::uint8_t>{ 1, 2 }).finish();
+	insert.bind_all(std::int64_t{ 2 }, std::string{ "bob" }, nullptr, nullptr).finish();
+	REQUIRE_THROWS_AS(insert.bind_all(3, "carol"), std::system_error);
+
+	// binding stops at the first failure
+	auto bound = db.prepare_statement("SELECT ?1, ?2, ?3");
+	sqlite3_limit(db.handle(), SQLITE_LIMIT_LENGTH, 4);
+	REQUIRE_THROWS_AS(bound.bind_all(1, "too long", 3), std::system_error);
+	sqlite3_limit(db.handle(), SQLITE_LIMIT_LENGTH, 1000000);
+	auto row = bound.step();
+	REQUIRE(row.integer(0) == 1);
+	REQUIRE(row.is_null(1));
+	REQUIRE(row.is_null(2));
+
+	auto select = db.prepare_statement("SELECT id, name, score, avatar FROM users ORDER BY id");
+	const auto rows = select.query<std::int64_t, std::string, double>();
+	REQUIRE(rows.size() == 2);
+	REQUIRE(std::get<0>(rows[0]) == 1);
+	REQUIRE(std::get<1>(rows[0]) == "alice");
+	REQUIRE(std::get<2>(rows[0]) == 2.5);
+	REQUIRE(std::get<1>(rows[1]) == "bob");
+	REQUIRE(std::get<2>(rows[1]) == 0.0);
+
+	// the statement is reset and can run again
+	std::string names;
+	REQUIRE(select.query<int, const char*>([&names](int id, const char* name) {
+		names += std::to_string(id);
+		names += name;
+	}) == 2);
+	REQUIRE(names == "1alice2bob");
+
+	const auto users = select.query_as<User>(&User::id, &User::name, &User::score, &User::avatar);
+	REQUIRE(users.size() == 2);
+	REQUIRE(users[0].name == "alice");
+	REQUIRE(users[0].avatar == std::vector<std::uint8_t>{ 1, 2 });
+	REQUIRE(users[1].id == 2);
+	REQUIRE(users[1].avatar.empty());
+
+	auto results = select.step();
+	const auto first = results.as<std::int64_t, Span<const std::uint8_t*>>();
+	REQUIRE(std::get<0>(first) == 1);
+	REQUIRE(std::get<1>(first).size() == 5);
+	select.reset();
+
+	auto narrow = db.prepare_statement("SELECT id FROM users");
+	REQUIRE_THROWS_AS((narrow.query<int, int>()), std::system_error);
+	REQUIRE_THROWS_AS((narrow.step().as<int, int>()), std::system_error);
+
+#if __cplusplus >= 201703L
+	auto lookup = db.prepare_statement("SELECT name, score FROM users WHERE id = ?");
+	lookup.bind_all(std::optional<std::int64_t>{ 2 });
+	REQUIRE(lookup.query<std::string_view, std::optional<double>>(
+	            [](std::string_view name, std::optional<double> score) {
+		            REQUIRE(name == "bob");
+		            REQUIRE(!score);
+	            }) == 1);
+#endif
+}
+
+TEST_CASE("name table")
+{
+	Database db{ ":memory:" };
+	db.execute("CREATE TABLE t(Id INTEGER, Name TEXT)");
+
+	auto insert = db.prepare_statement("INSERT INTO t VALUES(:id, :name)");
+	for (int i = 0; i < 3; ++i) {
+		insert.bind(":id", sqlite3_int64{ i }).bind(":name", "n" + std::to_string(i)).finish();
+	}
+	REQUIRE_THROWS_AS(insert.bind(":ID", nullptr), std::system_error);
+	REQUIRE_THROWS_AS(insert.bind("id", nullptr), std::system_error);
+
+	auto select = db.prepare_statement("SELECT id AS Id, name, id * 2 AS id FROM t ORDER BY id");
+	const auto name = select.column_handle("NAME");
+	REQUIRE(name.column() == 1);
+	REQUIRE(select.column_handle("ID").column() == 0);
+	REQUIRE_THROWS_AS(select.column_handle("missing"), std::system_error);
+
+	// the table survives moving the statement
+	auto moved = std::move(select);
+	int rows   = 0;
+	while (auto results = moved.step()) {
+		REQUIRE(results.integer("iD") == rows);
+		REQUIRE(results.text(name) == "n" + std::to_string(rows));
+		REQUIRE_THROWS_AS(results.integer("missing"), std::system_error);
+		++rows;
+	}
+	REQUIRE(rows == 3);
+	moved.close();
+	REQUIRE_THROWS_AS(moved.column_handle("name"), std::system_error);
+
+	// the recompiled statement has other columns
+	db.execute("CREATE TABLE s(a, b); INSERT INTO s VALUES(1, 2)");
+	auto all = db.prepare_statement("SELECT * FROM s");
+	REQUIRE(all.step().integer("b") == 2);
+	all.reset();
+	db.execute("DROP TABLE s; CREATE TABLE s(b, a, c); INSERT INTO s VALUES(2, 1, 3)");
+	auto results = all.step();
+	REQUIRE(results.integer("b") == 2);
+	REQUIRE(results.integer("c") == 3);
+}
+
+TEST_CASE("column batch")
+{
+	Database db{ ":memory:" };
+	db.execute("CREATE TABLE t(i INTEGER, r REAL, s VARCHAR(10), b BLOB)");
+	auto insert = db.prepare_statement("INSERT INTO t VALUES(?, ?, ?, ?)");
+	for (int i = 0; i < 10; ++i) {
+		if (i % 3) {
+			insert.bind_all(i, i * 0.5, "s" + std::to_string(i), std::vector<std::uint8_t>(i, 7));
+		} else {
+			insert.bind_all(nullptr, nullptr, nullptr, nullptr);
+		}
+		insert.finish();
+	}
+
+	auto select = db.prepare_statement("SELECT i, r, s, b, NULL AS n, i + 1 AS e FROM t");
+	Column_batch batch;
+	REQUIRE(select.fetch_columns(batch, 4) == 4);
+	REQUIRE(batch.rows() == 4);
+	const auto& columns = batch.columns();
+	REQUIRE(columns.size() == 6);
+	REQUIRE(columns[0].name == "i");
+	REQUIRE(columns[0].type == Results::type::integer);
+	REQUIRE(columns[1].type == Results::type::real);
+	REQUIRE(columns[2].type == Results::type::text);
+	// the first value decides for columns without declared type
+	REQUIRE(columns[3].type == Results::type::blob);
+	REQUIRE(columns[4].type == Results::type::null);
+	REQUIRE(columns[5].type == Results::type::integer);
+	REQUIRE(!columns[0].inferred);
+	REQUIRE(columns[5].inferred);
+	REQUIRE(columns[0].integers == std::vector<std::int64_t>{ 0, 1, 2, 0 });
+	REQUIRE(columns[0].null_count == 2);
+	REQUIRE(columns[0].is_null(0));
+	REQUIRE(!columns[0].is_null(1));
+	REQUIRE(columns[1].reals[2] == 1.0);
+	REQUIRE(columns[2].offsets == std::vector<std::int64_t>{ 0, 0, 2, 4, 4 });
+	REQUIRE(std::string(columns[2].data.begin(), columns[2].data.end()) == "s1s2");
+	REQUIRE(columns[3].offsets.back() == 3);
+	REQUIRE(columns[5].integers == std::vector<std::int64_t>{ 0, 2, 3, 0 });
+
+	const auto data = columns[0].integers.data();
+	REQUIRE(select.fetch_columns(batch, 4) == 4);
+	REQUIRE(columns[0].integers.data() == data);
+	REQUIRE(columns[0].integers == std::vector<std::int64_t>{ 4, 5, 0, 7 });
+	REQUIRE(select.fetch_columns(batch, 4) == 2);
+	// the statement starts over after the last batch
+	REQUIRE(select.fetch_columns(batch, 100) == 10);
+	REQUIRE(batch.columns()[4].null_count == 10);
+
+	// values which the type cannot hold widen the column
+	db.execute("CREATE TABLE m(i INTEGER); INSERT INTO m VALUES(1), (2.5)");
+	select = db.prepare_statement("SELECT i, NULL, NULL, i / 10.0 FROM m "
+	                              "UNION ALL VALUES(NULL, 1, X'01', 'z'), (NULL, 'x', 'y', NULL)");
+	Column_batch mixed;
+	REQUIRE(select.fetch_columns(mixed, 10) == 4);
+	const auto& widened = mixed.columns();
+	REQUIRE(widened[0].type == Results::type::real);
+	REQUIRE(widened[0].reals == std::vector<double>{ 1, 2.5, 0, 0 });
+	REQUIRE(widened[1].type == Results::type::text);
+	REQUIRE(widened[1].offsets == std::vector<std::int64_t>{ 0, 0, 0, 1, 2 });
+	REQUIRE(std::string(widened[1].data.begin(), widened[1].data.end()) == "1x");
+	REQUIRE(widened[2].type == Results::type::blob);
+	REQUIRE(widened[2].offsets == std::vector<std::int64_t>{ 0, 0, 0, 1, 2 });
+	REQUIRE(std::string(widened[3].data.begin(), widened[3].data.end()) == "0.10.25z");
+	REQUIRE(widened[3].null_count == 1);
+}
+
+TEST_CASE("arrow")
+{
+	Database db{ ":memory:" };
+	db.execute("CREATE TABLE t(i INTEGER, r REAL, s TEXT, b BLOB);"
+	           "CREATE TABLE copy(i INTEGER, r REAL, s TEXT, b BLOB)");
+	auto insert = db.prepare_statement("INSERT INTO t VALUES(?, ?, ?, ?)");
+	for (int i = 0; i < 1000; ++i) {
+		if (i % 7) {
+			insert.bind_all(i, i * 0.25, std::to_string(i), std::vector<std::uint8_t>(i % 5, 1));
+		} else {
+			insert.bind_all(nullptr, nullptr, nullptr, nullptr);
+		}
+		insert.finish();
+	}
+
+	ArrowArrayStream stream;
+	auto select = db.prepare_statement("SELECT i, r, s, b, NULL AS n FROM t");
+	select.export_arrow(&stream, 300);
+	REQUIRE(!select.is_open());
+
+	ArrowSchema schema;
+	REQUIRE(stream.get_schema(&stream, &schema) == 0);
+	REQUIRE(std::string{ schema.format } == "+s");
+	REQUIRE(schema.n_children == 5);
+	REQUIRE(std::string{ schema.children[0]->format } == "l");
+	REQUIRE(std::string{ schema.children[1]->format } == "g");
+	REQUIRE(std::string{ schema.children[2]->format } == "U");
+	REQUIRE(std::string{ schema.children[3]->format } == "Z");
+	REQUIRE(std::string{ schema.children[4]->format } == "U");
+	REQUIRE(std::string{ schema.children[2]->name } == "s");
+
+	auto copy    = db.prepare_statement("INSERT INTO copy VALUES(?, ?, ?, ?)");
+	int arrays   = 0;
+	int64_t rows = 0;
+	while (true) {
+		ArrowArray array;
+		REQUIRE(stream.get_next(&stream, &array) == 0);
+		if (!array.release) {
+			break;
+		}
+		++arrays;
+		rows += array.length;
+		REQUIRE(array.n_children == 5);
+		const auto integers = array.children[0];
+		REQUIRE(integers->null_count > 0);
+		REQUIRE(static_cast<const std::int64_t*>(integers->buffers[1])[4] == (arrays - 1) * 300 + 4);
+
+		// the last child is moved out and outlives its parent
+		ArrowArray nulls = *array.children[4];
+		array.children[4]->release = nullptr;
+		REQUIRE(nulls.null_count == array.length);
+
+		// the first four columns are inserted into the copy
+		--array.n_children;
+		ArrowSchema narrow = schema;
+		narrow.n_children  = 4;
+		copy.import_arrow(&narrow, &array);
+		REQUIRE(!array.release);
+		REQUIRE(static_cast<const std::int64_t*>(nulls.buffers[1])[nulls.length] == 0);
+		nulls.release(&nulls);
+	}
+	REQUIRE(arrays == 4);
+	REQUIRE(rows == 1000);
+	ArrowArray end;
+	REQUIRE(stream.get_next(&stream, &end) == 0);
+	REQUIRE(!end.release);
+	stream.release(&stream);
+	schema.release(&schema);
+	REQUIRE(!schema.release);
+
+	auto compare = db.prepare_statement("SELECT count(*) FROM t JOIN copy ON t.rowid = copy.rowid "
+	                                    "WHERE t.i IS copy.i AND t.r IS copy.r AND t.s IS copy.s "
+	                                    "AND t.b IS copy.b");
+	REQUIRE(compare.step().integer(0) == 1000);
+
+	// int32 and utf8 children with an offset
+	const std::int32_t values[] = { 1, 2, 3, 4 };
+	const std::uint8_t validity[] = { 0x0b };
+	const std::int32_t offsets[] = { 0, 1, 3, 3, 6 };
+	const char* const text = "abbccc";
+	const void* value_buffers[] = { validity, values };
+	const void* text_buffers[] = { nullptr, offsets, text };
+	ArrowArray children[] = { { 4, 1, 0, 2, 0, value_buffers, nullptr, nullptr, nullptr, nullptr },
+		                      { 4, 0, 0, 3, 0, text_buffers, nullptr, nullptr, nullptr, nullptr } };
+	ArrowArray* child_pointers[] = { &children[0], &children[1] };
+	const void* struct_buffers[] = { nullptr };
+	bool released = false;
+	ArrowArray array{ 3, 0, 1, 1, 2, struct_buffers, child_pointers, nullptr, nullptr, &released };
+	array.release = [](ArrowArray* array) {
+		*static_cast<bool*>(array->private_data) = true;
+		array->release = nullptr;
+	};
+	ArrowSchema child_schemas[] = { { "i", "a", nullptr, 0, 0, nullptr, nullptr, nullptr, nullptr },
+		                            { "u", "b", nullptr, 0, 0, nullptr, nullptr, nullptr, nullptr } };
+	ArrowSchema* child_schema_pointers[] = { &child_schemas[0], &child_schemas[1] };
+	ArrowSchema struct_schema{ "+s", "", nullptr, 0, 2, child_schema_pointers, nullptr, nullptr, nullptr };
+
+	db.execute("CREATE TABLE small(a INTEGER, b TEXT)");
+	auto small = db.prepare_statement("INSERT INTO small VALUES(?, ?)");
+	REQUIRE(small.import_arrow(&struct_schema, &array).rows == 3);
+	REQUIRE(released);
+	std::string result;
+	small = db.prepare_statement("SELECT coalesce(a, 'null') || ':' || b FROM small");
+	small.query<std::string>([&result](std::string row) { result += row + ";"; });
+	REQUIRE(result == "2:bb;null:;4:ccc;");
+
+	released                = false;
+	array.release           = [](ArrowArray* array) { array->release = nullptr; };
+	child_schemas[1].format = "tsu:";
+	REQUIRE_THROWS_AS(small.import_arrow(&struct_schema, &array), std::system_error);
+	REQUIRE(!array.release);
+
+	// whole numbers of numeric affinity are exported as reals, so the reals of later arrays fit
+	db.execute("CREATE TABLE prices(price DECIMAL(10,2));"
+	           "INSERT INTO prices VALUES(1), (2), (3), (1.5)");
+	db.prepare_statement("SELECT price FROM prices").export_arrow(&stream, 3);
+	REQUIRE(stream.get_schema(&stream, &schema) == 0);
+	REQUIRE(std::string{ schema.children[0]->format } == "g");
+	schema.release(&schema);
+	std::vector<double> prices;
+	while (true) {
+		ArrowArray array;
+		REQUIRE(stream.get_next(&stream, &array) == 0);
+		if (!array.release) {
+			break;
+		}
+		const auto values = static_cast<const double*>(array.children[0]->buffers[1]);
+		prices.insert(prices.end(), values, values + array.length);
+		array.release(&array);
+	}
+	stream.release(&stream);
+	REQUIRE(prices == std::vector<double>{ 1, 2, 3, 1.5 });
+
+	// the schema cannot be widened after the first array
+	db.execute("CREATE TABLE m(i INTEGER); INSERT INTO m VALUES(1), (2.5)");
+	db.prepare_statement("SELECT i FROM m").export_arrow(&stream, 1);
+	ArrowArray first;
+	REQUIRE(stream.get_next(&stream, &first) == 0);
+	first.release(&first);
+	ArrowArray second;
+	REQUIRE(stream.get_next(&stream, &second) == EIO);
+	REQUIRE(stream.get_last_error(&stream));
+	stream.release(&stream);
+}
+
+TEST_CASE("blob stream")
+{
+	Database db{ ":memory:" };
+	db.execute("CREATE TABLE media(id INTEGER PRIMARY KEY, data BLOB);"
+	           "INSERT INTO media VALUES(1, zeroblob(100000)), (2, zeroblob(10)), (3, 'text')");
+
+	Blob_stream blob{ db, "media", "data", 1, true };
+	REQUIRE(blob.size() == 100000);
+	std::vector<char> chunk(4096);
+	for (std::size_t i = 0; !blob.eof(); ++i) {
+		std::fill(chunk.begin(), chunk.end(), static_cast<char>(i));
+		blob.write(chunk.data(), std::min(chunk.size(), blob.size() - blob.tell()));
+	}
+	REQUIRE_THROWS_AS(blob.write(chunk.data(), 1), std::system_error);
+	REQUIRE_THROWS_AS(blob.seek(100001), std::system_error);
+
+	blob.seek(4095);
+	REQUIRE(blob.read(chunk.data(), 2) == 2);
+	REQUIRE(chunk[0] == 0);
+	REQUIRE(chunk[1] == 1);
+	blob.seek(99999);
+	REQUIRE(blob.read(chunk.data(), chunk.size()) == 1);
+	REQUIRE(blob.read(chunk.data(), chunk.size()) == 0);
+
+	// the stream is reused for other rows
+	blob.reopen(3);
+	REQUIRE(blob.size() == 4);
+	REQUIRE(blob.read(chunk.data(), chunk.size()) == 4);
+	REQUIRE(std::string(chunk.data(), 4) == "text");
+
+	blob.reopen(2);
+	{
+		Blob_streambuf buffer{ blob, 4 };
+		std::ostream out{ &buffer };
+		out << "0123456789";
+		REQUIRE(out.flush());
+		out << 'x';
+		REQUIRE(!out.flush());
+	}
+	blob.seek(0);
+	{
+		Blob_streambuf buffer{ blob, 3 };
+		std::istream in{ &buffer };
+		std::string text;
+		in >> text;
+		REQUIRE(text == "0123456789");
+		in.clear();
+		REQUIRE(in.seekg(-4, std::ios_base::end));
+		REQUIRE(in.get() == '6');
+		REQUIRE(in.seekg(1));
+		REQUIRE(in.get() == '1');
+	}
+
+	// changing the row aborts the stream
+	db.execute("UPDATE media SET data = zeroblob(10) WHERE id = 2");
+	REQUIRE_THROWS_AS(blob.read(chunk.data(), 1), std::system_error);
+	REQUIRE_THROWS_AS(blob.reopen(42), std::system_error);
+	blob.reopen(1);
+	REQUIRE(blob.size() == 100000);
+	blob.close();
+	REQUIRE_THROWS_AS(blob.read(chunk.data(), 1), std::system_error);
+	REQUIRE_THROWS_AS((Blob_stream{ db, "media", "missing", 1 }), std::system_error);
+}
+
+TEST_CASE("csv loader")
+{
+	std::string csv = "\xef\xbb\xbfid,name,score\r\n";
+	for (int i = 0; i < 2000; ++i) {
+		csv += std::to_string(i) + ",";
+		// quoted separators, quotes and line breaks cross the chunk boundaries
+		csv += i % 3 ? "\"line " + std::to_string(i) + ",\n\"\"quoted\"\"\"" : "plain";
+		csv += i % 5 ? "," + std::to_string(i / 2.0) + "\r\n" : ",\n";
+	}
+	csv += "2000,\"\",abc\n\n2001\n";
+	const auto file = std::fopen("load.csv", "wb");
+	REQUIRE(file);
+	std::fwrite(csv.data(), 1, csv.size(), file);
+	std::fclose(file);
+
+	Database db{ ":memory:" };
+	Csv_options options;
+	options.header     = true;
+	options.threads    = 3;
+	options.chunk_size = 1000;
+	auto status        = load_csv(db, "load.csv", "scores", options);
+	REQUIRE(status.rows == 2002);
+	REQUIRE(status.bytes == csv.size());
+
+	auto statement = db.prepare_statement(
+	    "SELECT group_concat(name || ' ' || type, ';') FROM pragma_table_info('scores')");
+	REQUIRE(statement.query<std::string>() ==
+	        std::vector<std::tuple<std::string>>{ std::make_tuple("id INTEGER;name TEXT;score REAL") });
+	statement = db.prepare_statement("SELECT count(*), count(DISTINCT id), sum(score IS NULL), "
+	                                 "sum(typeof(score) = 'real') FROM scores");
+	REQUIRE(statement.query<int, int, int, int>() == (std::vector<std::tuple<int, int, int, int>>{
+	                                                     std::make_tuple(2002, 2002, 401, 1600) }));
+	statement = db.prepare_statement("SELECT name, score FROM scores WHERE id IN (4, 2000) ORDER BY id");
+	REQUIRE(statement.query<std::string, std::string>() ==
+	        (std::vector<std::tuple<std::string, std::string>>{
+	            std::make_tuple("line 4,\n\"quoted\"", "2.0"), std::make_tuple("", "abc") }));
+
+	// the types of an existing table are kept
+	options.types = { Results::type::text };
+	status        = load_csv(db, "load.csv", "scores", options);
+	REQUIRE(status.rows == 2002);
+	statement = db.prepare_statement("SELECT count(*) FROM scores WHERE typeof(id) = 'text'");
+	REQUIRE(statement.query<int>() == std::vector<std::tuple<int>>{ std::make_tuple(0) });
+	REQUIRE_THROWS_AS(load_csv(db, "missing.csv", "scores"), std::system_error);
+	std::remove("load.csv");
+}
+
+TEST_CASE("table exporter")
+{
+	Database db{ ":memory:" };
+	db.execute("CREATE TABLE data(id INTEGER PRIMARY KEY, i INTEGER, r REAL, t TEXT, b BLOB);"
+	           "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < 1000) "
+	           "INSERT INTO data SELECT x * 3, x - 500, x / 7.0, CASE x % 4 WHEN 0 THEN NULL WHEN 1 THEN '' "
+	           "WHEN 2 THEN 'a,\"b\"' || char(10) || x ELSE 'plain' || x END, "
+	           "CASE x % 2 WHEN 0 THEN x'00ff' END FROM n");
+
+	Export_options options;
+	options.rows_per_partition = 100;
+	options.threads            = 4;
+	std::ostringstream csv;
+	auto status = export_table(db, "data", csv, options);
+	REQUIRE(status.rows == 1000);
+	REQUIRE(status.partitions == 10);
+	REQUIRE(status.bytes == csv.str().size());
+	REQUIRE(csv.str().compare(0, 11, "id,i,r,t,b\n") == 0);
+
+	// the loader reads the export again
+	const auto file = std::fopen("export.csv", "wb");
+	REQUIRE(file);
+	std::fwrite(csv.str().data(), 1, csv.str().size(), file);
+	std::fclose(file);
+	db.execute("CREATE TABLE copy(id INTEGER, i INTEGER, r REAL, t TEXT, b TEXT)");
+	Csv_options csv_options;
+	csv_options.header = true;
+	REQUIRE(load_csv(db, "export.csv", "copy", csv_options).rows == 1000);
+	std::remove("export.csv");
+	auto statement = db.prepare_statement("SELECT count(*) FROM data d JOIN copy c ON d.id = c.id "
+	                                      "WHERE d.i = c.i AND d.r = c.r AND coalesce(d.t, '') = c.t "
+	                                      "AND (d.b IS NULL) = (c.b = '')");
+	REQUIRE(statement.query<int>() == std::vector<std::tuple<int>>{ std::make_tuple(1000) });
+
+	std::ostringstream json;
+	options.format = Export_format::json_lines;
+	options.where  = "id = 6";
+	status         = export_table(db, "data", json, options);
+	REQUIRE(status.rows == 1);
+	REQUIRE(json.str() ==
+	        "{\"id\":6,\"i\":-498,\"r\":0.2857142857142857,\"t\":\"a,\\\"b\\\"\\n2\",\"b\":\"AP8=\"}\n");
+
+	// the threads write their files block by block
+	options.where      = "id > 2800";
+	options.block_size = 256;
+	status             = export_table_parts(db, "data", "part", options);
+	REQUIRE(status.rows == 67);
+	REQUIRE(status.files == std::vector<std::string>{ "part-00000.jsonl" });
+	for (const auto& name : status.files) {
+		const auto part = std::fopen(name.c_str(), "rb");
+		REQUIRE(part);
+		std::fseek(part, 0, SEEK_END);
+		REQUIRE(static_cast<std::uint64_t>(std::ftell(part)) == status.bytes);
+		std::fclose(part);
+		std::remove(name.c_str());
+	}
+	options.block_size = Export_options{}.block_size;
+
+	// the partitions follow the data for sparse and real keys
+	db.execute("INSERT INTO data(id, r) VALUES(1000000000000000, 0.5)");
+	options.where = "";
+	for (const auto key : { "id", "r" }) {
+		options.key = key;
+		std::ostringstream sparse;
+		status = export_table(db, "data", sparse, options);
+		REQUIRE(status.rows == 1001);
+		REQUIRE(status.partitions == 11);
+		const auto text = sparse.str();
+		REQUIRE(std::count(text.begin(), text.end(), '\n') == 1001);
+	}
+	std::ostringstream expected;
+	export_table(db, "data", expected, options);
+
+	// the threads wait for a slow output, so many more partitions than threads do not pile up
+	struct Slow_buffer : std::stringbuf
+	{
+	protected:
+		std::streamsize xsputn(const char* data, std::streamsize size) override
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds{ 100 });
+			return std::stringbuf::xsputn(data, size);
+		}
+	};
+	Slow_buffer slow;
+	std::ostream slow_output{ &slow };
+	options.rows_per_partition = 10;
+	options.block_size         = 256;
+	status                     = export_table(db, "data", slow_output, options);
+	REQUIRE(status.partitions == 101);
+	REQUIRE(slow.str() == expected.str());
+	// two blocks per thread, two more of the partition written next and every block ends with a row
+	REQUIRE(status.peak_buffered > 0);
+	REQUIRE(status.peak_buffered <= (2 * options.threads + 2) * (options.block_size + 200));
+	REQUIRE_THROWS_AS(export_table(db, "missing", json), std::system_error);
+}
+
+#if YSQLITE3_ENABLE_SNAPSHOT
+TEST_CASE("table exporter snapshot")
+{
+	std::remove("snapshot.db");
+	std::remove("snapshot.db-wal");
+	std::remove("snapshot.db-shm");
+	{
+		Database db{ "snapshot.db" };
+		db.execute("PRAGMA journal_mode=WAL;"
+		           "CREATE TABLE data(id INTEGER PRIMARY KEY, t TEXT);"
+		           "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < 1000) "
+		           "INSERT INTO data SELECT x, 'row' || x FROM n");
+
+		Export_options options;
+		options.rows_per_partition = 100;
+		options.threads            = 4;
+		std::ostringstream parallel;
+		const auto status = export_table(db, "data", parallel, options);
+		REQUIRE(status.parallel_reads);
+		REQUIRE(status.rows == 1000);
+
+		// one thread reads with the connection itself
+		options.threads = 1;
+		std::ostringstream serial;
+		REQUIRE(!export_table(db, "data", serial, options).parallel_reads);
+		REQUIRE(parallel.str() == serial.str());
+	}
+	std::remove("snapshot.db");
+	std::remove("snapshot.db-wal");
+	std::remove("snapshot.db-shm");
+}
+#endif
+
+TEST_CASE("run transaction")
+{
+	std::remove("retry.db");
+	Database db{ "retry.db" };
+	db.execute("CREATE TABLE t(a INTEGER)");
+	Database other{ "retry.db" };
+
+	// the lock of the other connection is released while the first retries
+	other.execute("BEGIN IMMEDIATE");
+	std::thread unlock{ [&other] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 30 });
+		other.execute("COMMIT");
+	} };
+	int runs    = 0;
+	auto status = run_transaction(db, Transaction_mode::immediate, [&runs](Database& database) {
+		++runs;
+		database.execute("INSERT INTO t VALUES(1)");
+	});
+	unlock.join();
+	REQUIRE(runs == 1);
+	REQUIRE(status.retries > 0);
+	REQUIRE(status.wait_time.count() > 0);
+
+	// nested calls use savepoints
+	status = run_transaction(db, Transaction_mode::deferred, [](Database& database) {
+		database.execute("INSERT INTO t VALUES(2)");
+		REQUIRE_THROWS_AS(run_transaction(database, Transaction_mode::immediate,
+		                                  [](Database& database) {
+			                                  database.execute("INSERT INTO t VALUES(3)");
+			                                  throw std::system_error{ Error::bad_arguments };
+		                                  }),
+		                  std::system_error);
+		run_transaction(database, Transaction_mode::immediate,
+		                [](Database& database) { database.execute("INSERT INTO t VALUES(4)"); });
+	});
+	REQUIRE(status.retries == 0);
+	auto statement = db.prepare_statement("SELECT group_concat(a) FROM t");
+	REQUIRE(statement.query<std::string>() ==
+	        std::vector<std::tuple<std::string>>{ std::make_tuple("1,2,4") });
+
+	// the last error is thrown after the deadline
+	other.execute("BEGIN EXCLUSIVE");
+	Retry_options options;
+	options.deadline = std::chrono::milliseconds{ 20 };
+	const auto start = std::chrono::steady_clock::now();
+	REQUIRE_THROWS_AS(run_transaction(db, Transaction_mode::exclusive, [](Database&) {}, options, &status),
+	                  std::system_error);
+	REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds{ 1 });
+	// the retries are reported although the transaction failed
+	REQUIRE(status.retries > 0);
+	REQUIRE(sqlite3_get_autocommit(db.handle()));
+	other.execute("ROLLBACK");
+}
+
+TEST_CASE("writer queue")
+{
+	std::remove("queue.db");
+	Database db{ "queue.db" };
+	db.execute("CREATE TABLE t(a INTEGER PRIMARY KEY, thread INTEGER); INSERT INTO t VALUES(-1, -1)");
+
+	Writer_queue_options options;
+	options.max_latency = std::chrono::milliseconds{ 1 };
+	Writer_queue queue{ std::move(db), options };
+	std::vector<std::thread> threads;
+	std::atomic<int> inserted{ 0 };
+	for (int t = 0; t < 8; ++t) {
+		threads.emplace_back([&queue, &inserted, t] {
+			std::vector<std::future<std::size_t>> results;
+			for (int i = 0; i < 100; ++i) {
+				const auto bind = [i, t](Statement& statement) {
+					statement.bind(0, sqlite3_int64{ t * 100 + i }).bind(1, sqlite3_int64{ t });
+				};
+				results.push_back(queue.submit_statement("INSERT INTO t VALUES(?, ?)", bind));
+			}
+			for (auto& result : results) {
+				inserted += static_cast<int>(result.get());
+			}
+		});
+	}
+
+	// failures only roll back their own writes
+	auto duplicate = queue.submit_statement("INSERT INTO t VALUES(-1, 0)");
+	auto failed    = queue.submit([](Database& database) {
+		database.execute("INSERT INTO t VALUES(-2, -1)");
+		throw std::system_error{ Error::bad_arguments };
+	});
+	// a locked table fails the submission but not the batch
+	auto locked = queue.submit([](Database& database) {
+		database.execute("CREATE TABLE dropped(a)");
+		auto reading = database.prepare_statement("SELECT * FROM t");
+		reading.step();
+		database.execute("DROP TABLE dropped");
+	});
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	REQUIRE(inserted == 800);
+	REQUIRE_THROWS_AS(duplicate.get(), std::system_error);
+	REQUIRE_THROWS_AS(failed.get(), std::system_error);
+	try {
+		locked.get();
+		FAIL("the table was dropped");
+	} catch (const std::system_error& e) {
+		REQUIRE(e.code() == SQLite3_code::locked);
+	}
+
+	sqlite3_int64 rows = 0;
+	queue.submit([&rows](Database& database) {
+		rows = database.prepare_statement("SELECT count(*) FROM t").step().integer(0);
+	}).get();
+	REQUIRE(rows == 801);
+	const auto status = queue.status();
+	REQUIRE(status.submissions == 804);
+	REQUIRE(status.failed == 3);
+	REQUIRE(status.retries == 0);
+	REQUIRE(status.largest_batch > 1);
+	REQUIRE(status.batches < status.submissions);
+	REQUIRE(status.queued == 0);
+}
+
+#if YSQLITE3_ENABLE_COROUTINES
+struct Detached
+{
+	struct promise_type
+	{
+		Detached get_return_object() noexcept
+		{
+			return {};
+		}
+		std::suspend_never initial_suspend() noexcept
+		{
+			return {};
+		}
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+		void return_void() noexcept
+		{}
+		void unhandled_exception() noexcept
+		{
+			std::terminate();
+		}
+	};
+};
+
+Detached count_rows(Async_database& db, Executor& caller, std::promise<sqlite3_int64>& sum,
+                    std::thread::id& resumed_on)
+{
+	co_await db.execute("CREATE TABLE t(a INTEGER)", &caller);
+	for (int i = 0; i < 100; ++i) {
+		co_await db.query("INSERT INTO t(a) VALUES(?)",
+		                  [i](Statement& statement) { statement.bind(0, sqlite3_int64{ i }); }, &caller);
+	}
+
+	try {
+		co_await db.execute("SELECT * FROM missing", &caller);
+	} catch (const std::system_error&) {
+		resumed_on = std::this_thread::get_id();
+	}
+
+	sqlite3_int64 total = 0;
+	auto rows           = db.rows("SELECT a FROM t", nullptr, 7, &caller);
+	while (co_await rows.next()) {
+		total += rows.row().integer(0);
+	}
+	sum.set_value(total);
+}
+
+TEST_CASE("coroutines")
+{
+	Async_database db{ Database{ ":memory:" } };
+	Thread_executor caller;
+	std::promise<std::thread::id> caller_id;
+	caller.post([&] { caller_id.set_value(std::this_thread::get_id()); });
+
+	std::promise<sqlite3_int64> sum;
+	std::thread::id resumed_on;
+	count_rows(db, caller, sum, resumed_on);
+	REQUIRE(sum.get_future().get() == 4950);
+	REQUIRE(resumed_on == caller_id.get_future().get());
+}
+#endif
@@ -0,0 +1,628 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ysqlite3/database.hpp>
+#include <ysqlite3/vfs/crypt_file.hpp>
+#include <ysqlite3/vfs/page_pool.hpp>
+#include <ysqlite3/vfs/pipeline_vfs.hpp>
+#include <ysqlite3/vfs/scrubber.hpp>
+#include <ysqlite3/vfs/wal_follower.hpp>
+#include <ysqlite3/vfs/working_set.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <dirent.h>
+#	include <sys/stat.h>
+#endif
+
+using namespace ysqlite3;
+
+void register_pipeline()
+{
+	if (!vfs::find_vfs(YSQLITE3_PIPELINE_VFS_NAME)) {
+		vfs::register_vfs(
+		    std::make_shared<vfs::Pipeline_vfs>(vfs::find_vfs(nullptr), YSQLITE3_PIPELINE_VFS_NAME), false);
+	}
+	REQUIRE(vfs::find_vfs(YSQLITE3_PIPELINE_VFS_NAME));
+}
+
+TEST_CASE("layers from uri")
+{
+	register_pipeline();
+
+	std::remove("pipeline.db");
+
+	{
+		Database db;
+		db.open("file:pipeline.db?layers=metrics,crypt,readahead&key=r%27secret%27&cipher=aes-256-gcm",
+		        open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+		db.set_reserved_size(vfs::crypt_file_reserve_size());
+		db.execute("CREATE TABLE t(v TEXT); INSERT INTO t(v) VALUES('hello pipeline');");
+
+		auto stmt = db.prepare_statement("PRAGMA metrics");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		REQUIRE(std::string{ r.text(0) }.find("writes=") != std::string::npos);
+	}
+
+	{
+		Database db;
+		db.open("file:pipeline.db?layers=crypt&key=r%27secret%27&cipher=aes-256-gcm",
+		        open_flag_readwrite | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+		auto stmt = db.prepare_statement("SELECT v FROM t");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		REQUIRE(std::strcmp(r.text(0), "hello pipeline") == 0);
+	}
+
+	// encrypted content is not readable without the layer
+	{
+		Database db;
+		db.open("file:pipeline.db", open_flag_readwrite | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+		REQUIRE_THROWS(db.execute("SELECT v FROM t"));
+	}
+
+	{
+		Database db;
+		REQUIRE_THROWS(db.open("file:pipeline.db?layers=unknown", open_flag_readwrite | open_flag_uri,
+		                       YSQLITE3_PIPELINE_VFS_NAME));
+	}
+}
+
+TEST_CASE("write behind")
+{
+	register_pipeline();
+
+	for (const auto mode : { "DELETE", "WAL" }) {
+		std::remove("write_behind.db");
+		std::remove("write_behind.db-wal");
+
+		{
+			Database db;
+			db.open("file:write_behind.db?layers=write_behind,metrics&write_behind_limit=262144",
+			        open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+			db.execute((std::string{ "PRAGMA journal_mode=" } + mode).c_str());
+			db.execute("CREATE TABLE t(v BLOB); PRAGMA metrics=reset");
+			for (int i = 0; i < 4; ++i) {
+				db.execute("INSERT INTO t(v) SELECT randomblob(500) FROM (WITH RECURSIVE c(x) AS (SELECT 1 UNION "
+				           "ALL SELECT x+1 FROM c WHERE x<500) SELECT x FROM c)");
+			}
+			db.execute("PRAGMA wal_checkpoint(TRUNCATE)");
+
+			// the adjacent pages reached the disk in few large writes
+			auto stmt = db.prepare_statement("PRAGMA metrics");
+			auto r    = stmt.step();
+			REQUIRE(r);
+			const std::string metrics = r.text(0);
+			const auto writes         = std::stoull(metrics.substr(metrics.find(" writes=") + 8));
+			const auto written_bytes  = std::stoull(metrics.substr(metrics.find("written_bytes=") + 14));
+			REQUIRE(writes > 0);
+			REQUIRE(written_bytes / writes >= 8 * 4096);
+		}
+
+		Database db;
+		db.open("file:write_behind.db", open_flag_readwrite | open_flag_uri);
+		auto stmt = db.prepare_statement("SELECT count(*) FROM t");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		REQUIRE(r.integer(0) == 2000);
+		stmt.close();
+
+		stmt = db.prepare_statement("PRAGMA integrity_check");
+		r    = stmt.step();
+		REQUIRE(r);
+		REQUIRE(std::strcmp(r.text(0), "ok") == 0);
+	}
+}
+
+TEST_CASE("immutable")
+{
+	register_pipeline();
+
+	std::remove("immutable.db");
+	std::remove("immutable_crypt.db");
+
+	{
+		Database db;
+		db.open("file:immutable.db", open_flag_readwrite | open_flag_create | open_flag_uri);
+		db.execute("CREATE TABLE t(v BLOB); INSERT INTO t(v) SELECT randomblob(300) FROM (WITH RECURSIVE c(x) AS "
+		           "(SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<1000) SELECT x FROM c)");
+	}
+	{
+		Database db;
+		db.open("file:immutable_crypt.db?layers=crypt&key=r%27secret%27&cipher=aes-256-gcm",
+		        open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+		db.set_reserved_size(vfs::crypt_file_reserve_size());
+		db.execute("CREATE TABLE t(v BLOB); INSERT INTO t(v) SELECT randomblob(300) FROM (WITH RECURSIVE c(x) AS "
+		           "(SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<1000) SELECT x FROM c)");
+	}
+
+	for (const auto uri : { "file:immutable.db?layers=immutable",
+	                        "file:immutable_crypt.db?layers=immutable,crypt&key=r%27secret%27&cipher=aes-256-gcm" }) {
+		Database db;
+		db.open(uri, open_flag_readwrite | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+		for (const auto mmap_size : { "PRAGMA mmap_size=0", "PRAGMA mmap_size=268435456" }) {
+			db.execute(mmap_size);
+			auto stmt = db.prepare_statement("SELECT count(*), sum(length(v)) FROM t");
+			auto r    = stmt.step();
+			REQUIRE(r);
+			REQUIRE(r.integer(0) == 1000);
+			REQUIRE(r.integer(1) == 300000);
+		}
+		REQUIRE_THROWS(db.execute("INSERT INTO t(v) VALUES(1)"));
+	}
+}
+
+TEST_CASE("dedup")
+{
+	register_pipeline();
+
+	for (const auto file : { "dedup_pool.db", "dedup_pool.db-wal", "dedup_pool.db-shm", "dedup_a.db", "dedup_b.db" }) {
+		std::remove(file);
+	}
+
+	const auto open = [](Database& db, const char* file) {
+		db.open((std::string{ "file:" } + file + "?layers=dedup&dedup_pool=dedup_pool.db").c_str(),
+		        open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+	};
+	const auto status = [](Database& db) {
+		auto stmt = db.prepare_statement("PRAGMA dedup_status");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		unsigned long long pages = 0, references = 0;
+		REQUIRE(std::sscanf(r.text(0), "pages=%llu references=%llu", &pages, &references) == 2);
+		return std::make_pair(pages, references);
+	};
+	const auto value = [](Database& db) {
+		auto stmt = db.prepare_statement("SELECT v FROM t WHERE rowid=1");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		return std::string{ r.text(0) };
+	};
+
+	// two tenants created from the same template share all pages
+	Database a;
+	Database b;
+	for (const auto db : { &a, &b }) {
+		open(*db, db == &a ? "dedup_a.db" : "dedup_b.db");
+		db->execute("CREATE TABLE t(v TEXT); INSERT INTO t(v) SELECT printf('%0500d', x) FROM (WITH RECURSIVE c(x) AS "
+		            "(SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<200) SELECT x FROM c)");
+	}
+	const auto shared = status(a);
+	REQUIRE(shared.first > 10);
+	REQUIRE(shared.second == shared.first * 2);
+
+	// the database file only holds the page map
+	std::FILE* file = std::fopen("dedup_a.db", "rb");
+	REQUIRE(file);
+	std::fseek(file, 0, SEEK_END);
+	REQUIRE(std::ftell(file) == static_cast<long>((shared.first + 1) * 32));
+	std::fclose(file);
+
+	// copy on write
+	b.execute("UPDATE t SET v='changed' WHERE rowid=1");
+	REQUIRE(value(a) == std::string(497, '0') + "001");
+	REQUIRE(value(b) == "changed");
+	REQUIRE(status(b).first > shared.first);
+
+	// released pages are collected once the truncated map is synced
+	b.execute("DROP TABLE t; VACUUM;");
+	b.close();
+	REQUIRE(vfs::Page_pool::open("dedup_pool.db")->collect() > 0);
+	REQUIRE(status(a) == std::make_pair(shared.first + 1, shared.first + 1));
+	REQUIRE(value(a) == std::string(497, '0') + "001");
+
+	// the pages survive reopening
+	a.close();
+	open(a, "dedup_a.db");
+	REQUIRE(value(a) == std::string(497, '0') + "001");
+	auto stmt = a.prepare_statement("PRAGMA integrity_check");
+	auto r    = stmt.step();
+	REQUIRE(r);
+	REQUIRE(std::strcmp(r.text(0), "ok") == 0);
+}
+
+TEST_CASE("process shared memory")
+{
+	register_pipeline();
+
+	constexpr auto uri = "file:process_shm.db?layers=process_shm";
+	std::remove("process_shm.db");
+	std::remove("process_shm.db-wal");
+	std::remove("process_shm.db-shm");
+
+	Database reader;
+	reader.open(uri, open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+	reader.execute("PRAGMA journal_mode=WAL; CREATE TABLE t(v INTEGER);");
+
+	// the snapshot of an open read transaction is kept
+	reader.execute("BEGIN; SELECT count(*) FROM t;");
+	std::vector<std::thread> writers;
+	for (int i = 0; i < 4; ++i) {
+		writers.emplace_back([uri] {
+			Database db;
+			db.open(uri, open_flag_readwrite | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+			db.execute("PRAGMA busy_timeout=10000");
+			for (int j = 0; j < 50; ++j) {
+				db.execute("INSERT INTO t(v) VALUES(1)");
+			}
+		});
+	}
+	for (auto& i : writers) {
+		i.join();
+	}
+
+	auto stmt = reader.prepare_statement("SELECT count(*) FROM t");
+	auto r    = stmt.step();
+	REQUIRE(r);
+	REQUIRE(r.integer(0) == 0);
+	stmt.close();
+	reader.execute("COMMIT");
+
+	stmt = reader.prepare_statement("SELECT count(*) FROM t");
+	r    = stmt.step();
+	REQUIRE(r);
+	REQUIRE(r.integer(0) == 200);
+	stmt.close();
+
+	// the index never touched the file system
+	std::FILE* shm = std::fopen("process_shm.db-shm", "rb");
+	REQUIRE(!shm);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("wal shipping")
+{
+	register_pipeline();
+
+	constexpr auto uri = "file:wal_shipping.db?layers=wal_shipping&wal_sink=dir:wal_shipping";
+	std::remove("wal_shipping.db");
+	std::remove("wal_shipping.db-wal");
+	std::remove("wal_shipping.db-shm");
+	mkdir("wal_shipping", 0755);
+	if (const auto dir = opendir("wal_shipping")) {
+		while (const auto entry = readdir(dir)) {
+			std::remove((std::string{ "wal_shipping/" } + entry->d_name).c_str());
+		}
+		closedir(dir);
+	}
+
+	const auto count = [] {
+		Database replica;
+		replica.open("wal_shipping_replica.db", open_flag_readonly);
+		auto stmt = replica.prepare_statement("SELECT count(*) FROM t");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		const auto value = r.integer(0);
+		stmt.close();
+		stmt = replica.prepare_statement("PRAGMA integrity_check");
+		r    = stmt.step();
+		REQUIRE(r);
+		REQUIRE(std::strcmp(r.text(0), "ok") == 0);
+		return value;
+	};
+	constexpr auto insert = "INSERT INTO t(v) SELECT randomblob(300) FROM (WITH RECURSIVE c(x) AS (SELECT 1 "
+	                        "UNION ALL SELECT x+1 FROM c WHERE x<100) SELECT x FROM c)";
+
+	Database primary;
+	primary.open(uri, open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+	primary.execute("PRAGMA journal_mode=WAL; CREATE TABLE t(v BLOB);");
+	primary.execute(insert);
+
+	// the replica is a copy made after shipping started
+	vfs::Wal_follower::bootstrap(primary, "wal_shipping_replica.db");
+	primary.execute(insert);
+	primary.execute(insert);
+
+	{
+		vfs::Wal_follower follower{ "wal_shipping_replica.db", std::unique_ptr<vfs::Wal_source>{
+			                                                         new vfs::Directory_wal_source{ "wal_shipping" } } };
+		REQUIRE(follower.poll() > 0);
+		REQUIRE(count() == 300);
+
+		// a restarted WAL
+		primary.execute("PRAGMA wal_checkpoint(TRUNCATE)");
+		primary.execute(insert);
+		primary.execute("DELETE FROM t WHERE rowid % 2 = 0");
+		REQUIRE(follower.poll() > 0);
+		REQUIRE(count() == 200);
+		REQUIRE(follower.status().sequence > 0);
+	}
+
+	auto stmt = primary.prepare_statement("PRAGMA wal_shipping");
+	auto r    = stmt.step();
+	REQUIRE(r);
+	REQUIRE(std::string{ r.text(0) }.find("dropped=0") != std::string::npos);
+	stmt.close();
+
+	// a new follower continues where the last one stopped
+	primary.execute(insert);
+	vfs::Wal_follower follower{ "wal_shipping_replica.db", std::unique_ptr<vfs::Wal_source>{
+		                                                         new vfs::Directory_wal_source{ "wal_shipping" } } };
+	REQUIRE(follower.poll() == 1);
+	REQUIRE(count() == 300);
+
+	// another connection does not ship the transactions in the WAL again
+	const auto records = [&primary] {
+		auto stmt = primary.prepare_statement("PRAGMA wal_shipping");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		const std::string status = r.text(0);
+		return std::stoull(status.substr(status.find("records=") + 8));
+	};
+	const auto shipped = records();
+	Database other;
+	other.open(uri, open_flag_readwrite | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+	other.execute(insert);
+	REQUIRE(records() == shipped + 1);
+	REQUIRE(follower.poll() == 1);
+	REQUIRE(count() == 400);
+}
+
+TEST_CASE("wal shipping over a unix socket")
+{
+	register_pipeline();
+
+	for (const auto file :
+	     { "wal_socket.db", "wal_socket.db-wal", "wal_socket.db-shm", "wal_socket_replica.db" }) {
+		std::remove(file);
+	}
+
+	const auto count = [] {
+		Database replica;
+		replica.open("wal_socket_replica.db", open_flag_readonly);
+		auto stmt = replica.prepare_statement("SELECT count(*) FROM t");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		return r.integer(0);
+	};
+
+	// the follower listens before the primary ships
+	std::unique_ptr<vfs::Wal_source> source{ new vfs::Unix_socket_wal_source{ "wal_socket" } };
+	Database primary;
+	primary.open("file:wal_socket.db?layers=wal_shipping&wal_sink=unix:wal_socket",
+	             open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+	primary.execute("PRAGMA journal_mode=WAL; CREATE TABLE t(v BLOB);");
+	vfs::Wal_follower::bootstrap(primary, "wal_socket_replica.db");
+	vfs::Wal_follower follower{ "wal_socket_replica.db", std::move(source) };
+
+	// the commit is much larger than the send buffer of the socket
+	primary.execute("INSERT INTO t(v) SELECT randomblob(1000) FROM (WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL "
+	                "SELECT x+1 FROM c WHERE x<2000) SELECT x FROM c)");
+	for (int i = 0; i < 1000 && count() != 2000; ++i) {
+		follower.poll();
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+	}
+	REQUIRE(count() == 2000);
+
+	auto stmt = primary.prepare_statement("PRAGMA wal_shipping");
+	auto r    = stmt.step();
+	REQUIRE(r);
+	REQUIRE(std::string{ r.text(0) }.find("dropped=0") != std::string::npos);
+}
+#endif
+
+TEST_CASE("scrub")
+{
+	register_pipeline();
+
+	constexpr auto uri = "file:scrub.db?layers=scrub,crypt&key=r%27secret%27&cipher=aes-256-gcm";
+	std::remove("scrub.db");
+	std::remove("scrub.db-scrub");
+	{
+		Database db;
+		db.open(uri, open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+		db.set_reserved_size(vfs::crypt_file_reserve_size());
+		db.execute("PRAGMA page_size=4096; VACUUM; CREATE TABLE t(v BLOB); INSERT INTO t(v) SELECT "
+		           "randomblob(1000) FROM (WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE "
+		           "x<1000) SELECT x FROM c);");
+	}
+
+	// flip a bit in page 5
+	std::FILE* file = std::fopen("scrub.db", "r+b");
+	REQUIRE(file);
+	REQUIRE(std::fseek(file, 4 * 4096 + 1000, SEEK_SET) == 0);
+	const auto byte = std::fgetc(file);
+	REQUIRE(std::fseek(file, 4 * 4096 + 1000, SEEK_SET) == 0);
+	std::fputc(byte ^ 1, file);
+	std::fclose(file);
+
+	vfs::Scrub_options options;
+	options.threads     = 4;
+	options.batch_pages = 16;
+	{
+		vfs::Scrubber scrubber{ uri, YSQLITE3_PIPELINE_VFS_NAME, options };
+		scrubber.start();
+		scrubber.wait();
+		const auto status = scrubber.status();
+		REQUIRE(status.error.empty());
+		REQUIRE(status.passes == 1);
+		REQUIRE(status.pages > 250);
+		REQUIRE(status.verified == status.pages);
+		REQUIRE(status.failures == std::vector<std::uint32_t>{ 5 });
+
+		Database db;
+		db.open(uri, open_flag_readwrite | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+		auto stmt = db.prepare_statement("PRAGMA scrub_status");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		REQUIRE(std::string{ r.text(0) }.find("failures=1 failed_pages=5 ") != std::string::npos);
+	}
+
+	// a throttled pass is stopped in the middle
+	std::uint64_t position = 0;
+	options.bytes_per_second = 200 * 4096;
+	{
+		vfs::Scrubber scrubber{ uri, YSQLITE3_PIPELINE_VFS_NAME, options };
+		scrubber.start();
+		// deriving the key takes a while
+		for (int i = 0; i < 1000 && !scrubber.status().verified; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+		}
+		scrubber.stop();
+		const auto status = scrubber.status();
+		position          = status.position;
+		REQUIRE(!status.running);
+		REQUIRE(position > 1);
+		REQUIRE(position < status.pages);
+	}
+
+	// the next scrubber continues there
+	vfs::Scrubber scrubber{ uri, YSQLITE3_PIPELINE_VFS_NAME, options };
+	const auto status = scrubber.status();
+	REQUIRE(status.position == position);
+	REQUIRE(status.passes == 1);
+	REQUIRE(status.failures == std::vector<std::uint32_t>{ 5 });
+}
+
+TEST_CASE("temp arena")
+{
+	const auto sort = [](const char* vfs) {
+		Database db;
+		db.open("file:temp_arena.db", open_flag_readwrite | open_flag_create | open_flag_uri, vfs);
+		db.execute("PRAGMA temp_store=FILE; PRAGMA cache_size=10; DROP TABLE IF EXISTS t; CREATE TABLE t(v BLOB); "
+		           "INSERT INTO t(v) SELECT randomblob(1000) FROM (WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL "
+		           "SELECT x+1 FROM c WHERE x<2000) SELECT x FROM c);");
+		auto stmt = db.prepare_statement("SELECT count(*), count(DISTINCT v) FROM (SELECT v FROM t ORDER BY v)");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		REQUIRE(r.integer(0) == 2000);
+		REQUIRE(r.integer(1) == 2000);
+	};
+
+	std::remove("temp_arena.db");
+	for (const auto budget : { 64 * 1024 * 1024, 256 * 1024 }) {
+		const auto name = "temp-arena-" + std::to_string(budget);
+		auto vfs        = std::make_shared<vfs::Pipeline_vfs>(vfs::find_vfs(nullptr), name.c_str());
+		vfs->set_temp_budget(budget);
+		vfs::register_vfs(vfs, false);
+		sort(name.c_str());
+
+		// everything was returned
+		const auto status = vfs->temp_status();
+		REQUIRE(status.used == 0);
+		REQUIRE(status.peak > 0);
+		REQUIRE(status.peak <= static_cast<std::size_t>(budget));
+		REQUIRE((status.spills > 0) == (budget < 1024 * 1024));
+		vfs::unregister_vfs(*vfs);
+	}
+}
+
+TEST_CASE("throttle")
+{
+	register_pipeline();
+
+	std::remove("throttle.db");
+	std::remove("throttle.db-journal");
+	Database db;
+	db.open("file:throttle.db?layers=throttle&throttle_bytes=1048576",
+	        open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+	const auto waited = [&db] {
+		auto stmt                = db.prepare_statement("PRAGMA throttle_status");
+		auto r                   = stmt.step();
+		const std::string status = r.text(0);
+		return std::stoll(status.substr(status.find("waited_us=") + 10));
+	};
+
+	// about 1 MiB for the database and the same for the journal
+	const auto start = std::chrono::steady_clock::now();
+	db.execute("CREATE TABLE t(v BLOB); INSERT INTO t(v) SELECT randomblob(1000) FROM (WITH RECURSIVE c(x) AS "
+	           "(SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<1000) SELECT x FROM c); DELETE FROM t;");
+	REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{ 500 });
+	REQUIRE(waited() > 0);
+
+	// foreground connections are not paced
+	db.execute("PRAGMA throttle_class=foreground");
+	const auto before = waited();
+	db.execute("INSERT INTO t(v) SELECT randomblob(1000) FROM (WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL "
+	           "SELECT x+1 FROM c WHERE x<1000) SELECT x FROM c)");
+	REQUIRE(waited() == before);
+
+	// the limits can be changed at runtime
+	auto stmt = db.prepare_statement("PRAGMA throttle_bytes=0");
+	auto r    = stmt.step();
+	REQUIRE(r);
+	REQUIRE(std::string{ r.text(0) } == "0");
+}
+
+TEST_CASE("working set")
+{
+	// a loop over 1000 pages only hits caches which hold all of them
+	vfs::Working_set_estimator estimator{ 256 };
+	for (int i = 0; i < 20; ++i) {
+		for (std::uint64_t page = 0; page < 1000; ++page) {
+			estimator.record(page);
+		}
+	}
+	REQUIRE(estimator.sampling_rate() < 1);
+	REQUIRE(estimator.pages() > 800);
+	REQUIRE(estimator.pages() < 1200);
+	for (const auto& point : estimator.curve()) {
+		if (point.cache_pages < 800) {
+			REQUIRE(point.miss_ratio > 0.9);
+		} else if (point.cache_pages > 1200) {
+			REQUIRE(point.miss_ratio < 0.1);
+		}
+	}
+
+	register_pipeline();
+	std::remove("working_set.db");
+	Database db;
+	db.open("file:working_set.db?layers=working_set", open_flag_readwrite | open_flag_create | open_flag_uri,
+	        YSQLITE3_PIPELINE_VFS_NAME);
+	db.execute("CREATE TABLE t(v BLOB); INSERT INTO t(v) SELECT randomblob(1000) FROM (WITH RECURSIVE c(x) AS "
+	           "(SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<1000) SELECT x FROM c); PRAGMA cache_size=10;");
+	for (int i = 0; i < 5; ++i) {
+		db.execute("SELECT sum(length(v)) FROM t");
+	}
+	REQUIRE(!vfs::working_set_curve(db).empty());
+	REQUIRE(vfs::tune_cache_size(db, 0.9) > 200);
+	REQUIRE(vfs::working_set_curve(db).empty());
+}
+
+#if defined(__linux__)
+TEST_CASE("preallocation")
+{
+	register_pipeline();
+
+	constexpr auto chunk_size = 4 * 1024 * 1024;
+	const auto allocated      = [] {
+		struct stat info;
+		REQUIRE(stat("preallocation.db", &info) == 0);
+		return static_cast<long long>(info.st_blocks) * 512;
+	};
+
+	for (const auto uri : { "file:preallocation.db?chunk_size=4194304",
+	                        "file:preallocation.db?chunk_size=4194304&background_preallocation=1" }) {
+		std::remove("preallocation.db");
+
+		Database db;
+		db.open(uri, open_flag_readwrite | open_flag_create | open_flag_uri, YSQLITE3_PIPELINE_VFS_NAME);
+		db.execute("CREATE TABLE t(v BLOB); INSERT INTO t(v) SELECT randomblob(1000) FROM (WITH RECURSIVE c(x) AS "
+		           "(SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<100) SELECT x FROM c)");
+
+		// the background thread may still be reserving
+		for (int i = 0; i < 100 && allocated() < chunk_size; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+		}
+		REQUIRE(allocated() >= chunk_size);
+
+		// the file size is not affected
+		struct stat info;
+		REQUIRE(stat("preallocation.db", &info) == 0);
+		auto stmt = db.prepare_statement("SELECT page_count * page_size FROM pragma_page_count, pragma_page_size");
+		auto r    = stmt.step();
+		REQUIRE(r);
+		REQUIRE(r.integer(0) == info.st_size);
+		stmt.close();
+
+		// truncating releases the reserved space
+		db.execute("DELETE FROM t; VACUUM;");
+		REQUIRE(allocated() < chunk_size);
+	}
+}
+#endif
@@ -0,0 +1,411 @@
+#include "arrow.hpp"
+
+#include "finally.hpp"
+#include "statement.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace ysqlite3;
+
+namespace {
+
+/// Arrow requires buffers even if they are empty.
+const std::int64_t empty_buffer[1] = { 0 };
+
+template<typename Type>
+const void* buffer_of(const std::vector<Type>& values) noexcept
+{
+	return values.empty() ? static_cast<const void*>(empty_buffer) : values.data();
+}
+
+const char* format_of(Results::type type) noexcept
+{
+	switch (type) {
+	case Results::type::integer: return "l";
+	case Results::type::real: return "g";
+	case Results::type::text: return "U";
+	case Results::type::blob: return "Z";
+	default: return "n";
+	}
+}
+
+/**
+ * Releases a schema or an array. The children are released first, unless the consumer moved them. Every
+ * structure owns a reference to the data of its parent, so moved children remain valid.
+ */
+template<typename Struct>
+void release(Struct* structure)
+{
+	for (int64_t i = 0; i < structure->n_children; ++i) {
+		if (structure->children[i]->release) {
+			structure->children[i]->release(structure->children[i]);
+		}
+	}
+	delete static_cast<std::shared_ptr<void>*>(structure->private_data);
+	structure->release = nullptr;
+}
+
+/// Creates one reference for every structure before any of them is filled, so filling cannot throw.
+std::vector<std::unique_ptr<std::shared_ptr<void>>> references(const std::shared_ptr<void>& data,
+                                                               std::size_t count)
+{
+	std::vector<std::unique_ptr<std::shared_ptr<void>>> result;
+	for (std::size_t i = 0; i < count; ++i) {
+		result.emplace_back(new std::shared_ptr<void>{ data });
+	}
+	return result;
+}
+
+struct Schema_data
+{
+	std::vector<ArrowSchema> children;
+	std::vector<ArrowSchema*> pointers;
+	std::vector<std::string> names;
+};
+
+void export_schema(const Column_batch& layout, ArrowSchema* out)
+{
+	const auto& columns = layout.columns();
+	const auto data     = std::make_shared<Schema_data>();
+	data->children.resize(columns.size());
+	for (std::size_t i = 0; i < columns.size(); ++i) {
+		data->pointers.push_back(&data->children[i]);
+		data->names.push_back(columns[i].name);
+	}
+	auto owners = references(data, columns.size() + 1);
+
+	for (std::size_t i = 0; i < columns.size(); ++i) {
+		auto& child        = data->children[i];
+		child              = ArrowSchema{};
+		child.format       = format_of(columns[i].type);
+		child.name         = data->names[i].c_str();
+		child.flags        = ARROW_FLAG_NULLABLE;
+		child.release      = &release<ArrowSchema>;
+		child.private_data = owners[i + 1].release();
+	}
+	*out              = ArrowSchema{};
+	out->format       = "+s";
+	out->name         = "";
+	out->n_children   = static_cast<int64_t>(columns.size());
+	out->children     = data->pointers.data();
+	out->release      = &release<ArrowSchema>;
+	out->private_data = owners[0].release();
+}
+
+struct Array_data
+{
+	Column_batch batch;
+	std::vector<ArrowArray> children;
+	std::vector<ArrowArray*> pointers;
+	std::vector<std::vector<const void*>> buffers;
+	const void* validity = nullptr;
+};
+
+void export_batch(Column_batch batch, ArrowArray* out)
+{
+	const auto data     = std::make_shared<Array_data>();
+	data->batch         = std::move(batch);
+	const auto& columns = data->batch.columns();
+	const auto rows     = static_cast<int64_t>(data->batch.rows());
+	data->children.resize(columns.size());
+	data->buffers.resize(columns.size());
+	for (std::size_t i = 0; i < columns.size(); ++i) {
+		const auto& column = columns[i];
+		auto& buffers      = data->buffers[i];
+		data->pointers.push_back(&data->children[i]);
+		buffers.push_back(column.null_count ? column.validity.data() : nullptr);
+		switch (column.type) {
+		case Results::type::integer: buffers.push_back(buffer_of(column.integers)); break;
+		case Results::type::real: buffers.push_back(buffer_of(column.reals)); break;
+		case Results::type::text:
+		case Results::type::blob:
+			buffers.push_back(column.offsets.data());
+			buffers.push_back(buffer_of(column.data));
+			break;
+		case Results::type::null: buffers.clear(); break;
+		}
+	}
+	auto owners = references(data, columns.size() + 1);
+
+	for (std::size_t i = 0; i < columns.size(); ++i) {
+		auto& child        = data->children[i];
+		child              = ArrowArray{};
+		child.length       = rows;
+		child.null_count   = static_cast<int64_t>(columns[i].null_count);
+		child.n_buffers    = static_cast<int64_t>(data->buffers[i].size());
+		child.buffers      = data->buffers[i].data();
+		child.release      = &release<ArrowArray>;
+		child.private_data = owners[i + 1].release();
+	}
+	*out              = ArrowArray{};
+	out->length       = rows;
+	out->n_buffers    = 1;
+	out->buffers      = &data->validity;
+	out->n_children   = static_cast<int64_t>(columns.size());
+	out->children     = data->pointers.data();
+	out->release      = &release<ArrowArray>;
+	out->private_data = owners[0].release();
+}
+
+struct Stream_data
+{
+	Statement statement;
+	std::size_t batch_size;
+	/// The columns and types of all batches, fixed by the first one.
+	Column_batch layout;
+	/// The first batch which was fetched for the schema.
+	Column_batch first;
+	bool started   = false;
+	bool has_first = false;
+	bool done      = false;
+	std::string error;
+
+	Stream_data(Statement&& statement, std::size_t batch_size) noexcept
+	    : statement{ std::move(statement) }, batch_size{ batch_size }
+	{}
+	void start()
+	{
+		if (started) {
+			return;
+		}
+
+		statement.fetch_columns(first, batch_size);
+		for (std::size_t i = 0; i < first.columns().size(); ++i) {
+			const auto& column = first.columns()[i];
+			if (column.type == Results::type::null) {
+				first.set_type(i, Results::type::text);
+			} else if (column.type == Results::type::integer && column.inferred) {
+				// numeric affinity stores whole numbers as integers, so later batches may hold reals
+				first.set_type(i, Results::type::real);
+			}
+		}
+		layout    = first.layout();
+		has_first = true;
+		started   = true;
+	}
+};
+
+/// Runs a callback of the stream and stores the error message.
+template<typename Function>
+int guard(ArrowArrayStream* stream, Function&& function) noexcept
+{
+	const auto data = static_cast<Stream_data*>(stream->private_data);
+	try {
+		data->error.clear();
+		function(*data);
+		return 0;
+	} catch (const std::bad_alloc& e) {
+		data->error = e.what();
+		return ENOMEM;
+	} catch (const std::exception& e) {
+		data->error = e.what();
+		return EIO;
+	} catch (...) {
+		data->error = "unknown error";
+		return EIO;
+	}
+}
+
+int get_schema(ArrowArrayStream* stream, ArrowSchema* out)
+{
+	return guard(stream, [out](Stream_data& data) {
+		data.start();
+		export_schema(data.layout, out);
+	});
+}
+
+int get_next(ArrowArrayStream* stream, ArrowArray* out)
+{
+	return guard(stream, [out](Stream_data& data) {
+		data.start();
+		Column_batch batch;
+		if (data.has_first) {
+			batch          = std::move(data.first);
+			data.has_first = false;
+		} else if (!data.done) {
+			batch = data.layout.layout();
+			data.statement.fetch_columns(batch, data.batch_size);
+			// the schema is fixed, but the values must not be narrowed to it
+			for (std::size_t i = 0; i < batch.columns().size(); ++i) {
+				const auto& column = batch.columns()[i];
+				if (column.type != data.layout.columns()[i].type) {
+					throw std::system_error{ Error::bad_result, "the type of column " + column.name + " changed" };
+				}
+			}
+		}
+		// the statement starts over after the last batch
+		data.done = data.done || batch.rows() < data.batch_size;
+		if (batch.rows()) {
+			export_batch(std::move(batch), out);
+		} else {
+			out->release = nullptr;
+		}
+	});
+}
+
+const char* get_last_error(ArrowArrayStream* stream)
+{
+	const auto data = static_cast<Stream_data*>(stream->private_data);
+	return data->error.empty() ? nullptr : data->error.c_str();
+}
+
+void release_stream(ArrowArrayStream* stream)
+{
+	delete static_cast<Stream_data*>(stream->private_data);
+	stream->release = nullptr;
+}
+
+/// A child array bound to a parameter.
+class Arrow_column
+{
+public:
+	Arrow_column(const ArrowSchema* schema, const ArrowArray* array, int64_t offset, int64_t length)
+	{
+		if (!schema || !array || !schema->format || std::strlen(schema->format) != 1 || schema->dictionary ||
+		    array->length < offset + length) {
+			throw std::system_error{ Error::bad_arguments };
+		}
+
+		_format = schema->format[0];
+		_offset = array->offset + offset;
+		switch (_format) {
+		case 'n': return;
+		case 'b':
+		case 'c':
+		case 'C':
+		case 's':
+		case 'S':
+		case 'i':
+		case 'I':
+		case 'l':
+		case 'L':
+		case 'f':
+		case 'g': _check(array, 2); break;
+		case 'u':
+		case 'U':
+		case 'z':
+		case 'Z':
+			_check(array, 3);
+			_data = static_cast<const char*>(array->buffers[2]);
+			break;
+		default: throw std::system_error{ Error::bad_arguments };
+		}
+		_validity = array->null_count ? static_cast<const std::uint8_t*>(array->buffers[0]) : nullptr;
+		_values   = array->buffers[1];
+	}
+	int bind(sqlite3_stmt* statement, int parameter, std::size_t row) const noexcept
+	{
+		const auto i = _offset + static_cast<int64_t>(row);
+		if (_format == 'n' || (_validity && !(_validity[i / 8] & (1 << (i % 8))))) {
+			return sqlite3_bind_null(statement, parameter);
+		}
+
+		switch (_format) {
+		case 'b': return sqlite3_bind_int(statement, parameter, (_at<std::uint8_t>(i / 8) >> (i % 8)) & 1);
+		case 'c': return sqlite3_bind_int(statement, parameter, _at<std::int8_t>(i));
+		case 'C': return sqlite3_bind_int(statement, parameter, _at<std::uint8_t>(i));
+		case 's': return sqlite3_bind_int(statement, parameter, _at<std::int16_t>(i));
+		case 'S': return sqlite3_bind_int(statement, parameter, _at<std::uint16_t>(i));
+		case 'i': return sqlite3_bind_int(statement, parameter, _at<std::int32_t>(i));
+		case 'I': return sqlite3_bind_int64(statement, parameter, _at<std::uint32_t>(i));
+		case 'l': return sqlite3_bind_int64(statement, parameter, _at<std::int64_t>(i));
+		// values beyond the range of sqlite3_int64 wrap around
+		case 'L': return sqlite3_bind_int64(statement, parameter, _at<std::uint64_t>(i));
+		case 'f': return sqlite3_bind_double(statement, parameter, _at<float>(i));
+		case 'g': return sqlite3_bind_double(statement, parameter, _at<double>(i));
+		case 'u': return _bind_bytes(statement, parameter, _at<std::int32_t>(i), _at<std::int32_t>(i + 1));
+		case 'U': return _bind_bytes(statement, parameter, _at<std::int64_t>(i), _at<std::int64_t>(i + 1));
+		case 'z': return _bind_bytes(statement, parameter, _at<std::int32_t>(i), _at<std::int32_t>(i + 1));
+		case 'Z': return _bind_bytes(statement, parameter, _at<std::int64_t>(i), _at<std::int64_t>(i + 1));
+		default: return SQLITE_MISUSE;
+		}
+	}
+
+private:
+	char _format;
+	int64_t _offset;
+	const std::uint8_t* _validity = nullptr;
+	const void* _values           = nullptr;
+	const char* _data             = nullptr;
+
+	static void _check(const ArrowArray* array, int64_t buffers)
+	{
+		if (array->n_buffers != buffers || !array->buffers[1]) {
+			throw std::system_error{ Error::bad_arguments };
+		}
+	}
+	template<typename Type>
+	Type _at(int64_t index) const noexcept
+	{
+		return static_cast<const Type*>(_values)[index];
+	}
+	int _bind_bytes(sqlite3_stmt* statement, int parameter, int64_t begin, int64_t end) const noexcept
+	{
+		// empty values may not have a buffer, but they are not null
+		const auto value = _data ? _data + begin : "";
+		const auto size  = static_cast<sqlite3_uint64>(end - begin);
+		if (_format == 'u' || _format == 'U') {
+			return sqlite3_bind_text64(statement, parameter, value, size, SQLITE_STATIC, SQLITE_UTF8);
+		}
+		return sqlite3_bind_blob64(statement, parameter, value, size, SQLITE_STATIC);
+	}
+};
+
+} // namespace
+
+void Statement::export_arrow(ArrowArrayStream* stream, std::size_t batch_size)
+{
+	if (!is_open()) {
+		throw std::system_error{ Error::statement_is_closed };
+	} else if (!stream || !batch_size) {
+		throw std::system_error{ Error::bad_arguments };
+	}
+
+	*stream                = ArrowArrayStream{};
+	stream->private_data   = new Stream_data{ std::move(*this), batch_size };
+	stream->get_schema     = &get_schema;
+	stream->get_next       = &get_next;
+	stream->get_last_error = &get_last_error;
+	stream->release        = &release_stream;
+}
+
+Bulk_status Statement::import_arrow(const ArrowSchema* schema, ArrowArray* array, const Bulk_options& options)
+{
+	if (!array || !array->release) {
+		throw std::system_error{ Error::bad_arguments };
+	}
+
+	const auto _ = finally([array] {
+		if (array->release) {
+			array->release(array);
+		}
+	});
+	if (!is_open()) {
+		throw std::system_error{ Error::statement_is_closed };
+	} else if (!schema || !schema->format || std::strcmp(schema->format, "+s") ||
+	           schema->n_children != array->n_children ||
+	           array->n_children != sqlite3_bind_parameter_count(_statement)) {
+		throw std::system_error{ Error::bad_arguments };
+	}
+
+	std::vector<Arrow_column> columns;
+	for (int64_t i = 0; i < array->n_children; ++i) {
+		columns.emplace_back(schema->children[i], array->children[i], array->offset, array->length);
+	}
+	return _execute_many(
+	    static_cast<std::size_t>(array->length),
+	    [&columns](sqlite3_stmt* statement, std::size_t row, int first_parameter) {
+		    for (std::size_t i = 0; i < columns.size(); ++i) {
+			    if (const auto ec = columns[i].bind(statement, first_parameter + static_cast<int>(i), row)) {
+				    return ec;
+			    }
+		    }
+		    return SQLITE_OK;
+	    },
+	    options);
+}
@@ -0,0 +1,64 @@
+#ifndef YSQLITE3_ARROW_HPP_
+#define YSQLITE3_ARROW_HPP_
+
+#include <cstdint>
+
+/*
+ * The structures of the Apache Arrow C data and C stream interfaces. They are ABI-stable and may be defined
+ * by several libraries, hence the guards of the specification.
+ *
+ * @see https://arrow.apache.org/docs/format/CDataInterface.html
+ * @see https://arrow.apache.org/docs/format/CStreamInterface.html
+ */
+extern "C" {
+
+#ifndef ARROW_C_DATA_INTERFACE
+#	define ARROW_C_DATA_INTERFACE
+
+#	define ARROW_FLAG_DICTIONARY_ORDERED 1
+#	define ARROW_FLAG_NULLABLE 2
+#	define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema
+{
+	const char* format;
+	const char* name;
+	const char* metadata;
+	int64_t flags;
+	int64_t n_children;
+	struct ArrowSchema** children;
+	struct ArrowSchema* dictionary;
+	void (*release)(struct ArrowSchema*);
+	void* private_data;
+};
+
+struct ArrowArray
+{
+	int64_t length;
+	int64_t null_count;
+	int64_t offset;
+	int64_t n_buffers;
+	int64_t n_children;
+	const void** buffers;
+	struct ArrowArray** children;
+	struct ArrowArray* dictionary;
+	void (*release)(struct ArrowArray*);
+	void* private_data;
+};
+#endif
+
+#ifndef ARROW_C_STREAM_INTERFACE
+#	define ARROW_C_STREAM_INTERFACE
+
+struct ArrowArrayStream
+{
+	int (*get_schema)(struct ArrowArrayStream*, struct ArrowSchema* out);
+	int (*get_next)(struct ArrowArrayStream*, struct ArrowArray* out);
+	const char* (*get_last_error)(struct ArrowArrayStream*);
+	void (*release)(struct ArrowArrayStream*);
+	void* private_data;
+};
+#endif
+}
+
+#endif
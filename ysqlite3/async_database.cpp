@@ -0,0 +1,336 @@
+#include "async_database.hpp"
+
+#include "finally.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+using namespace ysqlite3;
+
+namespace {
+
+template<typename Result>
+std::function<void(std::exception_ptr, Result)> fulfill(std::shared_ptr<std::promise<Result>> promise)
+{
+	return [promise](std::exception_ptr error, Result result) {
+		if (error) {
+			promise->set_exception(error);
+		} else {
+			promise->set_value(std::move(result));
+		}
+	};
+}
+
+/// Steps the statement up to `max_rows` times.
+void fetch(Statement& statement, std::size_t max_rows, Query_result& result)
+{
+	result.columns = statement.columns();
+	for (std::size_t i = 0; i < max_rows; ++i) {
+		if (!statement.step()) {
+			result.done = true;
+			return;
+		}
+		result.rows.emplace_back(statement.handle());
+	}
+}
+
+} // namespace
+
+Cancellation::Cancellation() : _state{ std::make_shared<State>() }
+{}
+
+Cancellation::Cancellation(std::nullptr_t) noexcept
+{}
+
+void Cancellation::cancel() noexcept
+{
+	if (_state) {
+		_state->cancelled = true;
+		std::lock_guard<std::mutex> lock{ _state->mutex };
+		if (_state->running) {
+			sqlite3_interrupt(_state->running);
+		}
+	}
+}
+
+bool Cancellation::cancelled() const noexcept
+{
+	return _state && _state->cancelled;
+}
+
+Async_database::Cursor::Cursor(std::shared_ptr<State> database, std::shared_ptr<Position> position) noexcept
+    : _database{ std::move(database) }, _position{ std::move(position) }
+{}
+
+Async_database::Cursor::~Cursor()
+{
+	if (_database) {
+		auto position = std::move(_position);
+		try {
+			// the last reference is dropped by the executor
+			_post(_database, [position] {});
+		} catch (...) {
+		}
+	}
+}
+
+Async_database::Async_database(Database database, std::shared_ptr<Executor> executor)
+    : _executor{ std::move(executor) }, _state{ std::make_shared<State>() }
+{
+	if (!database.is_open()) {
+		throw std::system_error{ Error::database_is_closed };
+	}
+	_state->database = std::move(database);
+	_state->executor = _executor.get();
+	sqlite3_progress_handler(_state->database.handle(), 1000, &Async_database::_progress, _state.get());
+}
+
+Async_database::~Async_database()
+{}
+
+std::future<std::size_t> Async_database::async_execute(std::string sql, Cancellation cancellation)
+{
+	const auto promise = std::make_shared<std::promise<std::size_t>>();
+	auto future        = promise->get_future();
+	async_execute(std::move(sql), fulfill(promise), std::move(cancellation));
+	return future;
+}
+
+void Async_database::async_execute(std::string sql, Execute_callback done, Cancellation cancellation)
+{
+	const auto rows = std::make_shared<std::size_t>(0);
+	_submit(
+	    std::move(cancellation), [sql, rows](Database& database) { *rows = database.execute(sql.c_str()); },
+	    [done, rows](std::exception_ptr error) { done(error, *rows); });
+}
+
+std::future<Query_result> Async_database::async_query(std::string sql, Binder bind, Cancellation cancellation)
+{
+	const auto promise = std::make_shared<std::promise<Query_result>>();
+	auto future        = promise->get_future();
+	async_query(std::move(sql), std::move(bind), fulfill(promise), std::move(cancellation));
+	return future;
+}
+
+void Async_database::async_query(std::string sql, Binder bind, Query_callback done, Cancellation cancellation)
+{
+	const auto result = std::make_shared<Query_result>();
+	_submit(
+	    std::move(cancellation),
+	    [sql, bind, result](Database& database) {
+		    auto statement = database.prepare_cached(sql.c_str());
+		    if (bind) {
+			    bind(statement);
+		    }
+		    fetch(statement, static_cast<std::size_t>(-1), *result);
+	    },
+	    [done, result](std::exception_ptr error) { done(error, std::move(*result)); });
+}
+
+Async_database::Cursor Async_database::cursor(std::string sql, Binder bind)
+{
+	const auto position = std::make_shared<Cursor::Position>();
+	position->sql       = std::move(sql);
+	position->bind      = std::move(bind);
+	return { _state, position };
+}
+
+std::future<Query_result> Async_database::async_step_batch(Cursor& cursor, std::size_t max_rows,
+                                                           Cancellation cancellation)
+{
+	const auto promise = std::make_shared<std::promise<Query_result>>();
+	auto future        = promise->get_future();
+	async_step_batch(cursor, max_rows, fulfill(promise), std::move(cancellation));
+	return future;
+}
+
+void Async_database::async_step_batch(Cursor& cursor, std::size_t max_rows, Query_callback done,
+                                      Cancellation cancellation)
+{
+	const auto position = cursor._position;
+	const auto result   = std::make_shared<Query_result>();
+	_submit(
+	    std::move(cancellation),
+	    [position, max_rows, result](Database& database) {
+		    if (position->done) {
+			    result->done = true;
+			    return;
+		    } else if (!position->statement.is_open()) {
+			    position->statement = database.prepare_statement(position->sql.c_str());
+			    if (position->bind) {
+				    position->bind(position->statement);
+			    }
+		    }
+
+		    try {
+			    fetch(position->statement, max_rows, *result);
+		    } catch (...) {
+			    position->done = true;
+			    position->statement.close();
+			    throw;
+		    }
+		    if (result->done) {
+			    position->done = true;
+			    position->statement.close();
+		    }
+	    },
+	    [done, result](std::exception_ptr error) { done(error, std::move(*result)); });
+}
+
+void Async_database::_post(const std::shared_ptr<State>& state, std::function<void()> task)
+{
+	std::size_t index = 0;
+	{
+		std::lock_guard<std::mutex> lock{ state->mutex };
+		index = state->tasks.size();
+		state->tasks.push_back(std::move(task));
+		if (state->scheduled) {
+			return;
+		}
+		state->scheduled = true;
+	}
+
+	// without the lock, because the executor may run the task right away
+	try {
+		state->executor->post([state] { _drain(state); });
+	} catch (...) {
+		// the caller gets the error, so the task must not run; no drain takes tasks from the front until
+		// the next one is posted, hence it is still at its index. The other queued tasks run with the next one.
+		std::lock_guard<std::mutex> lock{ state->mutex };
+		state->tasks.erase(state->tasks.begin() + static_cast<std::ptrdiff_t>(index));
+		state->scheduled = false;
+		throw;
+	}
+}
+
+void Async_database::_drain(const std::shared_ptr<State>& state) noexcept
+{
+	// other databases of the executor get a turn after a few tasks
+	for (int i = 0; i < 16; ++i) {
+		std::function<void()> task;
+		{
+			std::lock_guard<std::mutex> lock{ state->mutex };
+			if (state->tasks.empty()) {
+				state->scheduled = false;
+				return;
+			}
+			task = std::move(state->tasks.front());
+			state->tasks.pop_front();
+		}
+		task();
+	}
+
+	try {
+		state->executor->post([state] { _drain(state); });
+	} catch (...) {
+		std::lock_guard<std::mutex> lock{ state->mutex };
+		state->scheduled = false;
+	}
+}
+
+int Async_database::_progress(void* state) noexcept
+{
+	const auto running = static_cast<State*>(state)->running;
+	return running && running->cancelled;
+}
+
+void Async_database::_submit(Cancellation cancellation, std::function<void(Database&)> work,
+                             std::function<void(std::exception_ptr)> done)
+{
+	const auto state = _state;
+	_post(state, [state, cancellation, work, done] {
+		const auto token = cancellation._state.get();
+		std::exception_ptr error;
+		try {
+			if (token) {
+				std::lock_guard<std::mutex> lock{ token->mutex };
+				token->running = state->database.handle();
+			}
+			const auto _ = finally([&] {
+				state->running = nullptr;
+				if (token) {
+					std::lock_guard<std::mutex> lock{ token->mutex };
+					token->running = nullptr;
+				}
+			});
+			// checked after publishing the connection, so a concurrent cancel() is never missed
+			if (token && token->cancelled) {
+				throw std::system_error{ SQLite3_code::operation_interrupted };
+			}
+			state->running = token;
+			work(state->database);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		try {
+			done(error);
+		} catch (...) {
+		}
+	});
+}
+
+#if YSQLITE3_ENABLE_COROUTINES
+Awaitable<std::size_t> Async_database::execute(std::string sql, Executor* resume_on, Cancellation cancellation)
+{
+	return { [this, sql, cancellation](Awaitable<std::size_t>::Callback done) {
+		        async_execute(sql, std::move(done), cancellation);
+	        },
+		       resume_on };
+}
+
+Awaitable<Query_result> Async_database::query(std::string sql, Binder bind, Executor* resume_on,
+                                              Cancellation cancellation)
+{
+	return { [this, sql, bind, cancellation](Awaitable<Query_result>::Callback done) {
+		        async_query(sql, bind, std::move(done), cancellation);
+	        },
+		       resume_on };
+}
+
+Awaitable<Query_result> Async_database::step_batch(Cursor& cursor, std::size_t max_rows, Executor* resume_on,
+                                                   Cancellation cancellation)
+{
+	return { [this, &cursor, max_rows, cancellation](Awaitable<Query_result>::Callback done) {
+		        async_step_batch(cursor, max_rows, std::move(done), cancellation);
+	        },
+		       resume_on };
+}
+
+Row_stream Async_database::rows(std::string sql, Binder bind, std::size_t batch_size, Executor* resume_on)
+{
+	return { *this, cursor(std::move(sql), std::move(bind)), batch_size, resume_on };
+}
+
+Row_stream::Row_stream(Async_database& database, Async_database::Cursor cursor, std::size_t batch_size,
+                       Executor* resume_on) noexcept
+    : _database{ &database }, _cursor{ std::move(cursor) }, _batch_size{ std::max<std::size_t>(batch_size, 1) },
+      _resume_on{ resume_on }
+{}
+
+Awaitable<bool> Row_stream::next()
+{
+	if (_index + 1 < _batch.rows.size()) {
+		++_index;
+		return Awaitable<bool>{ true };
+	} else if (_batch.done) {
+		return Awaitable<bool>{ false };
+	}
+
+	return { [this](Awaitable<bool>::Callback done) {
+		        _database->async_step_batch(_cursor, _batch_size,
+		                                    [this, done](std::exception_ptr error, Query_result batch) {
+			                                    _batch = std::move(batch);
+			                                    _index = 0;
+			                                    done(error, !_batch.rows.empty());
+		                                    });
+	        },
+		       _resume_on };
+}
+
+Row& Row_stream::row() noexcept
+{
+	return _batch.rows[_index];
+}
+#endif
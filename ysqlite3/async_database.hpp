@@ -0,0 +1,266 @@
+#ifndef YSQLITE3_ASYNC_DATABASE_HPP_
+#define YSQLITE3_ASYNC_DATABASE_HPP_
+
+#include "awaitable.hpp"
+#include "config.hpp"
+#include "database.hpp"
+#include "executor.hpp"
+#include "row.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ysqlite3 {
+
+struct Query_result
+{
+	std::vector<std::string> columns;
+	std::vector<Row> rows;
+	/// Whether the statement returned all of its rows.
+	bool done = false;
+};
+
+class Async_database;
+class Row_stream;
+
+/**
+ * Cancels the tasks it was passed to. A queued task fails with SQLite3_code::operation_interrupted without
+ * running, a running task is stopped with sqlite3_interrupt(). Copies share their state.
+ */
+class Cancellation
+{
+public:
+	Cancellation();
+	/// A token which cannot be cancelled.
+	explicit Cancellation(std::nullptr_t) noexcept;
+	/// Cancels all tasks of this token. Does nothing if the token cannot be cancelled.
+	void cancel() noexcept;
+	bool cancelled() const noexcept;
+
+private:
+	friend Async_database;
+
+	struct State
+	{
+		std::atomic<bool> cancelled{ false };
+		std::mutex mutex;
+		/// The connection of the running task.
+		sqlite3* running = nullptr;
+	};
+
+	std::shared_ptr<State> _state;
+};
+
+/**
+ * Runs queries on an executor so the calling thread never waits for SQLite. The connection is only used by
+ * one task at a time: the tasks of a database are queued and run in order, even if the executor has more
+ * threads. This keeps the SQLite threading rules for connections opened with `open_flag_no_mutex`, and many
+ * databases can share one executor.
+ *
+ * Every operation either returns a future or calls a completion callback on the executor. The callback gets
+ * the exception of a failed task; it must not throw and must not wait for other tasks of this database.
+ * If the executor cannot queue the task, the operation throws the exception of Executor::post() and the
+ * task never runs.
+ * The progress handler of the connection is used for cancellation.
+ *
+ * With `YSQLITE3_ENABLE_COROUTINES` the operations are also available for `co_await`. A coroutine which is
+ * resumed on the executor must not wait for this database without `co_await`.
+ */
+class Async_database
+{
+	struct State;
+
+public:
+	typedef std::function<void(Statement&)> Binder;
+	typedef std::function<void(std::exception_ptr, std::size_t)> Execute_callback;
+	typedef std::function<void(std::exception_ptr, Query_result)> Query_callback;
+
+	/**
+	 * A statement whose rows are fetched in batches with async_step_batch(). The statement is prepared by the
+	 * first batch and finalized after the last one or when the cursor is destroyed. A cursor must not outlive
+	 * its database.
+	 */
+	class Cursor
+	{
+	public:
+		Cursor(Cursor&& move) noexcept = default;
+		/// Finalizes the statement on the executor.
+		~Cursor();
+
+	private:
+		friend Async_database;
+
+		struct Position
+		{
+			std::string sql;
+			Binder bind;
+			Statement statement{ nullptr, nullptr };
+			bool done = false;
+		};
+
+		std::shared_ptr<State> _database;
+		std::shared_ptr<Position> _position;
+
+		Cursor(std::shared_ptr<State> database, std::shared_ptr<Position> position) noexcept;
+	};
+
+	/**
+	 * Constructor.
+	 *
+	 * @exception std::system_error Error::database_is_closed if the database is not open
+	 * @param database the open database; it is only used by the executor from now on
+	 * @param executor runs the tasks; by default a dedicated thread
+	 */
+	Async_database(Database database, std::shared_ptr<Executor> executor = std::make_shared<Thread_executor>());
+	Async_database(const Async_database& copy) = delete;
+	/**
+	 * Queued tasks still run. If the executor is destroyed with this object, it finishes them first; then this
+	 * object must not be destroyed by one of its callbacks.
+	 */
+	~Async_database();
+	/**
+	 * Runs the SQL statements.
+	 *
+	 * @param sql zero or more SQL statements
+	 * @param cancellation (opt) cancels the task
+	 * @return the future of the returned result rows; see Database::execute() for exceptions
+	 */
+	std::future<std::size_t> async_execute(std::string sql,
+	                                       Cancellation cancellation = Cancellation{ nullptr });
+	void async_execute(std::string sql, Execute_callback done,
+	                   Cancellation cancellation = Cancellation{ nullptr });
+	/**
+	 * Runs the query and copies all rows.
+	 *
+	 * @param sql the SQL statement; it is cached by the statement cache of the connection
+	 * @param bind (opt) binds the parameters on the executor
+	 * @param cancellation (opt) cancels the task
+	 * @return the future of the rows
+	 */
+	std::future<Query_result> async_query(std::string sql, Binder bind = nullptr,
+	                                      Cancellation cancellation = Cancellation{ nullptr });
+	void async_query(std::string sql, Binder bind, Query_callback done,
+	                 Cancellation cancellation = Cancellation{ nullptr });
+	/**
+	 * Creates a cursor for the statement; nothing is run yet.
+	 *
+	 * @param sql the SQL statement
+	 * @param bind (opt) binds the parameters on the executor
+	 * @return the cursor
+	 */
+	Cursor cursor(std::string sql, Binder bind = nullptr);
+	/**
+	 * Fetches the next rows of the cursor. A result with `done` set is the last one. Batches of one cursor
+	 * run in the order they were requested.
+	 *
+	 * @param cursor the cursor
+	 * @param max_rows the maximum number of rows
+	 * @param cancellation (opt) cancels the task; the cursor is finished afterwards
+	 * @return the future of the rows
+	 */
+	std::future<Query_result> async_step_batch(Cursor& cursor, std::size_t max_rows,
+	                                           Cancellation cancellation = Cancellation{ nullptr });
+	void async_step_batch(Cursor& cursor, std::size_t max_rows, Query_callback done,
+	                      Cancellation cancellation = Cancellation{ nullptr });
+#if YSQLITE3_ENABLE_COROUTINES
+	/**
+	 * Awaitable version of async_execute().
+	 *
+	 * @param sql zero or more SQL statements
+	 * @param resume_on (opt) resumes the coroutine; by default it is resumed on the executor of this database
+	 * @param cancellation (opt) cancels the task
+	 * @return the number of returned result rows
+	 */
+	Awaitable<std::size_t> execute(std::string sql, Executor* resume_on = nullptr,
+	                               Cancellation cancellation = Cancellation{ nullptr });
+	/// Awaitable version of async_query(); see execute() for `resume_on`.
+	Awaitable<Query_result> query(std::string sql, Binder bind = nullptr, Executor* resume_on = nullptr,
+	                              Cancellation cancellation = Cancellation{ nullptr });
+	/// Awaitable version of async_step_batch(); see execute() for `resume_on`.
+	Awaitable<Query_result> step_batch(Cursor& cursor, std::size_t max_rows, Executor* resume_on = nullptr,
+	                                   Cancellation cancellation = Cancellation{ nullptr });
+	/**
+	 * Returns the rows of the query one by one while fetching them in batches.
+	 *
+	 * @param sql the SQL statement
+	 * @param bind (opt) binds the parameters on the executor
+	 * @param batch_size the rows fetched at once
+	 * @param resume_on (opt) see execute()
+	 * @return the rows
+	 */
+	Row_stream rows(std::string sql, Binder bind = nullptr, std::size_t batch_size = 256,
+	                Executor* resume_on = nullptr);
+#endif
+	Async_database& operator=(const Async_database& copy) = delete;
+
+private:
+	struct State
+	{
+		Database database;
+		Executor* executor;
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+		/// Whether a task draining the queue was posted to the executor.
+		bool scheduled = false;
+		/// The token of the running task.
+		Cancellation::State* running = nullptr;
+	};
+
+	std::shared_ptr<Executor> _executor;
+	std::shared_ptr<State> _state;
+
+	static void _post(const std::shared_ptr<State>& state, std::function<void()> task);
+	static void _drain(const std::shared_ptr<State>& state) noexcept;
+	static int _progress(void* state) noexcept;
+	void _submit(Cancellation cancellation, std::function<void(Database&)> work,
+	             std::function<void(std::exception_ptr)> done);
+};
+
+#if YSQLITE3_ENABLE_COROUTINES
+/**
+ * An asynchronous generator over the rows of a query:
+ *
+ * ```cpp
+ * auto rows = db.rows("SELECT a FROM t");
+ * while (co_await rows.next()) {
+ *   use(rows.row().integer(0));
+ * }
+ * ```
+ *
+ * The stream must not be moved while a call to next() is awaited.
+ */
+class Row_stream
+{
+public:
+	Row_stream(Async_database& database, Async_database::Cursor cursor, std::size_t batch_size,
+	           Executor* resume_on) noexcept;
+	/**
+	 * Advances to the next row and fetches the next batch if required.
+	 *
+	 * @return `false` if there are no more rows
+	 */
+	Awaitable<bool> next();
+	/// The current row.
+	Row& row() noexcept;
+
+private:
+	Async_database* _database;
+	Async_database::Cursor _cursor;
+	std::size_t _batch_size;
+	Executor* _resume_on;
+	Query_result _batch;
+	std::size_t _index = 0;
+};
+#endif
+
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef YSQLITE3_AWAITABLE_HPP_
+#define YSQLITE3_AWAITABLE_HPP_
+
+#include "config.hpp"
+
+#if YSQLITE3_ENABLE_COROUTINES
+#	include "executor.hpp"
+
+#	include <coroutine>
+#	include <exception>
+#	include <functional>
+#	include <utility>
+
+namespace ysqlite3 {
+
+/**
+ * The result of an asynchronous operation for `co_await`. The operation starts when the coroutine is
+ * suspended. The coroutine is resumed on the given executor or, without one, on the thread which completed
+ * the operation.
+ *
+ * @tparam Result the default constructible result
+ */
+template<typename Result>
+class Awaitable
+{
+public:
+	typedef std::function<void(std::exception_ptr, Result)> Callback;
+	typedef std::function<void(Callback)> Start;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param start starts the operation which calls the callback exactly once
+	 * @param resume_on (opt) the executor which resumes the coroutine
+	 */
+	Awaitable(Start start, Executor* resume_on) noexcept : _start{ std::move(start) }, _resume_on{ resume_on }
+	{}
+	/// An operation which already completed.
+	explicit Awaitable(Result result) : _ready{ true }, _result{ std::move(result) }
+	{}
+	bool await_ready() const noexcept
+	{
+		return _ready;
+	}
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		_start([this, handle](std::exception_ptr error, Result result) {
+			_error  = error;
+			_result = std::move(result);
+			if (_resume_on) {
+				try {
+					_resume_on->post([handle] { handle.resume(); });
+					return;
+				} catch (...) {
+				}
+			}
+			handle.resume();
+		});
+	}
+	/**
+	 * Returns the result.
+	 *
+	 * @exception any the exception of the operation
+	 */
+	Result await_resume()
+	{
+		if (_error) {
+			std::rethrow_exception(_error);
+		}
+		return std::move(_result);
+	}
+
+private:
+	Start _start;
+	Executor* _resume_on = nullptr;
+	bool _ready          = false;
+	std::exception_ptr _error;
+	Result _result{};
+};
+
+} // namespace ysqlite3
+
+#endif
+
+#endif
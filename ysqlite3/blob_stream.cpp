@@ -0,0 +1,251 @@
+#include "blob_stream.hpp"
+
+#include <algorithm>
+#include <utility>
+
+using namespace ysqlite3;
+
+Blob_stream::Blob_stream(Database& database, const char* table, const char* column, sqlite3_int64 row,
+                         bool writable, const char* schema)
+    : _schema{ schema }, _table{ table }, _column{ column }, _writable{ writable }
+{
+	if (!database.is_open()) {
+		throw std::system_error{ Error::database_is_closed };
+	}
+
+	_database = database.handle();
+	if (const auto ec = sqlite3_blob_open(_database, schema, table, column, row, writable, &_blob)) {
+		// the handle is set to null on failure
+		throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+	}
+	_size = static_cast<std::size_t>(sqlite3_blob_bytes(_blob));
+}
+
+Blob_stream::Blob_stream(Blob_stream&& move) noexcept
+{
+	std::swap(_blob, move._blob);
+	std::swap(_database, move._database);
+	std::swap(_size, move._size);
+	std::swap(_position, move._position);
+	std::swap(_schema, move._schema);
+	std::swap(_table, move._table);
+	std::swap(_column, move._column);
+	std::swap(_writable, move._writable);
+}
+
+Blob_stream::~Blob_stream()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void Blob_stream::reopen(sqlite3_int64 row)
+{
+	if (!_database) {
+		throw std::system_error{ Error::blob_is_closed };
+	}
+
+	_size     = 0;
+	_position = 0;
+	auto ec   = _blob ? sqlite3_blob_reopen(_blob, row) : SQLITE_ABORT;
+	// SQLite finalizes the statement of an aborted blob
+	if (ec == SQLITE_ABORT) {
+		sqlite3_blob_close(_blob);
+		_blob = nullptr;
+		ec    = sqlite3_blob_open(_database, _schema.c_str(), _table.c_str(), _column.c_str(), row, _writable,
+		                          &_blob);
+	}
+	if (ec) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+	}
+	_size = static_cast<std::size_t>(sqlite3_blob_bytes(_blob));
+}
+
+std::size_t Blob_stream::read(void* buffer, std::size_t size)
+{
+	_check_open();
+
+	size = std::min(size, _size - _position);
+	if (size) {
+		if (const auto ec =
+		        sqlite3_blob_read(_blob, buffer, static_cast<int>(size), static_cast<int>(_position))) {
+			throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+		}
+		_position += size;
+	}
+	return size;
+}
+
+void Blob_stream::write(const void* data, std::size_t size)
+{
+	_check_open();
+
+	if (size > _size - _position) {
+		throw std::system_error{ Error::out_of_bounds };
+	} else if (size) {
+		if (const auto ec =
+		        sqlite3_blob_write(_blob, data, static_cast<int>(size), static_cast<int>(_position))) {
+			throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+		}
+		_position += size;
+	}
+}
+
+void Blob_stream::seek(std::size_t position)
+{
+	_check_open();
+
+	if (position > _size) {
+		throw std::system_error{ Error::out_of_bounds };
+	}
+	_position = position;
+}
+
+std::size_t Blob_stream::tell() const noexcept
+{
+	return _position;
+}
+
+std::size_t Blob_stream::size() const noexcept
+{
+	return _size;
+}
+
+bool Blob_stream::eof() const noexcept
+{
+	return _position == _size;
+}
+
+void Blob_stream::close()
+{
+	const auto ec = sqlite3_blob_close(_blob);
+	_blob         = nullptr;
+	_database     = nullptr;
+	_size         = 0;
+	_position     = 0;
+	if (ec) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec) };
+	}
+}
+
+bool Blob_stream::is_open() const noexcept
+{
+	return _database;
+}
+
+sqlite3_blob* Blob_stream::handle() noexcept
+{
+	return _blob;
+}
+
+Blob_stream& Blob_stream::operator=(Blob_stream&& move) noexcept
+{
+	std::swap(_blob, move._blob);
+	std::swap(_database, move._database);
+	std::swap(_size, move._size);
+	std::swap(_position, move._position);
+	std::swap(_schema, move._schema);
+	std::swap(_table, move._table);
+	std::swap(_column, move._column);
+	std::swap(_writable, move._writable);
+	return *this;
+}
+
+void Blob_stream::_check_open() const
+{
+	if (!is_open()) {
+		throw std::system_error{ Error::blob_is_closed };
+	} else if (!_blob) {
+		throw std::system_error{ SQLite3_code::abort };
+	}
+}
+
+Blob_streambuf::Blob_streambuf(Blob_stream& blob, std::size_t buffer_size)
+    : _blob{ &blob }, _buffer(std::max<std::size_t>(buffer_size, 1))
+{}
+
+Blob_streambuf::~Blob_streambuf()
+{
+	sync();
+}
+
+Blob_streambuf::int_type Blob_streambuf::underflow()
+{
+	if (sync()) {
+		return traits_type::eof();
+	}
+
+	try {
+		const auto size = _blob->read(_buffer.data(), _buffer.size());
+		if (size) {
+			setg(_buffer.data(), _buffer.data(), _buffer.data() + size);
+			return traits_type::to_int_type(*gptr());
+		}
+	} catch (...) {
+	}
+	return traits_type::eof();
+}
+
+Blob_streambuf::int_type Blob_streambuf::overflow(int_type c)
+{
+	if (sync()) {
+		return traits_type::eof();
+	}
+
+	setp(_buffer.data(), _buffer.data() + _buffer.size());
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+int Blob_streambuf::sync()
+{
+	try {
+		if (pptr() > pbase()) {
+			const auto size = static_cast<std::size_t>(pptr() - pbase());
+			setp(nullptr, nullptr);
+			_blob->write(_buffer.data(), size);
+		} else if (gptr() < egptr()) {
+			// the blob is ahead by the unread data
+			_blob->seek(_blob->tell() - static_cast<std::size_t>(egptr() - gptr()));
+		}
+		setp(nullptr, nullptr);
+		setg(nullptr, nullptr, nullptr);
+		return 0;
+	} catch (...) {
+		return -1;
+	}
+}
+
+Blob_streambuf::pos_type Blob_streambuf::seekoff(off_type offset, std::ios_base::seekdir direction,
+                                                 std::ios_base::openmode)
+{
+	if (sync()) {
+		return pos_type(off_type(-1));
+	}
+
+	off_type base = 0;
+	if (direction == std::ios_base::cur) {
+		base = static_cast<off_type>(_blob->tell());
+	} else if (direction == std::ios_base::end) {
+		base = static_cast<off_type>(_blob->size());
+	}
+	if (base + offset < 0) {
+		return pos_type(off_type(-1));
+	}
+	try {
+		_blob->seek(static_cast<std::size_t>(base + offset));
+	} catch (...) {
+		return pos_type(off_type(-1));
+	}
+	return pos_type(base + offset);
+}
+
+Blob_streambuf::pos_type Blob_streambuf::seekpos(pos_type position, std::ios_base::openmode which)
+{
+	return seekoff(off_type(position), std::ios_base::beg, which);
+}
@@ -0,0 +1,145 @@
+#ifndef YSQLITE3_BLOB_STREAM_HPP_
+#define YSQLITE3_BLOB_STREAM_HPP_
+
+#include "database.hpp"
+#include "sqlite3.h"
+
+#include <cstddef>
+#include <ios>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace ysqlite3 {
+
+/**
+ * Reads and writes a blob in chunks with sqlite3_blob_read() and sqlite3_blob_write(), so only the chunk is
+ * in memory. The size of a blob cannot be changed; reserve it with `zeroblob()` or Statement::bind_zeros()
+ * first. With `PRAGMA mmap_size`, SQLite reads the pages through the fetch method of the VFS and copies them
+ * only once into the buffer of the caller.
+ *
+ * If the row is changed or deleted by another statement, the stream is aborted and every further access fails
+ * with SQLite3_code::abort until it is moved to another row with reopen().
+ */
+class Blob_stream
+{
+public:
+	/**
+	 * Opens the blob.
+	 *
+	 * @exception std::system_error Error::database_is_closed or see sqlite3_blob_open()
+	 * @param database the database which must outlive this stream
+	 * @param table the table
+	 * @param column the column
+	 * @param row the rowid of the row
+	 * @param writable whether the blob can be written
+	 * @param schema the database of the table
+	 */
+	Blob_stream(Database& database, const char* table, const char* column, sqlite3_int64 row,
+	            bool writable = false, const char* schema = "main");
+	/// The moved object will be closed.
+	Blob_stream(Blob_stream&& move) noexcept;
+	Blob_stream(const Blob_stream& copy) = delete;
+	~Blob_stream();
+	/**
+	 * Moves to the same column of another row and to the beginning of its blob. This is faster than opening a
+	 * new stream. An aborted stream is opened again.
+	 *
+	 * @exception std::system_error Error::blob_is_closed or see sqlite3_blob_reopen(); the stream is
+	 * aborted afterwards
+	 * @param row the rowid of the row
+	 */
+	void reopen(sqlite3_int64 row);
+	/**
+	 * Reads from the current position and advances it.
+	 *
+	 * @exception std::system_error Error::blob_is_closed or see sqlite3_blob_read()
+	 * @param[out] buffer the buffer
+	 * @param size the size of the buffer
+	 * @return the number of bytes read; less than `size` only at the end of the blob
+	 */
+	std::size_t read(void* buffer, std::size_t size);
+	/**
+	 * Writes at the current position and advances it.
+	 *
+	 * @exception std::system_error
+	 *   - Error::blob_is_closed
+	 *   - Error::out_of_bounds if the data does not fit into the blob
+	 *   - see sqlite3_blob_write()
+	 * @param data the data
+	 * @param size the size of the data
+	 */
+	void write(const void* data, std::size_t size);
+	/**
+	 * Sets the position.
+	 *
+	 * @exception std::system_error Error::blob_is_closed or Error::out_of_bounds if the position is beyond
+	 * the end
+	 * @param position the new position
+	 */
+	void seek(std::size_t position);
+	std::size_t tell() const noexcept;
+	/// Returns the size of the blob.
+	std::size_t size() const noexcept;
+	/// Whether the position is at the end of the blob.
+	bool eof() const noexcept;
+	/**
+	 * Closes the stream. Closing a closed stream has no effect.
+	 *
+	 * @exception std::system_error if an earlier write failed
+	 */
+	void close();
+	bool is_open() const noexcept;
+	/// The SQLite3 blob handle or `nullptr` if the stream is closed or could not be opened again.
+	sqlite3_blob* handle() noexcept;
+	Blob_stream& operator=(Blob_stream&& move) noexcept;
+	Blob_stream& operator=(const Blob_stream& copy) = delete;
+
+private:
+	sqlite3_blob* _blob   = nullptr;
+	sqlite3* _database    = nullptr;
+	std::size_t _size     = 0;
+	std::size_t _position = 0;
+	/// Required to open an aborted stream again.
+	std::string _schema;
+	std::string _table;
+	std::string _column;
+	bool _writable = false;
+
+	void _check_open() const;
+};
+
+/**
+ * A stream buffer over a Blob_stream for `std::istream` and `std::ostream`. The data is transferred in chunks
+ * of the buffer size. Errors of the blob are reported as end of file; writing beyond the end of the blob
+ * fails.
+ */
+class Blob_streambuf : public std::streambuf
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param blob the blob which must outlive this buffer
+	 * @param buffer_size the size of the chunks
+	 */
+	explicit Blob_streambuf(Blob_stream& blob, std::size_t buffer_size = 65536);
+	/// Writes the buffered data.
+	~Blob_streambuf();
+
+protected:
+	int_type underflow() override;
+	int_type overflow(int_type c) override;
+	int sync() override;
+	pos_type seekoff(off_type offset, std::ios_base::seekdir direction,
+	                 std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type position, std::ios_base::openmode which) override;
+
+private:
+	Blob_stream* _blob;
+	std::vector<char> _buffer;
+};
+
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,59 @@
+#include "bulk.hpp"
+
+using namespace ysqlite3;
+
+Bulk_column::Bulk_column(const std::vector<sqlite3_int64>& values) noexcept
+    : _type{ Type::integer }, _values{ &values }, _size{ values.size() }
+{}
+
+Bulk_column::Bulk_column(const std::vector<double>& values) noexcept
+    : _type{ Type::real }, _values{ &values }, _size{ values.size() }
+{}
+
+Bulk_column::Bulk_column(const std::vector<std::string>& values) noexcept
+    : _type{ Type::text }, _values{ &values }, _size{ values.size() }
+{}
+
+Bulk_column::Bulk_column(const std::vector<std::vector<std::uint8_t>>& values) noexcept
+    : _type{ Type::blob }, _values{ &values }, _size{ values.size() }
+{}
+
+Bulk_column& Bulk_column::set_nulls(const std::vector<bool>& nulls) noexcept
+{
+	_nulls = &nulls;
+	return *this;
+}
+
+std::size_t Bulk_column::size() const noexcept
+{
+	return _size;
+}
+
+int Bulk_column::bind(sqlite3_stmt* statement, int parameter, std::size_t row) const noexcept
+{
+	if (_nulls && (*_nulls)[row]) {
+		return sqlite3_bind_null(statement, parameter);
+	}
+
+	switch (_type) {
+	case Type::integer:
+		return sqlite3_bind_int64(statement, parameter,
+		                          (*static_cast<const std::vector<sqlite3_int64>*>(_values))[row]);
+	case Type::real:
+		return sqlite3_bind_double(statement, parameter,
+		                           (*static_cast<const std::vector<double>*>(_values))[row]);
+	case Type::text: {
+		const auto& value = (*static_cast<const std::vector<std::string>*>(_values))[row];
+		return sqlite3_bind_text64(statement, parameter, value.data(), value.size(), SQLITE_STATIC,
+		                           SQLITE_UTF8);
+	}
+	case Type::blob: {
+		const auto& value = (*static_cast<const std::vector<std::vector<std::uint8_t>>*>(_values))[row];
+		// an empty blob is not null
+		return sqlite3_bind_blob64(statement, parameter,
+		                           value.empty() ? "" : static_cast<const void*>(value.data()), value.size(),
+		                           SQLITE_STATIC);
+	}
+	}
+	return SQLITE_MISUSE;
+}
@@ -0,0 +1,85 @@
+#ifndef YSQLITE3_BULK_HPP_
+#define YSQLITE3_BULK_HPP_
+
+#include "sqlite3.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ysqlite3 {
+
+struct Bulk_options
+{
+	/// The rows inserted by one statement if the INSERT can be rewritten; 0 uses about 256 values per
+	/// statement.
+	std::size_t rows_per_statement = 0;
+	/// The rows committed at once if no transaction is active; 0 commits all rows at once.
+	std::size_t rows_per_transaction = 100000;
+};
+
+struct Bulk_status
+{
+	std::uint64_t rows         = 0;
+	std::uint64_t statements   = 0;
+	std::uint64_t transactions = 0;
+	/// The rows inserted by one statement.
+	std::size_t rows_per_statement = 1;
+	std::chrono::nanoseconds elapsed{ 0 };
+
+	double rows_per_second() const noexcept
+	{
+		return elapsed.count() ? rows * 1e9 / elapsed.count() : 0.0;
+	}
+};
+
+/**
+ * A column of values for Statement::execute_many(). The values are referenced, not copied, and bound without
+ * copying them again.
+ */
+class Bulk_column
+{
+public:
+	Bulk_column(const std::vector<sqlite3_int64>& values) noexcept;
+	Bulk_column(const std::vector<double>& values) noexcept;
+	Bulk_column(const std::vector<std::string>& values) noexcept;
+	/// A column of blobs.
+	Bulk_column(const std::vector<std::vector<std::uint8_t>>& values) noexcept;
+	/**
+	 * Marks values as null.
+	 *
+	 * @param nulls `true` for every null value; it must be as long as the column
+	 * @return this column
+	 */
+	Bulk_column& set_nulls(const std::vector<bool>& nulls) noexcept;
+	std::size_t size() const noexcept;
+	/**
+	 * Binds a value.
+	 *
+	 * @param statement the statement
+	 * @param parameter the 1-based parameter
+	 * @param row the row
+	 * @return the SQLite error code
+	 */
+	int bind(sqlite3_stmt* statement, int parameter, std::size_t row) const noexcept;
+
+private:
+	enum class Type
+	{
+		integer,
+		real,
+		text,
+		blob
+	};
+
+	Type _type;
+	const void* _values;
+	std::size_t _size;
+	const std::vector<bool>* _nulls = nullptr;
+};
+
+} // namespace ysqlite3
+
+#endif
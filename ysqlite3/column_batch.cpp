@@ -0,0 +1,247 @@
+#include "column_batch.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace ysqlite3;
+
+namespace {
+
+/// Derives the type from the declared type like SQLite derives the column affinity.
+Results::type declared_type(const char* declared)
+{
+	if (!declared) {
+		return Results::type::null;
+	}
+
+	std::string upper = declared;
+	for (auto& c : upper) {
+		if (c >= 'a' && c <= 'z') {
+			c = static_cast<char>(c - 'a' + 'A');
+		}
+	}
+	const auto contains = [&upper](const char* part) { return upper.find(part) != std::string::npos; };
+	if (contains("INT")) {
+		return Results::type::integer;
+	} else if (contains("CHAR") || contains("CLOB") || contains("TEXT")) {
+		return Results::type::text;
+	} else if (contains("REAL") || contains("FLOA") || contains("DOUB")) {
+		return Results::type::real;
+	}
+	// blob and numeric affinity store any type
+	return Results::type::null;
+}
+
+Results::type value_type(int type) noexcept
+{
+	switch (type) {
+	case SQLITE_INTEGER: return Results::type::integer;
+	case SQLITE_FLOAT: return Results::type::real;
+	case SQLITE_TEXT: return Results::type::text;
+	case SQLITE_BLOB: return Results::type::blob;
+	default: return Results::type::null;
+	}
+}
+
+/// Appends the value of a null row to the buffer of the column.
+void append_default(Column_batch::Column& column)
+{
+	switch (column.type) {
+	case Results::type::integer: column.integers.push_back(0); break;
+	case Results::type::real: column.reals.push_back(0); break;
+	case Results::type::text:
+	case Results::type::blob: column.offsets.push_back(column.offsets.back()); break;
+	case Results::type::null: break;
+	}
+}
+
+/// Appends the number as text like SQLite converts it; reals are printed with as many digits as needed.
+void append_text(Column_batch::Column& column, std::size_t row)
+{
+	char buffer[32];
+	int size = 0;
+	if (column.type == Results::type::integer) {
+		size = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(column.integers[row]));
+	} else {
+		const auto value = column.reals[row];
+		size             = std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+		if (std::strtod(buffer, nullptr) != value) {
+			size = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+		}
+	}
+	column.data.insert(column.data.end(), buffer, buffer + size);
+}
+
+/**
+ * Widens the type of the column so that it holds the next value without losing it: integers become reals,
+ * numbers become text or blobs and text becomes blobs. Integers are stored as reals in real columns, numbers
+ * as text in text columns and any value as its bytes in blob columns.
+ *
+ * @param column the column
+ * @param value the type of the next value
+ * @param rows the number of rows so far
+ */
+void widen(Column_batch::Column& column, Results::type value, std::size_t rows)
+{
+	using type = Results::type;
+	if (column.type == value || column.type == type::blob ||
+	    (column.type == type::text && value != type::blob) ||
+	    (column.type == type::real && value == type::integer)) {
+		return;
+	} else if (column.type == type::integer && value == type::real) {
+		column.reals.assign(column.integers.begin(), column.integers.end());
+		column.integers.clear();
+	} else if (column.type != type::text) {
+		column.offsets.assign(1, 0);
+		for (std::size_t row = 0; row < rows; ++row) {
+			if (!column.is_null(row)) {
+				append_text(column, row);
+			}
+			column.offsets.push_back(static_cast<std::int64_t>(column.data.size()));
+		}
+		column.integers.clear();
+		column.reals.clear();
+	}
+	column.type = value;
+}
+
+} // namespace
+
+std::size_t Column_batch::rows() const noexcept
+{
+	return _rows;
+}
+
+const std::vector<Column_batch::Column>& Column_batch::columns() const noexcept
+{
+	return _columns;
+}
+
+void Column_batch::clear() noexcept
+{
+	for (auto& column : _columns) {
+		column.null_count = 0;
+		column.validity.clear();
+		column.integers.clear();
+		column.reals.clear();
+		column.offsets.clear();
+		column.data.clear();
+	}
+	_rows = 0;
+}
+
+void Column_batch::reset() noexcept
+{
+	_columns.clear();
+	_rows = 0;
+}
+
+void Column_batch::set_type(std::size_t index, Results::type type)
+{
+	if (index >= _columns.size()) {
+		throw std::system_error{ Error::out_of_bounds };
+	}
+
+	auto& column = _columns[index];
+	if (column.type == type) {
+		return;
+	} else if (column.type != Results::type::null) {
+		widen(column, type, _rows);
+		if (column.type != type) {
+			throw std::system_error{ Error::bad_arguments };
+		}
+		return;
+	}
+	column.type = type;
+	if (type == Results::type::text || type == Results::type::blob) {
+		column.offsets.push_back(0);
+	}
+	for (std::size_t row = 0; row < _rows; ++row) {
+		append_default(column);
+	}
+}
+
+Column_batch Column_batch::layout() const
+{
+	Column_batch batch;
+	batch._columns.resize(_columns.size());
+	for (std::size_t i = 0; i < _columns.size(); ++i) {
+		batch._columns[i].name     = _columns[i].name;
+		batch._columns[i].type     = _columns[i].type;
+		batch._columns[i].inferred = _columns[i].inferred;
+	}
+	return batch;
+}
+
+void Column_batch::_prepare(sqlite3_stmt* statement, std::size_t capacity)
+{
+	const auto count = static_cast<std::size_t>(sqlite3_column_count(statement));
+	if (_columns.size() != count) {
+		_columns.clear();
+		_columns.resize(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			const auto name = sqlite3_column_name(statement, static_cast<int>(i));
+			_columns[i].name     = name ? name : "";
+			_columns[i].type     = declared_type(sqlite3_column_decltype(statement, static_cast<int>(i)));
+			_columns[i].inferred = _columns[i].type == Results::type::null;
+		}
+	}
+
+	clear();
+	for (auto& column : _columns) {
+		column.validity.resize((capacity + 7) / 8);
+		switch (column.type) {
+		case Results::type::integer: column.integers.reserve(capacity); break;
+		case Results::type::real: column.reals.reserve(capacity); break;
+		case Results::type::text:
+		case Results::type::blob:
+			column.offsets.reserve(capacity + 1);
+			column.offsets.push_back(0);
+			break;
+		case Results::type::null: break;
+		}
+	}
+}
+
+void Column_batch::_append(sqlite3_stmt* statement)
+{
+	for (std::size_t i = 0; i < _columns.size(); ++i) {
+		auto& column     = _columns[i];
+		const auto index = static_cast<int>(i);
+		const auto type  = sqlite3_column_type(statement, index);
+		if (type == SQLITE_NULL) {
+			++column.null_count;
+			append_default(column);
+			continue;
+		} else if (column.type == Results::type::null) {
+			// the previous rows of this batch were null
+			set_type(i, value_type(type));
+		} else {
+			widen(column, value_type(type), _rows);
+		}
+
+		column.validity[_rows / 8] |= static_cast<std::uint8_t>(1 << (_rows % 8));
+		switch (column.type) {
+		case Results::type::integer: column.integers.push_back(sqlite3_column_int64(statement, index)); break;
+		case Results::type::real: column.reals.push_back(sqlite3_column_double(statement, index)); break;
+		case Results::type::text:
+		case Results::type::blob: {
+			const auto text  = column.type == Results::type::text;
+			const auto value = static_cast<const std::uint8_t*>(
+			    text ? static_cast<const void*>(sqlite3_column_text(statement, index))
+			         : sqlite3_column_blob(statement, index));
+			const auto size = static_cast<std::size_t>(sqlite3_column_bytes(statement, index));
+			// an empty blob has no pointer
+			if (!value && (text || size)) {
+				throw std::system_error{ SQLite3_code::memory };
+			}
+			column.data.insert(column.data.end(), value, value + size);
+			column.offsets.push_back(static_cast<std::int64_t>(column.data.size()));
+			break;
+		}
+		case Results::type::null: break;
+		}
+	}
+	++_rows;
+}
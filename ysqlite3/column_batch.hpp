@@ -0,0 +1,105 @@
+#ifndef YSQLITE3_COLUMN_BATCH_HPP_
+#define YSQLITE3_COLUMN_BATCH_HPP_
+
+#include "results.hpp"
+#include "sqlite3.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ysqlite3 {
+
+class Statement;
+
+/**
+ * Rows of a query stored column by column in contiguous buffers, filled by Statement::fetch_columns(). The
+ * buffers keep their capacity when the batch is reused, so fetching further batches does not allocate.
+ *
+ * Every column has one type for all rows. It is derived from the declared type of the column like SQLite
+ * derives the affinity; otherwise the first value which is not null decides. A value which the type cannot
+ * hold widens the column with the rows so far: integers become reals, numbers become text and anything
+ * becomes a blob. Other values are converted by SQLite, so integers in a real column are rounded beyond
+ * 2^53. Once a column has a type it keeps it for all further batches of the statement, hence a later batch
+ * may have a wider type than an earlier one.
+ */
+class Column_batch
+{
+public:
+	struct Column
+	{
+		std::string name;
+		/// Results::type::null until the first value which is not null decided the type.
+		Results::type type     = Results::type::null;
+		/// Whether the values decide the type because the declared type has neither integer, real nor text
+		/// affinity.
+		bool inferred = false;
+		std::size_t null_count = 0;
+		/// One bit per row in LSB order, set if the value is not null.
+		std::vector<std::uint8_t> validity;
+		/// The values of an integer column; 0 for null.
+		std::vector<std::int64_t> integers;
+		/// The values of a real column; 0 for null.
+		std::vector<double> reals;
+		/// The values of a text or blob column are `data[offsets[i], offsets[i + 1])`.
+		std::vector<std::int64_t> offsets;
+		std::vector<std::uint8_t> data;
+
+		bool is_null(std::size_t row) const noexcept
+		{
+			return !(validity[row / 8] & (1 << (row % 8)));
+		}
+	};
+
+	/// Returns the number of rows.
+	std::size_t rows() const noexcept;
+	const std::vector<Column>& columns() const noexcept;
+	/// Removes all rows but keeps the columns, their types and the capacity.
+	void clear() noexcept;
+	/// Removes all columns; the batch can be used for another statement.
+	void reset() noexcept;
+	/**
+	 * Sets the type of a column whose values were all null so far or widens it like a value of the type
+	 * would.
+	 *
+	 * @exception std::system_error
+	 *   - Error::out_of_bounds if the column does not exist
+	 *   - Error::bad_arguments if the column has a type which cannot be widened to `type`
+	 * @param column the column
+	 * @param type the type
+	 */
+	void set_type(std::size_t column, Results::type type);
+	/**
+	 * Returns an empty batch with the columns and types of this batch, e.g. to fetch the next rows while this
+	 * batch is still in use.
+	 *
+	 * @return the batch
+	 */
+	Column_batch layout() const;
+
+private:
+	friend Statement;
+
+	std::vector<Column> _columns;
+	std::size_t _rows = 0;
+
+	/**
+	 * Prepares the columns for the next batch.
+	 *
+	 * @param statement the statement
+	 * @param capacity the maximum number of rows
+	 */
+	void _prepare(sqlite3_stmt* statement, std::size_t capacity);
+	/**
+	 * Appends the current row.
+	 *
+	 * @exception std::system_error SQLite3_code::memory if a value could not be converted
+	 * @param statement the statement
+	 */
+	void _append(sqlite3_stmt* statement);
+};
+
+} // namespace ysqlite3
+
+#endif
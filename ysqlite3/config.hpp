@@ -0,0 +1,13 @@
+#ifndef YSQLITE3_CONFIG_HPP_
+#define YSQLITE3_CONFIG_HPP_
+
+// clang-format off
+#define YSQLITE3_ENCRYPTION_BACKEND_OPENSSL 1
+#define YSQLITE3_BIG_ENDIAN 0
+#define YSQLITE3_ENABLE_COROUTINES 0
+#define YSQLITE3_ENABLE_SNAPSHOT 1
+#define YSQLITE3_CRYPT_VFS_NAME "ysqlite3-crypt"
+#define YSQLITE3_PIPELINE_VFS_NAME "ysqlite3-pipeline"
+// clang-format on
+
+#endif
@@ -0,0 +1,200 @@
+#include "connection_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <utility>
+
+using namespace ysqlite3;
+
+Pooled_connection::Pooled_connection(Connection_pool* pool, Slot* slot) noexcept
+    : _pool{ pool }, _slot{ slot }
+{}
+
+Pooled_connection::Pooled_connection(Pooled_connection&& move) noexcept
+{
+	std::swap(_pool, move._pool);
+	std::swap(_slot, move._slot);
+}
+
+Pooled_connection::~Pooled_connection()
+{
+	release();
+}
+
+void Pooled_connection::release() noexcept
+{
+	if (_slot) {
+		_pool->_release(_slot);
+		_pool = nullptr;
+		_slot = nullptr;
+	}
+}
+
+Database& Pooled_connection::operator*() const noexcept
+{
+	return *_slot->database;
+}
+
+Database* Pooled_connection::operator->() const noexcept
+{
+	return _slot->database.get();
+}
+
+const std::shared_ptr<Database>& Pooled_connection::shared() const noexcept
+{
+	return _slot->database;
+}
+
+Pooled_connection& Pooled_connection::operator=(Pooled_connection&& move) noexcept
+{
+	release();
+	std::swap(_pool, move._pool);
+	std::swap(_slot, move._slot);
+	return *this;
+}
+
+Connection_pool::Connection_pool(const char* uri, Connection_pool_options options)
+    : _uri{ uri }, _options{ std::move(options) }
+{
+	_reader_count = _options.readers ? _options.readers : std::max(std::thread::hardware_concurrency(), 1u);
+
+	// the writer creates the database and enables WAL before the readers open it
+	_writer.database = _open(true);
+	_writer.database->set_journal_mode(Journal_mode::wal);
+	_readers.reset(new Slot[_reader_count]);
+	for (std::size_t i = 0; i < _reader_count; ++i) {
+		_readers[i].database = _open(false);
+	}
+}
+
+Pooled_connection Connection_pool::read()
+{
+	auto connection = _acquire(_read_waiters, _readers.get(), _reader_count);
+	++_readers_in_use;
+	return connection;
+}
+
+Pooled_connection Connection_pool::write()
+{
+	return _acquire(_write_waiters, &_writer, 1);
+}
+
+Connection_pool_status Connection_pool::status() const noexcept
+{
+	Connection_pool_status status;
+	status.readers         = _reader_count;
+	status.readers_in_use  = _readers_in_use.load();
+	status.writer_in_use   = _writer.busy.load();
+	status.read_checkouts  = _read_waiters.checkouts.load();
+	status.write_checkouts = _write_waiters.checkouts.load();
+	status.read_waits      = _read_waiters.waits.load();
+	status.write_waits     = _write_waiters.waits.load();
+	status.read_wait_time  = std::chrono::microseconds{ _read_waiters.wait_time.load() };
+	status.write_wait_time = std::chrono::microseconds{ _write_waiters.wait_time.load() };
+	status.reopened        = _reopened.load();
+	return status;
+}
+
+std::shared_ptr<Database> Connection_pool::_open(bool writer) const
+{
+	auto database = std::make_shared<Database>();
+	database->open(_uri.c_str(),
+	               (writer ? open_flag_readwrite | open_flag_create : open_flag_readonly) | open_flag_uri |
+	                   open_flag_no_mutex,
+	               _options.vfs.empty() ? nullptr : _options.vfs.c_str());
+	const auto timeout = static_cast<int>(_options.busy_timeout.count());
+	if (const auto ec = sqlite3_busy_timeout(database->handle(), timeout)) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec) };
+	}
+
+	// loads the schema
+	database->prepare_cached("SELECT 1 FROM sqlite_master LIMIT 1").finish();
+	for (const auto& sql : _options.warm_statements) {
+		database->prepare_cached(sql.c_str());
+	}
+	return database;
+}
+
+Connection_pool::Slot* Connection_pool::_try_acquire(Slot* slots, std::size_t count,
+                                                     std::size_t start) noexcept
+{
+	for (std::size_t i = 0; i < count; ++i) {
+		auto& slot    = slots[(start + i) % count];
+		bool expected = false;
+		if (!slot.busy.load(std::memory_order_relaxed) &&
+		    slot.busy.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+			return &slot;
+		}
+	}
+	return nullptr;
+}
+
+Pooled_connection Connection_pool::_acquire(Waiters& waiters, Slot* slots, std::size_t count)
+{
+	// threads start at different slots so they do not compete for the first free one
+	const auto start = std::hash<std::thread::id>{}(std::this_thread::get_id());
+	++waiters.checkouts;
+	if (const auto slot = _try_acquire(slots, count, start)) {
+		return { this, slot };
+	}
+
+	const auto begin = std::chrono::steady_clock::now();
+	Slot* slot       = nullptr;
+	{
+		std::unique_lock<std::mutex> lock{ waiters.mutex };
+		++waiters.count;
+		// orders the count before the relaxed check of the slots: either this thread sees the slot which
+		// _release() freed or _release() sees this waiter
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		waiters.free.wait(lock, [&] { return (slot = _try_acquire(slots, count, start)) != nullptr; });
+		--waiters.count;
+	}
+	const auto waited = std::chrono::steady_clock::now() - begin;
+	++waiters.waits;
+	waiters.wait_time += std::chrono::duration_cast<std::chrono::microseconds>(waited).count();
+	return { this, slot };
+}
+
+void Connection_pool::_release(Slot* slot) noexcept
+{
+	_validate(slot);
+
+	auto& waiters = slot == &_writer ? _write_waiters : _read_waiters;
+	if (slot != &_writer) {
+		--_readers_in_use;
+	}
+	slot->busy.store(false);
+	// a waiter increments the count before it checks the slots
+	if (waiters.count.load()) {
+		std::lock_guard<std::mutex> lock{ waiters.mutex };
+		waiters.free.notify_one();
+	}
+}
+
+void Connection_pool::_validate(Slot* slot) noexcept
+{
+	if (const auto handle = slot->database->handle()) {
+		// statements which were not reset keep their snapshot
+		for (auto stmt = sqlite3_next_stmt(handle, nullptr); stmt; stmt = sqlite3_next_stmt(handle, stmt)) {
+			if (sqlite3_stmt_busy(stmt)) {
+				sqlite3_reset(stmt);
+			}
+		}
+		try {
+			if (!sqlite3_get_autocommit(handle)) {
+				slot->database->execute("ROLLBACK");
+			}
+			return;
+		} catch (...) {
+		}
+	}
+
+	try {
+		slot->database = _open(slot == &_writer);
+		++_reopened;
+	} catch (...) {
+		// the next user gets the errors of the old connection
+	}
+}
@@ -0,0 +1,149 @@
+#ifndef YSQLITE3_CONNECTION_POOL_HPP_
+#define YSQLITE3_CONNECTION_POOL_HPP_
+
+#include "database.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ysqlite3 {
+
+struct Connection_pool_options
+{
+	/// The number of read-only connections; 0 uses one connection per core.
+	std::size_t readers = 0;
+	/// The VFS of all connections; empty is the default VFS.
+	std::string vfs;
+	/// The busy timeout of all connections.
+	std::chrono::milliseconds busy_timeout{ 5000 };
+	/// Prepared into the statement cache of every connection when it is opened.
+	std::vector<std::string> warm_statements;
+};
+
+struct Connection_pool_status
+{
+	std::size_t readers           = 0;
+	std::size_t readers_in_use    = 0;
+	bool writer_in_use            = false;
+	std::uint64_t read_checkouts  = 0;
+	std::uint64_t write_checkouts = 0;
+	/// The checkouts which had to wait for a connection.
+	std::uint64_t read_waits  = 0;
+	std::uint64_t write_waits = 0;
+	/// The total time spent waiting for a connection.
+	std::chrono::microseconds read_wait_time{ 0 };
+	std::chrono::microseconds write_wait_time{ 0 };
+	/// The connections which failed validation and were opened again.
+	std::uint64_t reopened = 0;
+};
+
+class Connection_pool;
+
+/**
+ * A connection checked out of a Connection_pool. The connection is returned to the pool when this object is
+ * destroyed; it must not outlive the pool.
+ */
+class Pooled_connection
+{
+public:
+	/// The moved object will be empty.
+	Pooled_connection(Pooled_connection&& move) noexcept;
+	/// Returns the connection to the pool.
+	~Pooled_connection();
+	/// Returns the connection to the pool. Releasing an empty object is a noop.
+	void release() noexcept;
+	Database& operator*() const noexcept;
+	Database* operator->() const noexcept;
+	/**
+	 * Returns the connection for APIs like Transaction that require shared ownership. The connection must not
+	 * be used after it was returned to the pool.
+	 */
+	const std::shared_ptr<Database>& shared() const noexcept;
+	Pooled_connection& operator=(Pooled_connection&& move) noexcept;
+
+private:
+	friend Connection_pool;
+
+	struct Slot
+	{
+		std::shared_ptr<Database> database;
+		std::atomic<bool> busy{ false };
+	};
+
+	Connection_pool* _pool = nullptr;
+	Slot* _slot            = nullptr;
+
+	Pooled_connection(Connection_pool* pool, Slot* slot) noexcept;
+};
+
+/**
+ * A fixed set of read-only connections and one writer connection to a database in WAL mode. In WAL mode
+ * readers never wait for the writer, so read() only waits when every reader is checked out. Free connections
+ * are found with atomic flags; a mutex is only taken when a thread has to wait.
+ *
+ * A returned connection is validated: busy statements are reset and an open transaction is rolled back, so
+ * an idle reader never holds a snapshot which stops checkpoints. If that fails, the connection is opened
+ * again. New connections load the schema and prepare the warm statements into their statement cache. All
+ * methods are thread-safe; a checked out connection may only be used by one thread at a time.
+ */
+class Connection_pool
+{
+public:
+	/**
+	 * Opens all connections and switches the database to WAL mode.
+	 *
+	 * @exception std::system_error if a connection could not be opened or a warm statement not be prepared
+	 * @param uri the URI of the database; it is created if it does not exist
+	 * @param options the options
+	 */
+	Connection_pool(const char* uri, Connection_pool_options options = {});
+	Connection_pool(const Connection_pool& copy) = delete;
+	/// Checks out a read-only connection; waits until one is free.
+	Pooled_connection read();
+	/// Checks out the writer connection; waits until it is free.
+	Pooled_connection write();
+	Connection_pool_status status() const noexcept;
+	Connection_pool& operator=(const Connection_pool& copy) = delete;
+
+private:
+	typedef Pooled_connection::Slot Slot;
+
+	struct Waiters
+	{
+		std::mutex mutex;
+		std::condition_variable free;
+		std::atomic<std::size_t> count{ 0 };
+		std::atomic<std::uint64_t> checkouts{ 0 };
+		std::atomic<std::uint64_t> waits{ 0 };
+		std::atomic<std::uint64_t> wait_time{ 0 };
+	};
+
+	friend Pooled_connection;
+
+	const std::string _uri;
+	const Connection_pool_options _options;
+	Slot _writer;
+	std::unique_ptr<Slot[]> _readers;
+	std::size_t _reader_count;
+	std::atomic<std::size_t> _readers_in_use{ 0 };
+	std::atomic<std::uint64_t> _reopened{ 0 };
+	Waiters _read_waiters;
+	Waiters _write_waiters;
+
+	std::shared_ptr<Database> _open(bool writer) const;
+	Slot* _try_acquire(Slot* slots, std::size_t count, std::size_t start) noexcept;
+	Pooled_connection _acquire(Waiters& waiters, Slot* slots, std::size_t count);
+	void _release(Slot* slot) noexcept;
+	void _validate(Slot* slot) noexcept;
+};
+
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,677 @@
+#include "csv_loader.hpp"
+
+#include "finally.hpp"
+#include "statement.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <cerrno>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#else
+#	include <fstream>
+#	include <iterator>
+#endif
+
+using namespace ysqlite3;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+constexpr std::size_t sample_rows = 1000;
+
+/// The whole file, mapped if possible.
+class Mapping
+{
+public:
+	explicit Mapping(const char* file)
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		const auto fd = open(file, O_RDONLY | O_CLOEXEC);
+		if (fd == -1) {
+			throw std::system_error{ errno, std::generic_category(), file };
+		}
+		const auto _ = finally([fd] { close(fd); });
+
+		struct stat info;
+		if (fstat(fd, &info)) {
+			throw std::system_error{ errno, std::generic_category(), file };
+		}
+		_size = static_cast<std::size_t>(info.st_size);
+		if (_size) {
+			const auto data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED) {
+				throw std::system_error{ errno, std::generic_category(), file };
+			}
+#	if defined(MADV_WILLNEED)
+			// the chunks are read in parallel, so the whole file is needed soon
+			madvise(data, _size, MADV_WILLNEED);
+#	endif
+			_data = static_cast<const char*>(data);
+		}
+#else
+		std::ifstream stream{ file, std::ios::binary };
+		if (!stream) {
+			throw std::system_error{ std::make_error_code(std::errc::no_such_file_or_directory), file };
+		}
+		_copy.assign(std::istreambuf_iterator<char>{ stream }, std::istreambuf_iterator<char>{});
+		_data = _copy.data();
+		_size = _copy.size();
+#endif
+	}
+	Mapping(const Mapping& copy) = delete;
+	~Mapping()
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		if (_data) {
+			munmap(const_cast<char*>(_data), _size);
+		}
+#endif
+	}
+	const char* begin() const noexcept
+	{
+		return _data;
+	}
+	const char* end() const noexcept
+	{
+		return _data + _size;
+	}
+	std::size_t size() const noexcept
+	{
+		return _size;
+	}
+
+private:
+	const char* _data = nullptr;
+	std::size_t _size = 0;
+#if !defined(__unix__) && !defined(__APPLE__)
+	std::vector<char> _copy;
+#endif
+};
+
+struct Field
+{
+	/// `nullptr` if the record has fewer fields.
+	const char* data = nullptr;
+	std::size_t size = 0;
+	/// Whether the field was enclosed in quotes; doubled quotes are not removed yet.
+	bool quoted = false;
+};
+
+/// A column of a parsed chunk in the layout of Bulk_column.
+struct Chunk_column
+{
+	Results::type type = Results::type::text;
+	std::vector<sqlite3_int64> integers;
+	std::vector<double> reals;
+	std::vector<std::string> texts;
+	std::vector<std::vector<std::uint8_t>> blobs;
+	std::vector<bool> nulls;
+};
+
+struct Chunk
+{
+	std::size_t rows = 0;
+	std::vector<Chunk_column> columns;
+	std::chrono::nanoseconds parse_time{ 0 };
+};
+
+/**
+ * Counts the occurrences of the byte eight bytes at a time. A byte of `word ^ pattern` is zero for every
+ * match; adding 0x7f to the low seven bits of each byte sets the high bit unless they are zero, which never
+ * carries into the next byte.
+ */
+std::size_t count_byte(const char* begin, const char* end, char byte) noexcept
+{
+	constexpr std::uint64_t ones = 0x0101010101010101;
+	constexpr std::uint64_t low7 = 0x7f7f7f7f7f7f7f7f;
+	const std::uint64_t pattern  = ones * static_cast<std::uint8_t>(byte);
+	std::size_t count            = 0;
+	for (; end - begin >= 8; begin += 8) {
+		std::uint64_t word;
+		std::memcpy(&word, begin, sizeof(word));
+		word ^= pattern;
+		const auto matches = ~(((word & low7) + low7) | word | low7);
+		// sums the flags of all bytes in the highest byte
+		count += static_cast<std::size_t>(((matches >> 7) * ones) >> 56);
+	}
+	for (; begin < end; ++begin) {
+		count += *begin == byte;
+	}
+	return count;
+}
+
+bool is_blank_line(const char* position, const char* end) noexcept
+{
+	return *position == '\n' || (*position == '\r' && position + 1 < end && position[1] == '\n');
+}
+
+/**
+ * Parses one record and appends its fields.
+ *
+ * @return the start of the next record
+ */
+const char* parse_record(const char* position, const char* end, const Csv_options& options,
+                         std::vector<Field>& fields)
+{
+	while (true) {
+		Field field;
+		field.data = position;
+		if (position < end && *position == options.quote) {
+			field.quoted = true;
+			field.data   = ++position;
+			auto closing = end;
+			while (true) {
+				const auto found = static_cast<const char*>(
+				    std::memchr(position, options.quote, static_cast<std::size_t>(end - position)));
+				if (!found) {
+					// unterminated, the rest of the file is the field
+					position = end;
+					break;
+				} else if (found + 1 < end && found[1] == options.quote) {
+					position = found + 2;
+				} else {
+					closing  = found;
+					position = found + 1;
+					break;
+				}
+			}
+			field.size = static_cast<std::size_t>(closing - field.data);
+			// like SQLite, text between the closing quote and the separator is dropped
+			while (position < end && *position != options.separator && *position != '\n') {
+				++position;
+			}
+		} else {
+			while (position < end && *position != options.separator && *position != '\n') {
+				++position;
+			}
+			field.size = static_cast<std::size_t>(position - field.data);
+			if ((position == end || *position == '\n') && field.size && field.data[field.size - 1] == '\r') {
+				--field.size;
+			}
+		}
+		fields.push_back(field);
+
+		if (position == end) {
+			return end;
+		} else if (*position++ == '\n') {
+			return position;
+		}
+	}
+}
+
+/// Parses the records of `[begin, end)` into rows of `width` fields.
+void parse_rows(const char* begin, const char* end, const Csv_options& options, std::size_t width,
+                std::size_t max_rows, std::vector<Field>& fields)
+{
+	for (std::size_t rows = 0; begin < end && rows < max_rows;) {
+		if (is_blank_line(begin, end)) {
+			begin += *begin == '\r' ? 2 : 1;
+			continue;
+		}
+
+		const auto first = fields.size();
+		begin            = parse_record(begin, end, options, fields);
+		fields.resize(first + width);
+		++rows;
+	}
+}
+
+std::string unquote(const Field& field, char quote)
+{
+	std::string text{ field.data, field.size };
+	if (field.quoted) {
+		const std::string doubled(2, quote);
+		for (auto i = text.find(doubled); i != std::string::npos; i = text.find(doubled, i + 1)) {
+			text.erase(i, 1);
+		}
+	}
+	return text;
+}
+
+bool parse_integer(const Field& field, sqlite3_int64& value) noexcept
+{
+	auto position    = field.data;
+	const auto end   = field.data + field.size;
+	const bool sign  = position < end && (*position == '-' || *position == '+');
+	const bool minus = sign && *position == '-';
+	position += sign;
+	if (position == end || end - position > 19) {
+		return false;
+	}
+
+	std::uint64_t result = 0;
+	for (; position < end; ++position) {
+		if (*position < '0' || *position > '9') {
+			return false;
+		}
+		result = result * 10 + static_cast<std::uint64_t>(*position - '0');
+	}
+	// 19 digits do not overflow 64 bits
+	const std::uint64_t limit = static_cast<std::uint64_t>(std::numeric_limits<sqlite3_int64>::max()) + minus;
+	if (result > limit) {
+		return false;
+	}
+	value = minus ? static_cast<sqlite3_int64>(0 - result) : static_cast<sqlite3_int64>(result);
+	return true;
+}
+
+bool parse_real(const Field& field, double& value) noexcept
+{
+	char buffer[64];
+	if (!field.size || field.size >= sizeof(buffer)) {
+		return false;
+	}
+
+	// strtod() also accepts hexadecimal, infinity and nan which SQLite reads as text
+	bool digit = false;
+	for (std::size_t i = 0; i < field.size; ++i) {
+		const auto c = field.data[i];
+		digit |= c >= '0' && c <= '9';
+		if (!(c >= '0' && c <= '9') && c != '.' && c != 'e' && c != 'E' && c != '+' && c != '-') {
+			return false;
+		}
+	}
+	if (!digit) {
+		return false;
+	}
+
+	std::memcpy(buffer, field.data, field.size);
+	buffer[field.size] = 0;
+	char* end          = nullptr;
+	value              = std::strtod(buffer, &end);
+	return end == buffer + field.size;
+}
+
+/// Whether the field is null in a column of the type.
+bool is_null(const Field& field, Results::type type) noexcept
+{
+	return !field.data || (!field.size && !field.quoted && type != Results::type::text);
+}
+
+/// Converts the column of the rows; numbers which do not parse turn the column into text.
+void convert(const std::vector<Field>& fields, std::size_t width, std::size_t column, Results::type type,
+             char quote, Chunk_column& result)
+{
+	const auto rows = fields.size() / width;
+	result.type     = type;
+	result.nulls.assign(rows, false);
+
+	if (type == Results::type::integer) {
+		result.integers.resize(rows);
+		for (std::size_t i = 0; i < rows; ++i) {
+			const auto& field = fields[i * width + column];
+			if (is_null(field, type)) {
+				result.nulls[i] = true;
+			} else if (!parse_integer(field, result.integers[i])) {
+				result.integers.clear();
+				result.type = Results::type::text;
+				break;
+			}
+		}
+	} else if (type == Results::type::real) {
+		result.reals.resize(rows);
+		for (std::size_t i = 0; i < rows; ++i) {
+			const auto& field = fields[i * width + column];
+			if (is_null(field, type)) {
+				result.nulls[i] = true;
+			} else if (!parse_real(field, result.reals[i])) {
+				result.reals.clear();
+				result.type = Results::type::text;
+				break;
+			}
+		}
+	}
+
+	if (result.type == Results::type::text || result.type == Results::type::blob) {
+		// the nulls are the same for text after a failed number
+		for (std::size_t i = 0; i < rows; ++i) {
+			const auto& field = fields[i * width + column];
+			result.nulls[i]   = is_null(field, type);
+			auto text         = result.nulls[i] ? std::string{} : unquote(field, quote);
+			if (result.type == Results::type::blob) {
+				result.blobs.emplace_back(text.begin(), text.end());
+			} else {
+				result.texts.push_back(std::move(text));
+			}
+		}
+	}
+}
+
+std::unique_ptr<Chunk> parse_chunk(const char* begin, const char* end, const Csv_options& options,
+                                   const std::vector<Results::type>& types)
+{
+	const auto start = Clock::now();
+	std::unique_ptr<Chunk> chunk{ new Chunk{} };
+	std::vector<Field> fields;
+	parse_rows(begin, end, options, types.size(), static_cast<std::size_t>(-1), fields);
+
+	chunk->rows = fields.size() / types.size();
+	chunk->columns.resize(types.size());
+	for (std::size_t i = 0; i < types.size(); ++i) {
+		convert(fields, types.size(), i, types[i], options.quote, chunk->columns[i]);
+	}
+	chunk->parse_time = Clock::now() - start;
+	return chunk;
+}
+
+/// Infers integer, real or text from the sample rows.
+Results::type infer_type(const std::vector<Field>& fields, std::size_t width, std::size_t column) noexcept
+{
+	auto type  = Results::type::integer;
+	bool empty = true;
+	for (auto i = column; i < fields.size(); i += width) {
+		if (is_null(fields[i], type)) {
+			continue;
+		}
+
+		empty = false;
+		sqlite3_int64 integer;
+		double real;
+		if (type == Results::type::integer && parse_integer(fields[i], integer)) {
+			continue;
+		} else if (parse_real(fields[i], real)) {
+			type = Results::type::real;
+		} else {
+			return Results::type::text;
+		}
+	}
+	return empty ? Results::type::text : type;
+}
+
+/**
+ * Splits the text into chunks which start with a record. The quotes in front of each chunk of about
+ * `chunk_size` bytes are counted in parallel; an odd count means the chunk starts inside quotes, so its
+ * boundary moves to the first line break outside of them.
+ *
+ * @return the boundaries including `begin` and `end`
+ */
+std::vector<const char*> split(const char* begin, const char* end, const Csv_options& options,
+                               std::size_t threads)
+{
+	const auto size       = static_cast<std::size_t>(end - begin);
+	const auto chunk_size = std::max<std::size_t>(options.chunk_size, 1);
+	const auto count      = std::max<std::size_t>((size + chunk_size - 1) / chunk_size, 1);
+	std::vector<std::size_t> quotes(count);
+	std::vector<std::thread> workers;
+	for (std::size_t t = 0; t < std::min(threads, count); ++t) {
+		workers.emplace_back([&, t] {
+			for (auto i = t; i < count; i += threads) {
+				quotes[i] = count_byte(begin + i * chunk_size, begin + std::min(size, (i + 1) * chunk_size),
+				                       options.quote);
+			}
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	std::vector<const char*> bounds{ begin };
+	bool inside = false;
+	for (std::size_t i = 1; i < count; ++i) {
+		inside ^= quotes[i - 1] & 1;
+		auto position = begin + i * chunk_size;
+		// a long field may span the whole chunk
+		if (position <= bounds.back()) {
+			continue;
+		}
+		for (auto quoted = inside; position < end; ++position) {
+			if (*position == options.quote) {
+				quoted = !quoted;
+			} else if (*position == '\n' && !quoted) {
+				++position;
+				break;
+			}
+		}
+		if (position < end) {
+			bounds.push_back(position);
+		}
+	}
+	bounds.push_back(end);
+	return bounds;
+}
+
+std::string quote_identifier(const std::string& name)
+{
+	std::string quoted = "\"";
+	for (const auto c : name) {
+		quoted += c;
+		if (c == '"') {
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+void execute(sqlite3* database, const std::string& sql)
+{
+	char* message = nullptr;
+	const auto ec = sqlite3_exec(database, sql.c_str(), nullptr, nullptr, &message);
+	const auto _  = finally([message] { sqlite3_free(message); });
+	if (ec) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec), message ? message : sqlite3_errstr(ec) };
+	}
+}
+
+/// Returns the number of columns of the table or 0 if it does not exist.
+std::size_t table_width(sqlite3* database, const std::string& table)
+{
+	sqlite3_stmt* statement = nullptr;
+	const auto sql          = "SELECT * FROM " + quote_identifier(table);
+	const auto ec           = sqlite3_prepare_v2(database, sql.c_str(), -1, &statement, nullptr);
+	const auto _            = finally([statement] { sqlite3_finalize(statement); });
+	return ec ? 0 : static_cast<std::size_t>(sqlite3_column_count(statement));
+}
+
+} // namespace
+
+Csv_status ysqlite3::load_csv(Database& database, const char* file, const char* table,
+                              const Csv_options& options)
+{
+	if (!database.is_open()) {
+		throw std::system_error{ Error::database_is_closed };
+	}
+	return load_csv(database.handle(), file, table, options);
+}
+
+Csv_status ysqlite3::load_csv(sqlite3* database, const char* file, const char* table,
+                              const Csv_options& options)
+{
+	if (!database) {
+		throw std::system_error{ Error::database_is_closed };
+	}
+
+	const auto start = Clock::now();
+	Csv_status status{};
+	const Mapping mapping{ file };
+	status.bytes = mapping.size();
+
+	auto begin     = mapping.begin();
+	const auto end = mapping.end();
+	if (end - begin >= 3 && std::memcmp(begin, "\xef\xbb\xbf", 3) == 0) {
+		begin += 3;
+	}
+	while (begin < end && is_blank_line(begin, end)) {
+		begin += *begin == '\r' ? 2 : 1;
+	}
+	if (begin == end) {
+		status.elapsed = Clock::now() - start;
+		return status;
+	}
+
+	// the header or the first record determines the width of a new table
+	std::vector<Field> first;
+	const auto data = parse_record(begin, end, options, first);
+	if (options.header) {
+		begin = data;
+	}
+	auto width        = table_width(database, table);
+	const bool create = !width;
+	if (create) {
+		width = first.size();
+	}
+
+	std::vector<Field> sample;
+	parse_rows(begin, end, options, width, sample_rows, sample);
+	std::vector<Results::type> types(width);
+	for (std::size_t i = 0; i < width; ++i) {
+		types[i] = i < options.types.size() ? options.types[i] : Results::type::null;
+		if (types[i] == Results::type::null) {
+			types[i] = infer_type(sample, width, i);
+		}
+	}
+
+	if (create) {
+		std::string sql = "CREATE TABLE " + quote_identifier(table) + "(";
+		for (std::size_t i = 0; i < width; ++i) {
+			const auto name = options.header && first[i].size ? unquote(first[i], options.quote)
+			                                                  : "c" + std::to_string(i + 1);
+			sql += (i ? ", " : "") + quote_identifier(name);
+			switch (types[i]) {
+			case Results::type::integer: sql += " INTEGER"; break;
+			case Results::type::real: sql += " REAL"; break;
+			case Results::type::blob: sql += " BLOB"; break;
+			default: sql += " TEXT"; break;
+			}
+		}
+		execute(database, sql + ")");
+	}
+
+	std::string sql = "INSERT INTO " + quote_identifier(table) + " VALUES(";
+	for (std::size_t i = 0; i < width; ++i) {
+		sql += i ? ", ?" : "?";
+	}
+	sql += ")";
+	sqlite3_stmt* stmt = nullptr;
+	if (const auto ec = sqlite3_prepare_v2(database, sql.c_str(), -1, &stmt, nullptr)) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(database) };
+	}
+	Statement insert{ stmt, database };
+
+	auto threads = options.threads ? options.threads : std::max(std::thread::hardware_concurrency(), 1u);
+	const auto split_start = Clock::now();
+	const auto bounds      = split(begin, end, options, threads);
+	const auto count       = bounds.size() - 1;
+	threads                = std::min(threads, count);
+	status.parse_time      = Clock::now() - split_start;
+
+	// the workers parse ahead of the writer by at most two chunks each
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::vector<std::unique_ptr<Chunk>> chunks(count);
+	std::size_t next     = 0;
+	std::size_t consumed = 0;
+	bool stop            = false;
+	std::exception_ptr error;
+	std::vector<std::thread> workers;
+	const auto _ = finally([&] {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stop = true;
+		}
+		condition.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	});
+	for (std::size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&] {
+			while (true) {
+				std::size_t index = 0;
+				{
+					std::unique_lock<std::mutex> lock{ mutex };
+					condition.wait(lock,
+					               [&] { return stop || next >= count || next < consumed + 2 * threads; });
+					if (stop || next >= count) {
+						return;
+					}
+					index = next++;
+				}
+
+				try {
+					auto chunk = parse_chunk(bounds[index], bounds[index + 1], options, types);
+					std::lock_guard<std::mutex> lock{ mutex };
+					chunks[index] = std::move(chunk);
+				} catch (...) {
+					std::lock_guard<std::mutex> lock{ mutex };
+					error = std::current_exception();
+					stop  = true;
+				}
+				condition.notify_all();
+			}
+		});
+	}
+
+	const bool own_transaction = sqlite3_get_autocommit(database);
+	std::uint64_t uncommitted  = 0;
+	if (own_transaction) {
+		execute(database, "BEGIN");
+	}
+	try {
+		for (std::size_t i = 0; i < count; ++i) {
+			std::unique_ptr<Chunk> chunk;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				condition.wait(lock, [&] { return chunks[i] || error; });
+				if (error) {
+					std::rethrow_exception(error);
+				}
+				chunk = std::move(chunks[i]);
+				++consumed;
+			}
+			condition.notify_all();
+			status.parse_time += chunk->parse_time;
+			if (!chunk->rows) {
+				continue;
+			}
+
+			const auto insert_start = Clock::now();
+			std::vector<Bulk_column> columns;
+			for (const auto& column : chunk->columns) {
+				switch (column.type) {
+				case Results::type::integer: columns.emplace_back(column.integers); break;
+				case Results::type::real: columns.emplace_back(column.reals); break;
+				case Results::type::blob: columns.emplace_back(column.blobs); break;
+				default: columns.emplace_back(column.texts); break;
+				}
+				columns.back().set_nulls(column.nulls);
+			}
+			status.rows += insert.execute_many(columns, options.bulk).rows;
+			uncommitted += chunk->rows;
+			if (own_transaction && options.bulk.rows_per_transaction &&
+			    uncommitted >= options.bulk.rows_per_transaction) {
+				execute(database, "COMMIT");
+				execute(database, "BEGIN");
+				uncommitted = 0;
+			}
+			status.insert_time += Clock::now() - insert_start;
+		}
+
+		if (own_transaction) {
+			const auto commit_start = Clock::now();
+			execute(database, "COMMIT");
+			status.insert_time += Clock::now() - commit_start;
+		}
+	} catch (...) {
+		if (own_transaction && !sqlite3_get_autocommit(database)) {
+			sqlite3_exec(database, "ROLLBACK", nullptr, nullptr, nullptr);
+		}
+		throw;
+	}
+
+	status.elapsed = Clock::now() - start;
+	return status;
+}
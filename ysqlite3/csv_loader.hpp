@@ -0,0 +1,83 @@
+#ifndef YSQLITE3_CSV_LOADER_HPP_
+#define YSQLITE3_CSV_LOADER_HPP_
+
+#include "bulk.hpp"
+#include "database.hpp"
+#include "results.hpp"
+#include "sqlite3.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ysqlite3 {
+
+struct Csv_options
+{
+	/// The field separator, for example `'\t'` for TSV.
+	char separator = ',';
+	/// Encloses fields with separators, quotes or line breaks; a quote inside is doubled.
+	char quote = '"';
+	/// Whether the first row names the columns instead of holding values.
+	bool header = false;
+	/// The parsing threads; 0 uses one per core.
+	std::size_t threads = 0;
+	/// The bytes parsed at once by a thread; the rows of one chunk are inserted with one execute_many().
+	std::size_t chunk_size = 1 << 20;
+	/**
+	 * The type of each column. Missing columns or `Results::type::null` are inferred from the first rows as
+	 * integer, real or text.
+	 */
+	std::vector<Results::type> types;
+	/// Controls the statements and transactions of the inserts.
+	Bulk_options bulk;
+};
+
+struct Csv_status
+{
+	std::uint64_t rows  = 0;
+	std::uint64_t bytes = 0;
+	/// The time spent parsing, summed over all threads.
+	std::chrono::nanoseconds parse_time{ 0 };
+	/// The time spent inserting.
+	std::chrono::nanoseconds insert_time{ 0 };
+	std::chrono::nanoseconds elapsed{ 0 };
+
+	double rows_per_second() const noexcept
+	{
+		return elapsed.count() ? rows * 1e9 / elapsed.count() : 0.0;
+	}
+};
+
+/**
+ * Loads a CSV or TSV file into a table. The file is mapped into memory and split into chunks at line breaks
+ * outside of quotes; the chunks are parsed in parallel into typed columns while the calling thread inserts
+ * them in order with Statement::execute_many(), so all writes go through the one connection. At most two
+ * parsed chunks per thread wait for the insert.
+ *
+ * If the table does not exist, it is created with the inferred types and the names of the header or `c1`,
+ * `c2` and so on. Extra fields are ignored and missing fields are null. An empty field is null in integer
+ * and real columns and an empty string in text columns. A chunk whose values of a column do not all parse
+ * as the type of the column binds them as text, which leaves the conversion to the column affinity.
+ *
+ * If no transaction is active, a transaction is committed every `bulk.rows_per_transaction` rows and the last
+ * one is rolled back on error.
+ *
+ * @exception std::system_error
+ *   - `std::generic_category()` if the file could not be opened or mapped
+ *   - Error::database_is_closed
+ *   - see Statement::execute_many()
+ * @param database the database
+ * @param file the path of the file
+ * @param table the table in the main database
+ * @param options the format and tuning options
+ * @return the statistics
+ */
+Csv_status load_csv(Database& database, const char* file, const char* table, const Csv_options& options = {});
+/// Like the other overload for a connection owned by someone else, for example the shell.
+Csv_status load_csv(sqlite3* database, const char* file, const char* table, const Csv_options& options = {});
+
+} // namespace ysqlite3
+
+#endif
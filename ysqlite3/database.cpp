@@ -3,6 +3,7 @@
 #include "error.hpp"
 #include "finally.hpp"
 
+#include <string>
 #include <utility>
 
 using namespace ysqlite3;
@@ -15,6 +16,8 @@ Database::Database(const char* file)
 Database::Database(Database&& move) noexcept
 {
 	std::swap(_database, move._database);
+	std::swap(_statement_cache_size, move._statement_cache_size);
+	std::swap(_statement_cache, move._statement_cache);
 }
 
 Database::~Database() noexcept
@@ -63,6 +66,8 @@ void Database::enable_foreign_keys(bool enable)
 void Database::close(bool force)
 {
 	if (_database) {
+		// cached statements would keep the database open
+		_statement_cache.reset();
 		if (force) {
 			sqlite3_close_v2(_database);
 		} else {
@@ -168,8 +173,44 @@ Statement Database::prepare_statement(const char* sql)
 	return { stmt, _database };
 }
 
+Cached_statement Database::prepare_cached(const char* sql)
+{
+	if (!is_open()) {
+		throw std::system_error{ Error::database_is_closed };
+	} else if (!_statement_cache) {
+		_statement_cache = std::make_shared<Statement_cache>(_statement_cache_size);
+	}
+
+	std::string key = sql;
+	if (const auto stmt = _statement_cache->take(key)) {
+		return { Statement{ stmt, _database }, _statement_cache, std::move(key) };
+	}
+	return { prepare_statement(sql), _statement_cache, std::move(key) };
+}
+
+void Database::set_statement_cache_size(std::size_t size) noexcept
+{
+	_statement_cache_size = size;
+	if (_statement_cache) {
+		_statement_cache->set_capacity(size);
+	}
+}
+
+void Database::clear_statement_cache() noexcept
+{
+	if (_statement_cache) {
+		_statement_cache->clear();
+	}
+}
+
+Statement_cache_status Database::statement_cache_status() const noexcept
+{
+	return _statement_cache ? _statement_cache->status() : Statement_cache_status{};
+}
+
 sqlite3* Database::release_handle() noexcept
 {
+	_statement_cache.reset();
 	const auto tmp = _database;
 	_database      = nullptr;
 	return tmp;
@@ -189,5 +230,7 @@ Database& Database::operator=(Database&& move) noexcept
 {
 	close(true);
 	std::swap(_database, move._database);
+	std::swap(_statement_cache_size, move._statement_cache_size);
+	std::swap(_statement_cache, move._statement_cache);
 	return *this;
 }
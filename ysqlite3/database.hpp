@@ -5,6 +5,7 @@
 #include "function/function.hpp"
 #include "sqlite3.h"
 #include "statement.hpp"
+#include "statement_cache.hpp"
 #include "transaction.hpp"
 
 #include <cstddef>
@@ -177,6 +178,29 @@ public:
 	 * @return the prepared statement
 	 */
 	Statement prepare_statement(const char* sql);
+	/**
+	 * Returns a prepared statement from the statement cache or prepares a new one. The returned statement is
+	 * reset and has no bindings. When it is destroyed, it is returned to the cache; the least recently used
+	 * statements beyond the cache size are finalized.
+	 *
+	 * @pre the database is opened
+	 *
+	 * @exception std::system_error if the statement could not be created
+	 * @param sql the SQL statement
+	 * @return the prepared statement
+	 */
+	Cached_statement prepare_cached(const char* sql);
+	/**
+	 * Sets the maximum number of idle statements in the statement cache. The default is 64; 0 disables the
+	 * cache.
+	 *
+	 * @param size the cache size
+	 */
+	void set_statement_cache_size(std::size_t size) noexcept;
+	/// Finalizes all idle statements of the statement cache.
+	void clear_statement_cache() noexcept;
+	/// Returns the statistics of the statement cache since the database was opened.
+	Statement_cache_status statement_cache_status() const noexcept;
 	/**
 	 * Returns the SQLite database file handle. This database will be marked as closed, but the handle will
 	 * remain open.
@@ -196,7 +220,10 @@ private:
 	friend Transaction;
 
 	/// Underlying sqlite3 database handle.
-	sqlite3* _database = nullptr;
+	sqlite3* _database                = nullptr;
+	std::size_t _statement_cache_size = 64;
+	/// Shared with the cached statements, which may outlive this database.
+	std::shared_ptr<Statement_cache> _statement_cache;
 
 	template<typename Functor>
 	static void _functor_forwarder(sqlite3_context* context, int argc, sqlite3_value** argv)
@@ -246,7 +246,9 @@ enum class Error
 	bad_arguments,
 	bad_result,
 	vfs_already_registered,
-	out_of_bounds
+	out_of_bounds,
+	replication_gap,
+	blob_is_closed
 };
 
 enum class Condition
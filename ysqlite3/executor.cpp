@@ -0,0 +1,63 @@
+#include "executor.hpp"
+
+#include <algorithm>
+#include <utility>
+
+using namespace ysqlite3;
+
+Thread_executor::Thread_executor(std::size_t threads)
+{
+	try {
+		for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i) {
+			_threads.emplace_back(&Thread_executor::_run, this);
+		}
+	} catch (...) {
+		_join();
+		throw;
+	}
+}
+
+Thread_executor::~Thread_executor()
+{
+	_join();
+}
+
+void Thread_executor::post(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_tasks.push_back(std::move(task));
+	}
+	_queued.notify_one();
+}
+
+void Thread_executor::_join() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_stop = true;
+	}
+	_queued.notify_all();
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+}
+
+void Thread_executor::_run() noexcept
+{
+	std::unique_lock<std::mutex> lock{ _mutex };
+	while (true) {
+		_queued.wait(lock, [this] { return _stop || !_tasks.empty(); });
+		if (_tasks.empty()) {
+			return;
+		}
+
+		auto task = std::move(_tasks.front());
+		_tasks.pop_front();
+		lock.unlock();
+		task();
+		// captured objects are destroyed without the lock
+		task = nullptr;
+		lock.lock();
+	}
+}
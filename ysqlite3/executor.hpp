@@ -0,0 +1,57 @@
+#ifndef YSQLITE3_EXECUTOR_HPP_
+#define YSQLITE3_EXECUTOR_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ysqlite3 {
+
+/// Runs tasks on its threads. Implement this to run the work of Async_database on an existing thread pool.
+class Executor
+{
+public:
+	virtual ~Executor() = default;
+	/**
+	 * Runs the task later on one of the threads of the executor.
+	 *
+	 * @exception any if the task could not be queued
+	 * @param task the task; it does not throw
+	 */
+	virtual void post(std::function<void()> task) = 0;
+};
+
+/// An executor with dedicated threads and a FIFO queue.
+class Thread_executor : public Executor
+{
+public:
+	/**
+	 * Starts the threads.
+	 *
+	 * @param threads the number of threads
+	 */
+	Thread_executor(std::size_t threads = 1);
+	Thread_executor(const Thread_executor& copy) = delete;
+	/// Runs the queued tasks and joins the threads.
+	~Thread_executor();
+	void post(std::function<void()> task) override;
+	Thread_executor& operator=(const Thread_executor& copy) = delete;
+
+private:
+	std::mutex _mutex;
+	std::condition_variable _queued;
+	std::deque<std::function<void()>> _tasks;
+	bool _stop = false;
+	std::vector<std::thread> _threads;
+
+	void _join() noexcept;
+	void _run() noexcept;
+};
+
+} // namespace ysqlite3
+
+#endif
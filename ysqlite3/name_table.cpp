@@ -0,0 +1,76 @@
+#include "name_table.hpp"
+
+using namespace ysqlite3;
+
+namespace {
+
+std::string fold(const char* name)
+{
+	std::string folded = name;
+	for (auto& c : folded) {
+		if (c >= 'A' && c <= 'Z') {
+			c = static_cast<char>(c - 'A' + 'a');
+		}
+	}
+	return folded;
+}
+
+} // namespace
+
+int Name_table::column(sqlite3_stmt* statement, const char* name)
+{
+	const auto built = _has_columns;
+	auto column      = _find_column(statement, name);
+
+	if (!built) {
+		return column;
+	}
+
+	// SQLite recompiles the statement after a schema change, which may rename or move the columns
+	const auto count   = sqlite3_column_count(statement);
+	const auto current = column >= 0 && column < count ? sqlite3_column_name(statement, column) : nullptr;
+	if (!current || sqlite3_stricmp(current, name)) {
+		_columns.clear();
+		_has_columns = false;
+		column       = _find_column(statement, name);
+	}
+	return column;
+}
+
+int Name_table::parameter(sqlite3_stmt* statement, const char* name)
+{
+	if (!_has_parameters) {
+		for (int i = 1, c = sqlite3_bind_parameter_count(statement); i <= c; ++i) {
+			if (const auto parameter = sqlite3_bind_parameter_name(statement, i)) {
+				_parameters.emplace(parameter, i);
+			}
+		}
+		_has_parameters = true;
+	}
+
+	const auto it = _parameters.find(name);
+	return it == _parameters.end() ? 0 : it->second;
+}
+
+int Name_table::_find_column(sqlite3_stmt* statement, const char* name)
+{
+	if (!_has_columns) {
+		for (int i = 0, c = sqlite3_column_count(statement); i < c; ++i) {
+			if (const auto column = sqlite3_column_name(statement, i)) {
+				_columns.emplace(fold(column), i);
+			}
+		}
+		_has_columns = true;
+	}
+
+	const auto it = _columns.find(fold(name));
+	return it == _columns.end() ? -1 : it->second;
+}
+
+void Name_table::clear() noexcept
+{
+	_columns.clear();
+	_parameters.clear();
+	_has_columns    = false;
+	_has_parameters = false;
+}
@@ -0,0 +1,53 @@
+#ifndef YSQLITE3_NAME_TABLE_HPP_
+#define YSQLITE3_NAME_TABLE_HPP_
+
+#include "sqlite3.h"
+
+#include <string>
+#include <unordered_map>
+
+namespace ysqlite3 {
+
+/**
+ * The column and parameter names of a statement hashed for lookups by name. Each table is built on its first
+ * lookup. Column names are compared case-insensitively like SQLite compares identifiers, i.e. only ASCII
+ * letters are folded; the first of several columns with the same name wins. Parameter names are compared
+ * exactly like sqlite3_bind_parameter_index().
+ *
+ * The columns of a statement change if SQLite recompiled it after a schema change, so every found column is
+ * checked against its current name and the column table is built again on a mismatch or a miss.
+ */
+class Name_table
+{
+public:
+	/**
+	 * Looks up a column.
+	 *
+	 * @param statement the statement of this table
+	 * @param name the column name
+	 * @return the 0-based column or `-1` if unknown
+	 */
+	int column(sqlite3_stmt* statement, const char* name);
+	/**
+	 * Looks up a parameter.
+	 *
+	 * @param statement the statement of this table
+	 * @param name the parameter name including its prefix, e.g. `:id`
+	 * @return the 1-based parameter or `0` if unknown
+	 */
+	int parameter(sqlite3_stmt* statement, const char* name);
+	/// Forgets all names; the next lookups build the tables again.
+	void clear() noexcept;
+
+private:
+	std::unordered_map<std::string, int> _columns;
+	std::unordered_map<std::string, int> _parameters;
+	bool _has_columns    = false;
+	bool _has_parameters = false;
+
+	int _find_column(sqlite3_stmt* statement, const char* name);
+};
+
+} // namespace ysqlite3
+
+#endif
@@ -2,13 +2,14 @@
 
 using namespace ysqlite3;
 
-Results::Results(sqlite3_stmt* statement, sqlite3* database)
+Results::Results(sqlite3_stmt* statement, sqlite3* database, Name_table* names)
 {
 	if (static_cast<bool>(statement) != static_cast<bool>(database)) {
 		throw std::system_error{ Error::bad_arguments };
 	}
 	_statement = statement;
 	_database  = database;
+	_names     = names;
 }
 
 bool Results::is_null(Index index)
@@ -101,6 +102,14 @@ Results::operator bool() const noexcept
 int Results::_to_column_index(Index index)
 {
 	if (index.name) {
+		if (_names) {
+			const auto column = _names->column(_statement, index.name);
+			if (column >= 0) {
+				return column;
+			}
+		}
+
+		// the table only folds ASCII letters, the locale of the index may match other names
 		const auto iequals = [](const char* left, const char* right, const std::locale& locale) {
 			while (*left && *right) {
 				if (std::tolower(*left++) != std::tolower(*right++, locale)) {
@@ -2,14 +2,32 @@
 #define YSQLITE3_RESULTS_HPP_
 
 #include "error.hpp"
+#include "name_table.hpp"
 #include "span.hpp"
 #include "sqlite3.h"
+#include "value.hpp"
 
 #include <cstdint>
 #include <locale>
+#include <tuple>
 
 namespace ysqlite3 {
 
+/// A column resolved with Statement::column_handle(); it must be resolved again after a schema change.
+class Column_handle
+{
+public:
+	explicit Column_handle(int column) noexcept : _column{ column }
+	{}
+	int column() const noexcept
+	{
+		return _column;
+	}
+
+private:
+	int _column;
+};
+
 struct Index
 {
 	int value        = 0;
@@ -18,6 +36,8 @@ struct Index
 
 	Index(int value) noexcept : value{ value }
 	{}
+	Index(Column_handle handle) noexcept : value{ handle.column() }
+	{}
 	Index(const char* name, std::locale locale = {}) : name{ name }, locale{ std::move(locale) }
 	{
 		if (!name) {
@@ -50,8 +70,9 @@ public:
 	 *
 	 * @param[in] statement the statement
 	 * @param[in] database the database
+	 * @param[in] names (opt) the names of the statement; without them names are searched column by column
 	 */
-	Results(sqlite3_stmt* statement, sqlite3* database);
+	Results(sqlite3_stmt* statement, sqlite3* database, Name_table* names = nullptr);
 	/**
 	 * Checks if the value at the index is null.
 	 *
@@ -122,6 +143,29 @@ public:
 	 * @return the type
 	 */
 	type type_of(Index index);
+	/**
+	 * Returns the first columns at once. Their types and positions are fixed at compile time, so only the
+	 * column count is checked and the values are read without converting an Index.
+	 *
+	 * @pre `*this == true`
+	 *
+	 * @exception std::system_error
+	 *   - Error::bad_result if this has no statement
+	 *   - Error::parameter_out_of_range if there are fewer columns
+	 *   - see Value::get()
+	 * @tparam Columns the types of the columns; see Value
+	 * @return the values; values which are not owning are valid until the next step
+	 */
+	template<typename... Columns>
+	std::tuple<Columns...> as()
+	{
+		if (!*this) {
+			throw std::system_error{ Error::bad_result };
+		} else if (sqlite3_column_count(_statement) < static_cast<int>(sizeof...(Columns))) {
+			throw std::system_error{ Error::parameter_out_of_range };
+		}
+		return _as<Columns...>(typename Make_index_sequence<sizeof...(Columns)>::type{});
+	}
 	/**
 	 * Checks if this has a statement.
 	 *
@@ -132,6 +176,7 @@ public:
 private:
 	sqlite3_stmt* _statement = nullptr;
 	sqlite3* _database       = nullptr;
+	Name_table* _names       = nullptr;
 
 	/**
 	 * Returns the integer index of the column.
@@ -141,6 +186,11 @@ private:
 	 * @return the integer index
 	 */
 	int _to_column_index(Index index);
+	template<typename... Columns, std::size_t... Indices>
+	std::tuple<Columns...> _as(Index_sequence<Indices...>)
+	{
+		return std::tuple<Columns...>(Value<Columns>::get(_statement, static_cast<int>(Indices))...);
+	}
 };
 
 } // namespace ysqlite3
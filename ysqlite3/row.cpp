@@ -0,0 +1,71 @@
+#include "row.hpp"
+
+using namespace ysqlite3;
+
+Row::Row(sqlite3_stmt* statement)
+{
+	const auto count = sqlite3_column_count(statement);
+	_values.reserve(static_cast<std::size_t>(count));
+	for (int i = 0; i < count; ++i) {
+		_values.emplace_back(sqlite3_value_dup(sqlite3_column_value(statement, i)));
+		if (!_values.back()) {
+			throw std::system_error{ SQLite3_code::memory };
+		}
+	}
+}
+
+std::size_t Row::size() const noexcept
+{
+	return _values.size();
+}
+
+bool Row::is_null(int column) const
+{
+	return sqlite3_value_type(_value(column)) == SQLITE_NULL;
+}
+
+sqlite3_int64 Row::integer(int column) const
+{
+	return sqlite3_value_int64(_value(column));
+}
+
+double Row::real(int column) const
+{
+	return sqlite3_value_double(_value(column));
+}
+
+const char* Row::text(int column) const
+{
+	return reinterpret_cast<const char*>(sqlite3_value_text(_value(column)));
+}
+
+Span<const std::uint8_t*> Row::blob(int column) const
+{
+	const auto value = _value(column);
+	const auto blob  = static_cast<const std::uint8_t*>(sqlite3_value_blob(value));
+	return { blob, blob + sqlite3_value_bytes(value) };
+}
+
+Results::type Row::type_of(int column) const
+{
+	switch (sqlite3_value_type(_value(column))) {
+	case SQLITE_INTEGER: return Results::type::integer;
+	case SQLITE_FLOAT: return Results::type::real;
+	case SQLITE_TEXT: return Results::type::text;
+	case SQLITE_BLOB: return Results::type::blob;
+	default: return Results::type::null;
+	}
+}
+
+const sqlite3_value* Row::handle(int column) const
+{
+	return _value(column);
+}
+
+sqlite3_value* Row::_value(int column) const
+{
+	if (column < 0 || static_cast<std::size_t>(column) >= _values.size()) {
+		throw std::system_error{ Error::parameter_out_of_range };
+	}
+	return _values[static_cast<std::size_t>(column)].get();
+}
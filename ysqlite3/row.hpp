@@ -0,0 +1,72 @@
+#ifndef YSQLITE3_ROW_HPP_
+#define YSQLITE3_ROW_HPP_
+
+#include "results.hpp"
+#include "span.hpp"
+#include "sqlite3.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ysqlite3 {
+
+/**
+ * A copy of a result row which does not depend on its statement. Unlike Results, a row remains valid after
+ * the next step and may be moved to another thread; it must not be used by two threads at once, because
+ * reading a value as another type converts it in place.
+ */
+class Row
+{
+public:
+	Row() = default;
+	/**
+	 * Copies the current row of the statement.
+	 *
+	 * @pre sqlite3_step() returned `SQLITE_ROW`
+	 *
+	 * @exception std::system_error SQLite3_code::memory if a value could not be copied
+	 * @param statement the statement
+	 */
+	explicit Row(sqlite3_stmt* statement);
+	/// Returns the number of columns.
+	std::size_t size() const noexcept;
+	/**
+	 * Checks if the value at the column is null.
+	 *
+	 * @exception std::system_error Error::parameter_out_of_range if the column does not exist
+	 * @param column the column
+	 * @return `true` if null, otherwise `false`
+	 */
+	bool is_null(int column) const;
+	/// Returns the value as an integer; see is_null() for exceptions.
+	sqlite3_int64 integer(int column) const;
+	/// Returns the value as a double; see is_null() for exceptions.
+	double real(int column) const;
+	/// Returns the value as text or `nullptr` if it is null; see is_null() for exceptions.
+	const char* text(int column) const;
+	/// Returns the value as a blob; see is_null() for exceptions.
+	Span<const std::uint8_t*> blob(int column) const;
+	/// Returns the type of the value; see is_null() for exceptions.
+	Results::type type_of(int column) const;
+	/// Returns the SQLite value; see is_null() for exceptions.
+	const sqlite3_value* handle(int column) const;
+
+private:
+	struct Value_deleter
+	{
+		void operator()(sqlite3_value* value) const noexcept
+		{
+			sqlite3_value_free(value);
+		}
+	};
+
+	std::vector<std::unique_ptr<sqlite3_value, Value_deleter>> _values;
+
+	sqlite3_value* _value(int column) const;
+};
+
+} // namespace ysqlite3
+
+#endif
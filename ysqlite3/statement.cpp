@@ -3,6 +3,8 @@
 #include "error.hpp"
 #include "finally.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <limits>
 
 using namespace ysqlite3;
@@ -19,6 +21,8 @@ Statement::Statement(sqlite3_stmt* stmt, sqlite3* db)
 Statement::Statement(Statement&& move) noexcept
 {
 	std::swap(_statement, move._statement);
+	std::swap(_database, move._database);
+	std::swap(_names, move._names);
 }
 
 Statement::~Statement()
@@ -68,6 +72,7 @@ void Statement::close()
 {
 	const auto ec = sqlite3_finalize(_statement);
 	_statement    = nullptr;
+	_names.clear();
 	if (ec) {
 		throw std::system_error{ static_cast<SQLite3_code>(ec) };
 	}
@@ -86,7 +91,7 @@ Results Statement::step()
 
 	const auto ec = sqlite3_step(_statement);
 	if (ec == SQLITE_ROW) {
-		return { _statement, _database };
+		return { _statement, _database, &_names };
 	}
 	const auto _ = finally([this] { sqlite3_reset(_statement); });
 	if (ec == SQLITE_DONE) {
@@ -95,6 +100,33 @@ Results Statement::step()
 	throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
 }
 
+std::size_t Statement::fetch_columns(Column_batch& batch, std::size_t batch_size)
+{
+	if (!is_open()) {
+		throw std::system_error{ Error::statement_is_closed };
+	}
+
+	batch._prepare(_statement, batch_size);
+	try {
+		while (batch._rows < batch_size) {
+			const auto ec = sqlite3_step(_statement);
+			if (ec == SQLITE_DONE) {
+				sqlite3_reset(_statement);
+				break;
+			} else if (ec != SQLITE_ROW) {
+				const std::system_error error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+				sqlite3_reset(_statement);
+				throw error;
+			}
+			batch._append(_statement);
+		}
+	} catch (...) {
+		batch.clear();
+		throw;
+	}
+	return batch._rows;
+}
+
 Statement& Statement::bind_reference(Index index, const char* value)
 {
 	return _bind(index, sqlite3_bind_text, value, -1, SQLITE_STATIC);
@@ -148,6 +180,60 @@ Statement& Statement::bind_zeros(Index index, sqlite3_uint64 size)
 	return _bind(index, sqlite3_bind_zeroblob64, size);
 }
 
+Bulk_status Statement::execute_many(const std::vector<Bulk_column>& columns, const Bulk_options& options)
+{
+	if (!is_open()) {
+		throw std::system_error{ Error::statement_is_closed };
+	}
+
+	const auto rows = columns.empty() ? 0 : columns.front().size();
+	if (static_cast<int>(columns.size()) != sqlite3_bind_parameter_count(_statement)) {
+		throw std::system_error{ Error::bad_arguments };
+	}
+	for (const auto& column : columns) {
+		if (column.size() != rows) {
+			throw std::system_error{ Error::bad_arguments };
+		}
+	}
+	return _execute_many(
+	    rows,
+	    [&columns](sqlite3_stmt* statement, std::size_t row, int first_parameter) {
+		    for (std::size_t i = 0; i < columns.size(); ++i) {
+			    if (const auto ec = columns[i].bind(statement, first_parameter + static_cast<int>(i), row)) {
+				    return ec;
+			    }
+		    }
+		    return SQLITE_OK;
+	    },
+	    options);
+}
+
+Bulk_status Statement::execute_many(const std::vector<Row>& rows, const Bulk_options& options)
+{
+	if (!is_open()) {
+		throw std::system_error{ Error::statement_is_closed };
+	}
+
+	const auto parameters = static_cast<std::size_t>(sqlite3_bind_parameter_count(_statement));
+	for (const auto& row : rows) {
+		if (row.size() != parameters) {
+			throw std::system_error{ Error::bad_arguments };
+		}
+	}
+	return _execute_many(
+	    rows.size(),
+	    [&rows](sqlite3_stmt* statement, std::size_t row, int first_parameter) {
+		    const auto& values = rows[row];
+		    for (int i = 0; i < static_cast<int>(values.size()); ++i) {
+			    if (const auto ec = sqlite3_bind_value(statement, first_parameter + i, values.handle(i))) {
+				    return ec;
+			    }
+		    }
+		    return SQLITE_OK;
+	    },
+	    options);
+}
+
 bool Statement::readonly()
 {
 	if (!is_open()) {
@@ -198,19 +284,22 @@ sqlite3_stmt* Statement::release() noexcept
 {
 	auto tmp   = _statement;
 	_statement = nullptr;
+	_names.clear();
 	return tmp;
 }
 
 Statement& Statement::operator=(Statement&& move) noexcept
 {
 	std::swap(_statement, move._statement);
+	std::swap(_database, move._database);
+	std::swap(_names, move._names);
 	return *this;
 }
 
 int Statement::_to_parameter_index(Index index)
 {
 	if (index.name) {
-		const auto idx = sqlite3_bind_parameter_index(_statement, index.name);
+		const auto idx = _names.parameter(_statement, index.name);
 		if (!idx) {
 			throw std::system_error{ Error::unknown_parameter };
 		}
@@ -220,3 +309,144 @@ int Statement::_to_parameter_index(Index index)
 	}
 	return index.value + 1;
 }
+
+Column_handle Statement::column_handle(const char* name)
+{
+	if (!is_open()) {
+		throw std::system_error{ Error::statement_is_closed };
+	} else if (!name) {
+		throw std::system_error{ Error::bad_index_name };
+	}
+
+	const auto column = _names.column(_statement, name);
+	if (column < 0) {
+		throw std::system_error{ Error::unknown_parameter };
+	}
+	return Column_handle{ column };
+}
+
+void Statement::_check_columns(std::size_t count)
+{
+	if (!is_open()) {
+		throw std::system_error{ Error::statement_is_closed };
+	} else if (static_cast<std::size_t>(sqlite3_column_count(_statement)) < count) {
+		throw std::system_error{ Error::parameter_out_of_range };
+	}
+}
+
+Bulk_status Statement::_execute_many(std::size_t rows, const Row_binder& bind, const Bulk_options& options)
+{
+	const auto begin      = std::chrono::steady_clock::now();
+	const auto parameters = sqlite3_bind_parameter_count(_statement);
+	Bulk_status status;
+	Statement wide{ nullptr, nullptr };
+	const auto width          = _prepare_wide(options.rows_per_statement, rows, wide);
+	status.rows_per_statement = width;
+
+	// chunks are only committed if this call owns the transaction
+	const bool transaction = sqlite3_get_autocommit(_database);
+
+	auto chunk = transaction && options.rows_per_transaction ? options.rows_per_transaction : rows;
+	chunk      = std::max(chunk / width * width, width);
+
+	const auto execute = [&](sqlite3_stmt* statement, std::size_t first_row, std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i) {
+			if (const auto ec = bind(statement, first_row + i, static_cast<int>(i) * parameters + 1)) {
+				throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+			}
+		}
+		const auto ec = sqlite3_step(statement);
+		if (ec != SQLITE_DONE) {
+			const std::system_error error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+			sqlite3_reset(statement);
+			throw error;
+		}
+		sqlite3_reset(statement);
+		++status.statements;
+	};
+	const auto run = [this](const char* sql) {
+		if (const auto ec = sqlite3_exec(_database, sql, nullptr, nullptr, nullptr)) {
+			throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+		}
+	};
+
+	sqlite3_reset(_statement);
+	const auto _ = finally([this] { sqlite3_clear_bindings(_statement); });
+	try {
+		while (status.rows < rows) {
+			const auto end = std::min(rows, static_cast<std::size_t>(status.rows) + chunk);
+			auto row       = static_cast<std::size_t>(status.rows);
+			if (transaction) {
+				run("BEGIN");
+			}
+			for (; end - row >= width && width > 1; row += width) {
+				execute(wide._statement, row, width);
+			}
+			for (; row < end; ++row) {
+				execute(_statement, row, 1);
+			}
+			if (transaction) {
+				run("COMMIT");
+				++status.transactions;
+			}
+			status.rows = end;
+		}
+	} catch (...) {
+		if (transaction && !sqlite3_get_autocommit(_database)) {
+			sqlite3_exec(_database, "ROLLBACK", nullptr, nullptr, nullptr);
+		}
+		throw;
+	}
+
+	status.elapsed = std::chrono::steady_clock::now() - begin;
+	return status;
+}
+
+std::size_t Statement::_prepare_wide(std::size_t width, std::size_t rows, Statement& wide)
+{
+	const auto parameters = static_cast<std::size_t>(sqlite3_bind_parameter_count(_statement));
+	if (!parameters) {
+		return 1;
+	}
+
+	const auto limit = static_cast<std::size_t>(sqlite3_limit(_database, SQLITE_LIMIT_VARIABLE_NUMBER, -1));
+	width            = std::min({ width ? width : 256 / parameters, rows, limit / parameters });
+	if (width < 2) {
+		return 1;
+	}
+
+	// only `INSERT ... VALUES(?, ...)` at the end of the statement
+	const std::string sql = sqlite3_sql(_statement);
+	std::string lower     = sql;
+	std::transform(lower.begin(), lower.end(), lower.begin(),
+	               [](char c) { return std::tolower(static_cast<unsigned char>(c)); });
+	const auto start  = lower.find_first_not_of(" \t\r\n");
+	const auto values = lower.rfind("values");
+	if (start == std::string::npos || values == std::string::npos ||
+	    (lower.compare(start, 6, "insert") && lower.compare(start, 7, "replace"))) {
+		return 1;
+	}
+	const auto open  = lower.find_first_not_of(" \t\r\n", values + 6);
+	const auto close = lower.find(')', open);
+	if (open == std::string::npos || lower[open] != '(' || close == std::string::npos ||
+	    lower.find_first_not_of(" \t\r\n;", close + 1) != std::string::npos ||
+	    lower.find_first_not_of("?, \t\r\n", open + 1) != close ||
+	    static_cast<std::size_t>(std::count(lower.begin() + open, lower.begin() + close, '?')) !=
+	        parameters) {
+		return 1;
+	}
+
+	const auto group = sql.substr(open, close - open + 1);
+	auto wide_sql    = sql.substr(0, close + 1);
+	for (std::size_t i = 1; i < width; ++i) {
+		wide_sql += ',';
+		wide_sql += group;
+	}
+	// a statement which is too long for this connection falls back to single rows
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(_database, wide_sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+		return 1;
+	}
+	wide = Statement{ stmt, _database };
+	return width;
+}
@@ -1,15 +1,28 @@
 #ifndef YSQLITE3_STATEMENT_HPP_
 #define YSQLITE3_STATEMENT_HPP_
 
+#include "bulk.hpp"
+#include "column_batch.hpp"
+#include "finally.hpp"
+#include "name_table.hpp"
 #include "results.hpp"
+#include "row.hpp"
 #include "span.hpp"
 #include "sqlite3.h"
+#include "value.hpp"
 
 #include <cstddef>
+#include <functional>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+struct ArrowArray;
+struct ArrowArrayStream;
+struct ArrowSchema;
+
 namespace ysqlite3 {
 
 class Statement
@@ -87,6 +100,183 @@ public:
 	Statement& bind(Index index, double value);
 	Statement& bind(Index index, sqlite3_int64 value);
 	Statement& bind_zeros(Index index, sqlite3_uint64 size);
+	/**
+	 * Binds all parameters in order, e.g. `stmt.bind_all(1, "name", 2.5, nullptr)`. The parameters are
+	 * addressed by position without looking up an Index.
+	 *
+	 * @pre the statement is not closed
+	 *
+	 * @exception std::system_error
+	 *   - Error::statement_is_closed
+	 *   - Error::bad_arguments if the number of arguments does not match the parameters
+	 *   - see sqlite3_bind(); the parameters before the failing one remain bound and the later ones are not
+	 *     bound
+	 * @param args the values; see Value for the supported types
+	 * @return this
+	 */
+	template<typename... Args>
+	Statement& bind_all(const Args&... args)
+	{
+		if (!is_open()) {
+			throw std::system_error{ Error::statement_is_closed };
+		} else if (static_cast<int>(sizeof...(Args)) != sqlite3_bind_parameter_count(_statement)) {
+			throw std::system_error{ Error::bad_arguments };
+		}
+		_bind_all(typename Make_index_sequence<sizeof...(Args)>::type{}, args...);
+		return *this;
+	}
+	/**
+	 * Runs the statement and calls the function with the first columns of every row:
+	 *
+	 * ```cpp
+	 * stmt.query<std::int64_t, const char*>([](std::int64_t id, const char* name) { ... });
+	 * ```
+	 *
+	 * The types and positions of the columns are fixed at compile time, so only the column count is checked
+	 * once and every row is read without further validation.
+	 *
+	 * @pre the statement is not closed
+	 * @post the statement is reset
+	 *
+	 * @exception std::system_error
+	 *   - Error::statement_is_closed
+	 *   - Error::parameter_out_of_range if the statement has fewer columns
+	 *   - see sqlite3_step() and Value::get()
+	 * @exception any the exception of the function
+	 * @tparam Columns the types of the columns; see Value
+	 * @param function called with the values; values which are not owning are valid until it returns
+	 * @return the number of rows
+	 */
+	template<typename... Columns, typename Function>
+	std::size_t query(Function&& function)
+	{
+		_check_columns(sizeof...(Columns));
+		return _for_each_row([this, &function] {
+			_invoke<Columns...>(function, typename Make_index_sequence<sizeof...(Columns)>::type{});
+		});
+	}
+	/**
+	 * Runs the statement and returns the first columns of all rows; see the version with a function.
+	 *
+	 * @tparam Columns the types of the columns; all of them must be owning, e.g. `std::string` instead of
+	 * `const char*`
+	 * @return the rows
+	 */
+	template<typename... Columns>
+	std::vector<std::tuple<Columns...>> query()
+	{
+		static_assert(All_owning<Columns...>::value, "the values would not outlive their row");
+
+		std::vector<std::tuple<Columns...>> rows;
+		_check_columns(sizeof...(Columns));
+		_for_each_row([this, &rows] {
+			rows.push_back(_decode<Columns...>(typename Make_index_sequence<sizeof...(Columns)>::type{}));
+		});
+		return rows;
+	}
+	/**
+	 * Runs the statement and maps the first columns of all rows to the members of a default constructible
+	 * type, e.g. `stmt.query_as<User>(&User::id, &User::name)`; see the version of query() with a function.
+	 *
+	 * @tparam Type the mapped type
+	 * @param members the member for every column; the column types are the member types
+	 * @return the rows
+	 */
+	template<typename Type, typename... Members>
+	std::vector<Type> query_as(Members Type::*... members)
+	{
+		static_assert(All_owning<Members...>::value, "the members would not outlive their row");
+
+		std::vector<Type> rows;
+		_check_columns(sizeof...(Members));
+		_for_each_row([&] {
+			Type row{};
+			_assign(row, typename Make_index_sequence<sizeof...(Members)>::type{}, members...);
+			rows.push_back(std::move(row));
+		});
+		return rows;
+	}
+	/**
+	 * Runs this statement, usually an INSERT, once for every row of the columns. If no transaction is active,
+	 * the rows are committed in chunks. A single-row `INSERT ... VALUES(?, ...)` with anonymous parameters is
+	 * rewritten into a statement inserting many rows at once.
+	 *
+	 * @pre the statement is not closed
+	 * @post the statement is reset and its bindings are cleared
+	 *
+	 * @exception std::system_error
+	 *   - Error::statement_is_closed
+	 *   - Error::bad_arguments if the number of columns does not match the parameters or the columns have
+	 *     different sizes
+	 *   - see sqlite3_step(); the committed chunks remain
+	 * @param columns one column for every parameter
+	 * @param options the options
+	 * @return the statistics
+	 */
+	Bulk_status execute_many(const std::vector<Bulk_column>& columns, const Bulk_options& options = {});
+	/**
+	 * Runs this statement for every row; see the column-oriented version.
+	 *
+	 * @exception see the column-oriented version; Error::bad_arguments if a row does not match the parameters
+	 * @param rows the rows, for example of a query in another database
+	 * @param options the options
+	 * @return the statistics
+	 */
+	Bulk_status execute_many(const std::vector<Row>& rows, const Bulk_options& options = {});
+	/**
+	 * Steps up to `batch_size` times and stores the rows column by column. A batch with fewer rows is the
+	 * last one; the statement is reset and the next call starts over.
+	 *
+	 * @pre the statement is not closed
+	 *
+	 * @exception std::system_error
+	 *   - Error::statement_is_closed
+	 *   - SQLite3_code::memory if a value could not be converted
+	 *   - see sqlite3_step()
+	 *   the batch is empty afterwards
+	 * @param[in,out] batch the batch which is cleared and filled; reuse it for all batches of this statement
+	 * @param batch_size the maximum number of rows
+	 * @return the number of fetched rows
+	 */
+	std::size_t fetch_columns(Column_batch& batch, std::size_t batch_size);
+	/**
+	 * Moves this statement into an Arrow C stream of its rows. Every array of the stream is a struct array
+	 * with one child per column; the buffers of fetch_columns() are handed over without copying. Integers
+	 * are exported as `int64`, reals as `float64`, text as `large_utf8` and blobs as `large_binary`; columns
+	 * which are null in the whole first batch are exported as text. Integers of columns whose type was decided
+	 * by the values, like `DECIMAL(10,2)` or expressions, are exported as `float64` because later values may
+	 * be reals. The schema is fixed by the first batch; if a later value needs a wider type (see
+	 * Column_batch), the stream fails with `EIO`. The stream owns the statement and finalizes it when it is
+	 * released; a Cached_statement does not go back to its cache.
+	 *
+	 * @pre the statement is not closed
+	 * @post the statement is closed
+	 *
+	 * @exception std::system_error Error::statement_is_closed or Error::bad_arguments if `batch_size` is 0
+	 * @param[out] stream the stream; the consumer must release it
+	 * @param batch_size the maximum number of rows per array
+	 */
+	void export_arrow(ArrowArrayStream* stream, std::size_t batch_size = 65536);
+	/**
+	 * Runs this statement, usually an INSERT, once for every row of an Arrow struct array like
+	 * execute_many(). The children are bound to the parameters in order and their buffers are bound without
+	 * copying. Supported are null, boolean, integer, floating point, utf8 and binary arrays and their large
+	 * variants.
+	 *
+	 * @pre the statement is not closed
+	 * @post the statement is reset and its bindings are cleared
+	 *
+	 * @exception std::system_error
+	 *   - Error::statement_is_closed
+	 *   - Error::bad_arguments if the array is no struct array, a child has an unsupported type or the
+	 *     number of children does not match the parameters
+	 *   - see execute_many()
+	 * @param schema the schema of the array which is not released
+	 * @param[in,out] array the array which is released afterwards, even if this function fails
+	 * @param options the options
+	 * @return the statistics
+	 */
+	Bulk_status import_arrow(const ArrowSchema* schema, ArrowArray* array, const Bulk_options& options = {});
 	/// Returns whether the statement makes no direct changes to the database.
 	bool readonly();
 	/**
@@ -114,6 +304,20 @@ public:
 	 * @return the column name
 	 */
 	std::vector<std::string> columns();
+	/**
+	 * Resolves a column name ahead of time, so the Results of this statement can be read without looking up
+	 * the name for every row. Names are compared case-insensitively for ASCII letters.
+	 *
+	 * @pre the statement is not closed
+	 *
+	 * @exception std::system_error
+	 *   - Error::statement_is_closed
+	 *   - Error::bad_index_name if the name is `nullptr`
+	 *   - Error::unknown_parameter if there is no such column
+	 * @param name the column name
+	 * @return the handle which is valid for the results of this statement
+	 */
+	Column_handle column_handle(const char* name);
 	/**
 	 * Returns the SQLite3 statment handle.
 	 *
@@ -138,8 +342,12 @@ public:
 	Statement& operator=(Statement&& move) noexcept;
 
 private:
+	typedef std::function<int(sqlite3_stmt* statement, std::size_t row, int first_parameter)> Row_binder;
+
 	sqlite3_stmt* _statement = nullptr;
 	sqlite3* _database       = nullptr;
+	/// Shared with the Results of this statement.
+	Name_table _names;
 
 	/**
 	 * Returns the integer index of the parameter.
@@ -149,6 +357,83 @@ private:
 	 * @return the integer index
 	 */
 	int _to_parameter_index(Index index);
+	Bulk_status _execute_many(std::size_t rows, const Row_binder& bind, const Bulk_options& options);
+	/**
+	 * Prepares this INSERT with multiple rows.
+	 *
+	 * @param width the desired rows; 0 for automatic
+	 * @param rows the rows to insert
+	 * @param[out] wide the prepared statement
+	 * @return the rows of `wide` or 1 if the statement cannot be rewritten
+	 */
+	std::size_t _prepare_wide(std::size_t width, std::size_t rows, Statement& wide);
+	/**
+	 * Checks the columns of the typed API.
+	 *
+	 * @exception std::system_error Error::statement_is_closed or Error::parameter_out_of_range
+	 * @param count the columns read
+	 */
+	void _check_columns(std::size_t count);
+	/**
+	 * Steps to the end and calls the function for every row.
+	 *
+	 * @post the statement is reset
+	 *
+	 * @exception std::system_error see sqlite3_step()
+	 * @exception any the exception of the function
+	 * @return the number of rows
+	 */
+	template<typename Function>
+	std::size_t _for_each_row(Function&& function)
+	{
+		const auto _     = finally([this] { sqlite3_reset(_statement); });
+		std::size_t rows = 0;
+		while (true) {
+			const auto ec = sqlite3_step(_statement);
+			if (ec == SQLITE_DONE) {
+				return rows;
+			} else if (ec != SQLITE_ROW) {
+				throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+			}
+			function();
+			++rows;
+		}
+	}
+	template<std::size_t... Indices, typename... Args>
+	void _bind_all(Index_sequence<Indices...>, const Args&... args)
+	{
+		// the initializers run in order, so binding stops at the first failure
+		int ec              = SQLITE_OK;
+		const int results[] = { SQLITE_OK, (ec = ec ? ec : _bind_value(static_cast<int>(Indices) + 1, args))... };
+		static_cast<void>(results);
+		if (ec) {
+			throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(_database) };
+		}
+	}
+	template<typename Type>
+	int _bind_value(int parameter, const Type& value) noexcept
+	{
+		// string literals decay to `const char*`
+		return Value<typename std::decay<const Type>::type>::bind(_statement, parameter, value);
+	}
+	template<typename... Columns, typename Function, std::size_t... Indices>
+	void _invoke(Function& function, Index_sequence<Indices...>)
+	{
+		function(Value<Columns>::get(_statement, static_cast<int>(Indices))...);
+	}
+	template<typename... Columns, std::size_t... Indices>
+	std::tuple<Columns...> _decode(Index_sequence<Indices...>)
+	{
+		return std::tuple<Columns...>(Value<Columns>::get(_statement, static_cast<int>(Indices))...);
+	}
+	template<typename Type, std::size_t... Indices, typename... Members>
+	void _assign(Type& row, Index_sequence<Indices...>, Members Type::*... members)
+	{
+		const int assigned[] = {
+			0, (row.*members = Value<Members>::get(_statement, static_cast<int>(Indices)), 0)...
+		};
+		static_cast<void>(assigned);
+	}
 	template<typename Binder, typename... Args>
 	Statement& _bind(const Index& index, Binder&& binder, Args&&... args)
 	{
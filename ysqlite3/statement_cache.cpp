@@ -0,0 +1,104 @@
+#include "statement_cache.hpp"
+
+using namespace ysqlite3;
+
+Statement_cache::Statement_cache(std::size_t capacity) noexcept : _capacity{ capacity }
+{}
+
+Statement_cache::~Statement_cache()
+{
+	clear();
+}
+
+sqlite3_stmt* Statement_cache::take(const std::string& sql)
+{
+	const auto it = _index.find(sql);
+	if (it == _index.end()) {
+		++_status.misses;
+		return nullptr;
+	}
+
+	const auto statement = it->second->second;
+	_statements.erase(it->second);
+	_index.erase(it);
+	++_status.hits;
+	return statement;
+}
+
+void Statement_cache::put(std::string sql, sqlite3_stmt* statement) noexcept
+{
+	// the error of the last step was already reported
+	sqlite3_reset(statement);
+	sqlite3_clear_bindings(statement);
+	if (!_capacity || _index.count(sql)) {
+		sqlite3_finalize(statement);
+		return;
+	}
+
+	try {
+		_statements.emplace_front(std::move(sql), statement);
+		try {
+			_index.emplace(_statements.front().first, _statements.begin());
+		} catch (...) {
+			_statements.pop_front();
+			throw;
+		}
+	} catch (...) {
+		sqlite3_finalize(statement);
+		return;
+	}
+	_evict(_capacity);
+}
+
+void Statement_cache::set_capacity(std::size_t capacity) noexcept
+{
+	_capacity = capacity;
+	_evict(capacity);
+}
+
+void Statement_cache::clear() noexcept
+{
+	_evict(0);
+}
+
+Statement_cache_status Statement_cache::status() const noexcept
+{
+	auto status = _status;
+	status.size = _statements.size();
+	return status;
+}
+
+void Statement_cache::_evict(std::size_t size) noexcept
+{
+	while (_statements.size() > size) {
+		_index.erase(_statements.back().first);
+		sqlite3_finalize(_statements.back().second);
+		_statements.pop_back();
+	}
+}
+
+Cached_statement::Cached_statement(Statement statement, std::weak_ptr<Statement_cache> cache,
+                                   std::string sql) noexcept
+    : Statement{ std::move(statement) }, _cache{ std::move(cache) }, _sql{ std::move(sql) }
+{}
+
+Cached_statement::Cached_statement(Cached_statement&& move) noexcept
+    : Statement{ std::move(move) }, _cache{ std::move(move._cache) }, _sql{ std::move(move._sql) }
+{}
+
+Cached_statement::~Cached_statement()
+{
+	if (is_open()) {
+		if (const auto cache = _cache.lock()) {
+			cache->put(std::move(_sql), release());
+		}
+	}
+}
+
+Cached_statement& Cached_statement::operator=(Cached_statement&& move) noexcept
+{
+	Statement::operator=(std::move(move));
+	std::swap(_cache, move._cache);
+	std::swap(_sql, move._sql);
+	return *this;
+}
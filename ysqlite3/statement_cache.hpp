@@ -0,0 +1,100 @@
+#ifndef YSQLITE3_STATEMENT_CACHE_HPP_
+#define YSQLITE3_STATEMENT_CACHE_HPP_
+
+#include "sqlite3.h"
+#include "statement.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace ysqlite3 {
+
+class Database;
+
+struct Statement_cache_status
+{
+	/// The statements taken from the cache.
+	std::uint64_t hits = 0;
+	/// The statements which had to be prepared.
+	std::uint64_t misses = 0;
+	/// The idle statements in the cache.
+	std::size_t size = 0;
+};
+
+/**
+ * The idle prepared statements of a database connection keyed by their SQL text. When the capacity is
+ * exceeded, the least recently used statement is finalized. Statements prepared with sqlite3_prepare_v2() are
+ * recompiled by SQLite when the schema changes, so cached statements never go stale.
+ */
+class Statement_cache
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param capacity the maximum number of idle statements
+	 */
+	Statement_cache(std::size_t capacity) noexcept;
+	/// Finalizes all idle statements.
+	~Statement_cache();
+	/**
+	 * Removes a statement from the cache.
+	 *
+	 * @param sql the SQL text
+	 * @return the statement or `nullptr` if none is cached
+	 */
+	sqlite3_stmt* take(const std::string& sql);
+	/**
+	 * Resets the statement, clears its bindings and puts it into the cache. If the statement cannot be cached,
+	 * it is finalized.
+	 *
+	 * @param sql the SQL text
+	 * @param statement the statement
+	 */
+	void put(std::string sql, sqlite3_stmt* statement) noexcept;
+	void set_capacity(std::size_t capacity) noexcept;
+	/// Finalizes all idle statements.
+	void clear() noexcept;
+	Statement_cache_status status() const noexcept;
+
+private:
+	typedef std::list<std::pair<std::string, sqlite3_stmt*>> List;
+
+	std::size_t _capacity;
+	/// The most recently used statement first.
+	List _statements;
+	std::unordered_map<std::string, List::iterator> _index;
+	Statement_cache_status _status;
+
+	void _evict(std::size_t size) noexcept;
+};
+
+/**
+ * A statement taken from the cache of a Database. When it is destroyed, it is reset and returned to the cache
+ * instead of being finalized. Closing or releasing the statement removes it from the cache.
+ */
+class Cached_statement : public Statement
+{
+public:
+	Cached_statement(Cached_statement&& move) noexcept;
+	/// Returns the statement to the cache; if the database was closed, the statement is finalized.
+	~Cached_statement();
+	Cached_statement& operator=(Cached_statement&& move) noexcept;
+
+private:
+	friend Database;
+
+	std::weak_ptr<Statement_cache> _cache;
+	std::string _sql;
+
+	Cached_statement(Statement statement, std::weak_ptr<Statement_cache> cache, std::string sql) noexcept;
+};
+
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,581 @@
+#include "table_exporter.hpp"
+
+#include "base64.hpp"
+#include "config.hpp"
+#include "finally.hpp"
+#include "row.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace ysqlite3;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+void append_integer(std::string& output, sqlite3_int64 value)
+{
+	char buffer[20];
+	auto position  = buffer + sizeof(buffer);
+	auto magnitude = value < 0 ? 0 - static_cast<std::uint64_t>(value) : static_cast<std::uint64_t>(value);
+	do {
+		*--position = static_cast<char>('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude);
+	if (value < 0) {
+		*--position = '-';
+	}
+	output.append(position, buffer + sizeof(buffer));
+}
+
+/// Appends the shortest of 15, 16 or 17 digits which reads back as the same value.
+void append_real(std::string& output, double value, bool json)
+{
+	if (!std::isfinite(value)) {
+		// SQLite stores NaN as null
+		output += json ? "null" : value > 0 ? "Inf" : "-Inf";
+		return;
+	}
+
+	char buffer[32];
+	int size = 0;
+	for (auto precision : { 15, 16, 17 }) {
+		size = std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+		if (std::strtod(buffer, nullptr) == value) {
+			break;
+		}
+	}
+	output.append(buffer, static_cast<std::size_t>(size));
+	// keeps the value a real when it is read again
+	if (!std::strpbrk(buffer, ".e")) {
+		output += ".0";
+	}
+}
+
+void append_csv(std::string& output, const char* text, std::size_t size)
+{
+	const auto end     = text + size;
+	const auto special = [](char c) { return c == ',' || c == '"' || c == '\n' || c == '\r'; };
+	if (size && std::none_of(text, end, special)) {
+		output.append(text, size);
+		return;
+	}
+
+	// an empty string is quoted to tell it from null
+	output += '"';
+	for (auto quote = std::find(text, end, '"'); quote != end; quote = std::find(text, end, '"')) {
+		output.append(text, quote + 1);
+		output += '"';
+		text = quote + 1;
+	}
+	output.append(text, end);
+	output += '"';
+}
+
+void append_json(std::string& output, const char* text, std::size_t size)
+{
+	output += '"';
+	auto start = text;
+	for (auto position = text; position < text + size; ++position) {
+		const auto c = static_cast<unsigned char>(*position);
+		if (c >= 0x20 && c != '"' && c != '\\') {
+			continue;
+		}
+
+		output.append(start, position);
+		start = position + 1;
+		switch (c) {
+		case '"': output += "\\\""; break;
+		case '\\': output += "\\\\"; break;
+		case '\n': output += "\\n"; break;
+		case '\r': output += "\\r"; break;
+		case '\t': output += "\\t"; break;
+		default: {
+			constexpr auto digits = "0123456789abcdef";
+			const char escaped[] = { '\\', 'u', '0', '0', digits[c >> 4], digits[c & 0xf] };
+			output.append(escaped, sizeof(escaped));
+			break;
+		}
+		}
+	}
+	output.append(start, text + size);
+	output += '"';
+}
+
+class Formatter
+{
+public:
+	Formatter(Export_format format, sqlite3_stmt* statement) : _json{ format == Export_format::json_lines }
+	{
+		for (int i = 0; i < sqlite3_column_count(statement); ++i) {
+			const auto name = sqlite3_column_name(statement, i);
+			if (!name) {
+				throw std::system_error{ SQLite3_code::memory };
+			}
+			_names.emplace_back();
+			if (_json) {
+				append_json(_names.back(), name, std::strlen(name));
+				_names.back() += ':';
+			} else {
+				append_csv(_names.back(), name, std::strlen(name));
+			}
+		}
+	}
+	/// Appends the header row of CSV.
+	void header(std::string& output) const
+	{
+		if (!_json) {
+			for (std::size_t i = 0; i < _names.size(); ++i) {
+				output += i ? "," : "";
+				output += _names[i];
+			}
+			output += '\n';
+		}
+	}
+	void row(sqlite3_stmt* statement, std::string& output) const
+	{
+		if (_json) {
+			output += '{';
+		}
+		for (int i = 0; i < static_cast<int>(_names.size()); ++i) {
+			if (i) {
+				output += ',';
+			}
+			if (_json) {
+				output += _names[i];
+			}
+
+			switch (sqlite3_column_type(statement, i)) {
+			case SQLITE_INTEGER: append_integer(output, sqlite3_column_int64(statement, i)); break;
+			case SQLITE_FLOAT: append_real(output, sqlite3_column_double(statement, i), _json); break;
+			case SQLITE_TEXT: {
+				const auto text = reinterpret_cast<const char*>(sqlite3_column_text(statement, i));
+				const auto size = static_cast<std::size_t>(sqlite3_column_bytes(statement, i));
+				if (!text) {
+					throw std::system_error{ SQLite3_code::memory };
+				}
+				if (_json) {
+					append_json(output, text, size);
+				} else {
+					append_csv(output, text, size);
+				}
+				break;
+			}
+			case SQLITE_BLOB: {
+				const auto blob = static_cast<const char*>(sqlite3_column_blob(statement, i));
+				const auto size = static_cast<std::size_t>(sqlite3_column_bytes(statement, i));
+				output += _json ? "\"" : "";
+				base64::encode(blob, blob + size, std::back_inserter(output));
+				output += _json ? "\"" : "";
+				break;
+			}
+			default: output += _json ? "null" : ""; break;
+			}
+		}
+		output += _json ? "}\n" : "\n";
+	}
+
+private:
+	bool _json;
+	/// The escaped names; for JSON with the colon.
+	std::vector<std::string> _names;
+};
+
+std::string quote_identifier(const char* name)
+{
+	std::string quoted = "\"";
+	for (; *name; ++name) {
+		quoted += *name;
+		if (*name == '"') {
+			quoted += '"';
+		}
+	}
+	return quoted + "\"";
+}
+
+Statement prepare(sqlite3* database, const std::string& sql)
+{
+	sqlite3_stmt* statement = nullptr;
+	if (const auto ec = sqlite3_prepare_v2(database, sql.c_str(), -1, &statement, nullptr)) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec), sqlite3_errmsg(database) };
+	}
+	return { statement, database };
+}
+
+/// Binds the key of the row to the parameter.
+void bind(Statement& statement, int parameter, const Row& key)
+{
+	if (const auto ec = sqlite3_bind_value(statement.handle(), parameter, key.handle(0))) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec) };
+	}
+}
+
+/**
+ * Opens a read-only connection per thread on the snapshot of the read transaction of `database`.
+ *
+ * @return the connections or none if the database has no file or snapshot
+ */
+std::vector<Database> open_readers(sqlite3* database, std::size_t count)
+{
+	std::vector<Database> readers;
+#if YSQLITE3_ENABLE_SNAPSHOT
+	const auto file            = sqlite3_db_filename(database, "main");
+	sqlite3_snapshot* snapshot = nullptr;
+	if (count < 2 || !file || !*file || sqlite3_snapshot_get(database, "main", &snapshot) != SQLITE_OK) {
+		return readers;
+	}
+	const auto _ = finally([snapshot] { sqlite3_snapshot_free(snapshot); });
+
+	sqlite3_vfs* vfs = nullptr;
+	sqlite3_file_control(database, "main", SQLITE_FCNTL_VFS_POINTER, &vfs);
+	try {
+		for (std::size_t i = 0; i < count; ++i) {
+			Database reader;
+			reader.open(file, open_flag_readonly, vfs ? vfs->zName : nullptr);
+			reader.execute("BEGIN");
+			if (const auto ec = sqlite3_snapshot_open(reader.handle(), "main", snapshot)) {
+				throw std::system_error{ static_cast<SQLite3_code>(ec) };
+			}
+			readers.push_back(std::move(reader));
+		}
+	} catch (const std::system_error&) {
+		// for example a VFS which needs parameters of the URI
+		readers.clear();
+	}
+#else
+	static_cast<void>(database);
+	static_cast<void>(count);
+#endif
+	return readers;
+}
+
+/// Receives the formatted text block by block.
+class Output
+{
+public:
+	virtual ~Output() = default;
+	/// Writes the block and returns the number of bytes written.
+	virtual std::size_t write(const std::string& block) = 0;
+	/// Called after the last block of a partition.
+	virtual void finish()
+	{}
+};
+
+class Stream_output : public Output
+{
+public:
+	Stream_output(std::ostream& stream) noexcept : _stream{ stream }
+	{}
+	std::size_t write(const std::string& block) override
+	{
+		if (!_stream.write(block.data(), static_cast<std::streamsize>(block.size()))) {
+			throw std::system_error{ std::make_error_code(std::errc::io_error) };
+		}
+		return block.size();
+	}
+
+private:
+	std::ostream& _stream;
+};
+
+class File_output : public Output
+{
+public:
+	File_output(std::string name) : _name{ std::move(name) }, _file{ std::fopen(_name.c_str(), "wb") }
+	{
+		if (!_file) {
+			throw std::system_error{ errno, std::generic_category(), _name };
+		}
+	}
+	~File_output()
+	{
+		if (_file) {
+			std::fclose(_file);
+		}
+	}
+	std::size_t write(const std::string& block) override
+	{
+		if (std::fwrite(block.data(), 1, block.size(), _file) != block.size()) {
+			throw std::system_error{ std::make_error_code(std::errc::io_error), _name };
+		}
+		return block.size();
+	}
+	void finish() override
+	{
+		const auto file = _file;
+		_file           = nullptr;
+		if (std::fclose(file)) {
+			throw std::system_error{ std::make_error_code(std::errc::io_error), _name };
+		}
+	}
+
+private:
+	std::string _name;
+	std::FILE* _file;
+};
+
+/// Opens the output of a partition for the worker threads.
+typedef std::function<std::unique_ptr<Output>(std::size_t partition)> Open_output;
+
+/// The blocks of a partition which wait for the ordered output.
+struct Pending_partition
+{
+	std::deque<std::string> blocks;
+	bool done = false;
+};
+
+/**
+ * Exports the partitions with the threads. If `ordered` is set, the calling thread writes the header and all
+ * partitions to it in order and the threads wait once `2 * threads` blocks are buffered. Otherwise every
+ * partition is written by its thread to an output of `open` which starts with the header.
+ */
+Export_status export_partitions(Database& database, const char* table, const Export_options& options,
+                                Output* ordered, const Open_output& open)
+{
+	if (!database.is_open()) {
+		throw std::system_error{ Error::database_is_closed };
+	}
+
+	const auto start = Clock::now();
+	Export_status status{};
+	const auto db = database.handle();
+
+	// the read transaction holds the snapshot until every reader has opened it
+	const bool own_transaction = sqlite3_get_autocommit(db);
+	if (own_transaction) {
+		database.execute("BEGIN");
+	}
+	const auto end_transaction = [&] {
+		if (own_transaction && !sqlite3_get_autocommit(db)) {
+			sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+		}
+	};
+	const auto _ = finally(end_transaction);
+
+	const auto from   = " FROM " + quote_identifier(table) + " WHERE " + options.key;
+	const auto where  = options.where.empty() ? std::string{} : " AND (" + options.where + ")";
+	const auto order  = " ORDER BY " + options.key;
+	const auto select = "SELECT " + options.columns + from + " >= ?1";
+	// the last partition has no upper bound
+	const auto sql      = select + " AND " + options.key + " < ?2" + where + order;
+	const auto last_sql = select + where + order;
+
+	// every partition starts at a key of the data, so sparse keys do not create empty partitions; the
+	// threads only read the keys when binding them
+	std::vector<Row> bounds;
+	const auto limit = std::max<std::uint64_t>(options.rows_per_partition, 1);
+	auto keys        = prepare(db, "SELECT " + options.key + from + " IS NOT NULL" + where + order);
+	for (std::uint64_t i = 0; keys.step(); ++i) {
+		if (i % limit == 0) {
+			bounds.emplace_back(keys.handle());
+		}
+	}
+	keys.finish();
+	status.partitions = bounds.size();
+	const Formatter formatter{ options.format, prepare(db, sql).handle() };
+	const auto block_size = std::max<std::size_t>(options.block_size, 1);
+
+	auto threads = options.threads ? options.threads : std::max(std::thread::hardware_concurrency(), 1u);
+	threads      = std::max<std::size_t>(std::min(threads, status.partitions), 1);
+	auto readers = open_readers(db, threads);
+
+	status.parallel_reads = !readers.empty();
+	if (status.parallel_reads) {
+		end_transaction();
+	} else if (!sqlite3_db_mutex(db)) {
+		// the connection cannot be shared
+		threads = 1;
+	}
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::vector<Pending_partition> pending(ordered ? status.partitions : 0);
+	const auto max_buffered    = 2 * threads;
+	std::size_t buffered       = 0;
+	std::size_t buffered_bytes = 0;
+	std::size_t current        = 0;
+	std::size_t next           = 0;
+	bool stop                  = false;
+	std::exception_ptr error;
+	std::vector<std::thread> workers;
+	const auto join = finally([&] {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stop = true;
+		}
+		condition.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	});
+	for (std::size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t] {
+			try {
+				const auto reader = readers.empty() ? db : readers[t].handle();
+				auto statement    = prepare(reader, sql);
+				auto last         = prepare(reader, last_sql);
+				while (true) {
+					std::size_t index = 0;
+					{
+						std::lock_guard<std::mutex> lock{ mutex };
+						if (stop || next >= status.partitions) {
+							return;
+						}
+						index = next++;
+					}
+
+					std::unique_ptr<Output> output;
+					std::string block;
+					std::size_t bytes = 0;
+					if (!ordered) {
+						output = open(index);
+						formatter.header(block);
+					}
+					// returns `false` if the export stopped
+					const auto hand_over = [&](bool done) {
+						if (output) {
+							bytes += block.empty() ? 0 : output->write(block);
+							block.clear();
+							if (done) {
+								output->finish();
+							}
+							return true;
+						}
+
+						std::unique_lock<std::mutex> lock{ mutex };
+						auto& partition = pending[index];
+						if (!block.empty()) {
+							// the partition which is written next may always go ahead
+							condition.wait(lock, [&] {
+								return stop || buffered < max_buffered ||
+								       (index == current && partition.blocks.size() < 2);
+							});
+							if (stop) {
+								return false;
+							}
+							++buffered;
+							buffered_bytes += block.size();
+							status.peak_buffered = std::max(status.peak_buffered, buffered_bytes);
+							partition.blocks.push_back(std::move(block));
+							block = std::string{};
+						}
+						partition.done = done;
+						condition.notify_all();
+						return true;
+					};
+
+					auto& query = index + 1 < bounds.size() ? statement : last;
+					bind(query, 1, bounds[index]);
+					if (index + 1 < bounds.size()) {
+						bind(query, 2, bounds[index + 1]);
+					}
+					std::uint64_t rows = 0;
+					for (; query.step(); ++rows) {
+						formatter.row(query.handle(), block);
+						if (block.size() >= block_size && !hand_over(false)) {
+							return;
+						}
+					}
+					query.reset();
+					if (!hand_over(true)) {
+						return;
+					}
+
+					std::lock_guard<std::mutex> lock{ mutex };
+					status.rows += rows;
+					status.bytes += bytes;
+				}
+			} catch (...) {
+				std::lock_guard<std::mutex> lock{ mutex };
+				error = std::current_exception();
+				stop  = true;
+				condition.notify_all();
+			}
+		});
+	}
+
+	if (ordered) {
+		std::string header;
+		formatter.header(header);
+		status.bytes += ordered->write(header);
+	}
+	for (std::size_t i = 0; i < pending.size(); ++i) {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			current = i;
+		}
+		condition.notify_all();
+		while (true) {
+			std::string block;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				condition.wait(lock, [&] { return error || !pending[i].blocks.empty() || pending[i].done; });
+				if (error) {
+					std::rethrow_exception(error);
+				} else if (pending[i].blocks.empty()) {
+					break;
+				}
+				block = std::move(pending[i].blocks.front());
+				pending[i].blocks.pop_front();
+				--buffered;
+				buffered_bytes -= block.size();
+			}
+			condition.notify_all();
+			status.bytes += ordered->write(block);
+		}
+	}
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	status.elapsed = Clock::now() - start;
+	return status;
+}
+
+} // namespace
+
+Export_status ysqlite3::export_table(Database& database, const char* table, std::ostream& output,
+                                     const Export_options& options)
+{
+	Stream_output stream{ output };
+	return export_partitions(database, table, options, &stream, nullptr);
+}
+
+Export_status ysqlite3::export_table_parts(Database& database, const char* table, const std::string& prefix,
+                                           const Export_options& options)
+{
+	const auto extension = options.format == Export_format::csv ? ".csv" : ".jsonl";
+	std::mutex mutex;
+	std::vector<std::string> files;
+	auto status = export_partitions(database, table, options, nullptr, [&](std::size_t partition) {
+		char number[32];
+		std::snprintf(number, sizeof(number), "-%05zu", partition);
+		const auto name = prefix + number + extension;
+		std::unique_ptr<Output> output{ new File_output{ name } };
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		files.push_back(name);
+		return output;
+	});
+	std::sort(files.begin(), files.end());
+	status.files = std::move(files);
+	return status;
+}
@@ -0,0 +1,95 @@
+#ifndef YSQLITE3_TABLE_EXPORTER_HPP_
+#define YSQLITE3_TABLE_EXPORTER_HPP_
+
+#include "database.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ysqlite3 {
+
+enum class Export_format
+{
+	/// RFC 4180 with a header row; null is an empty field and blobs are base64.
+	csv,
+	/// One JSON object per line; blobs are base64 and infinite or NaN reals are null.
+	json_lines
+};
+
+struct Export_options
+{
+	Export_format format = Export_format::csv;
+	/// The exported columns or expressions.
+	std::string columns = "*";
+	/// An optional condition for the rows.
+	std::string where;
+	/// The key which partitions the table, best an indexed column like the `PRIMARY KEY` of a `WITHOUT ROWID`
+	/// table. The rows are exported in its order; rows whose key is null are not exported.
+	std::string key = "rowid";
+	/// The most rows of one partition.
+	std::uint64_t rows_per_partition = 100000;
+	/// The formatting threads; 0 uses one per core.
+	std::size_t threads = 0;
+	/// The size of the blocks of formatted rows which the threads hand to the output.
+	std::size_t block_size = 1 << 20;
+};
+
+struct Export_status
+{
+	std::uint64_t rows       = 0;
+	std::uint64_t bytes      = 0;
+	std::size_t partitions   = 0;
+	/// Whether every thread read with its own connection.
+	bool parallel_reads = false;
+	/// The most bytes of formatted rows which waited for export_table() to write them.
+	std::size_t peak_buffered = 0;
+	/// The part files written by export_table_parts().
+	std::vector<std::string> files;
+	std::chrono::nanoseconds elapsed{ 0 };
+
+	double rows_per_second() const noexcept
+	{
+		return elapsed.count() ? rows * 1e9 / elapsed.count() : 0.0;
+	}
+};
+
+/**
+ * Exports a table in parallel. The table is split into partitions at keys sampled from the data, so sparse or
+ * non-integer keys partition as well as dense ones, and the threads read and format them independently.
+ * The output is streamed: the threads hand blocks of `block_size` bytes to the calling thread, which writes
+ * them in order, and wait once two blocks per thread are buffered.
+ *
+ * If the database is a WAL mode file and the library was built with `YSQLITE3_ENABLE_SNAPSHOT`, every
+ * thread reads with its own read-only connection which opens the snapshot of `database` with
+ * sqlite3_snapshot_open(), so all partitions see the same data while other connections write. Otherwise all
+ * threads read with `database`, within one read transaction, and only formatting runs in parallel.
+ *
+ * @exception std::system_error
+ *   - Error::database_is_closed
+ *   - `std::errc::io_error` if writing failed
+ *   - see sqlite3_prepare_v2() and sqlite3_step() for error codes
+ * @param database the database; it must not be used by other threads during the export
+ * @param table the table in the main database
+ * @param output receives the partitions in the order of the key
+ * @param options the format and partitioning
+ * @return the statistics
+ */
+Export_status export_table(Database& database, const char* table, std::ostream& output,
+                           const Export_options& options = {});
+/**
+ * Like export_table() but every thread writes its partitions to their own files block by block without
+ * waiting for the others. The files are named `prefix-00000.csv` or `prefix-00000.jsonl` and so on and every
+ * CSV file has a header row.
+ *
+ * @exception see export_table(); `std::generic_category()` if a file could not be created
+ */
+Export_status export_table_parts(Database& database, const char* table, const std::string& prefix,
+                                 const Export_options& options = {});
+
+} // namespace ysqlite3
+
+#endif
@@ -1,12 +1,47 @@
 #include "transaction.hpp"
 
 #include "database.hpp"
+#include "finally.hpp"
+
+#include <algorithm>
+#include <random>
+#include <thread>
 
 using namespace ysqlite3;
 
-Transaction::Transaction(std::shared_ptr<Database> db) noexcept : _db{ std::move(db) }
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char* begin_statement(Transaction_mode mode) noexcept
+{
+	switch (mode) {
+	case Transaction_mode::immediate: return "BEGIN IMMEDIATE TRANSACTION;";
+	case Transaction_mode::exclusive: return "BEGIN EXCLUSIVE TRANSACTION;";
+	default: return "BEGIN TRANSACTION;";
+	}
+}
+
+/// Whether another connection holds the lock, so trying again may succeed.
+bool is_contention(const std::system_error& e) noexcept
+{
+	const auto primary = e.code().value() & 0xff;
+	return e.code().category() == sqlite3_category() && (primary == SQLITE_BUSY || primary == SQLITE_LOCKED);
+}
+
+void rollback(Database& database) noexcept
+{
+	// a failed statement may have rolled back the transaction already
+	if (!sqlite3_get_autocommit(database.handle())) {
+		sqlite3_exec(database.handle(), "ROLLBACK;", nullptr, nullptr, nullptr);
+	}
+}
+
+} // namespace
+
+Transaction::Transaction(std::shared_ptr<Database> db, Transaction_mode mode) : _db{ std::move(db) }
 {
-	_db->execute("BEGIN TRANSACTION;");
+	_db->execute(begin_statement(mode));
 }
 
 Transaction::Transaction(Transaction&& move) noexcept
@@ -54,3 +89,67 @@ Transaction& Transaction::operator=(Transaction&& move) noexcept
 	std::swap(_db, move._db);
 	return *this;
 }
+
+Transaction_status ysqlite3::run_transaction(Database& database, Transaction_mode mode,
+                                             const std::function<void(Database&)>& function,
+                                             const Retry_options& options, Transaction_status* report)
+{
+	if (!database.is_open()) {
+		throw std::system_error{ Error::database_is_closed };
+	}
+
+	const auto start = Clock::now();
+	Transaction_status status{};
+	const auto _ = finally([&] {
+		if (report) {
+			*report         = status;
+			report->elapsed = Clock::now() - start;
+		}
+	});
+	if (!sqlite3_get_autocommit(database.handle())) {
+		database.execute("SAVEPOINT ysqlite3_run_transaction;");
+		try {
+			function(database);
+		} catch (...) {
+			if (!sqlite3_get_autocommit(database.handle())) {
+				sqlite3_exec(database.handle(),
+				             "ROLLBACK TO ysqlite3_run_transaction; RELEASE ysqlite3_run_transaction;",
+				             nullptr, nullptr, nullptr);
+			}
+			throw;
+		}
+		database.execute("RELEASE ysqlite3_run_transaction;");
+		status.elapsed = Clock::now() - start;
+		return status;
+	}
+
+	thread_local std::minstd_rand random{ std::random_device{}() };
+	std::chrono::microseconds backoff = options.initial_backoff;
+	backoff                           = std::max(backoff, std::chrono::microseconds{ 1 });
+	while (true) {
+		try {
+			database.execute(begin_statement(mode));
+			function(database);
+			database.execute("COMMIT;");
+			break;
+		} catch (const std::system_error& e) {
+			rollback(database);
+			std::uniform_int_distribution<std::chrono::microseconds::rep> jitter{ 0, backoff.count() / 2 };
+			const auto wait = backoff - std::chrono::microseconds{ jitter(random) };
+			if (!is_contention(e) || Clock::now() + wait > start + options.deadline) {
+				throw;
+			}
+
+			const auto wait_start = Clock::now();
+			std::this_thread::sleep_for(wait);
+			status.wait_time += Clock::now() - wait_start;
+			++status.retries;
+			backoff = std::min<std::chrono::microseconds>(backoff * 2, options.max_backoff);
+		} catch (...) {
+			rollback(database);
+			throw;
+		}
+	}
+	status.elapsed = Clock::now() - start;
+	return status;
+}
@@ -1,16 +1,54 @@
 #ifndef YSQLITE3_TRANSACTION_HPP_
 #define YSQLITE3_TRANSACTION_HPP_
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 
 namespace ysqlite3 {
 
 class Database;
 
+enum class Transaction_mode
+{
+	/// Takes the locks with the first read and write; upgrading to a write may fail with SQLITE_BUSY.
+	deferred,
+	/// Takes the write lock right away.
+	immediate,
+	/// Like `immediate`; outside of WAL mode readers are locked out as well.
+	exclusive
+};
+
+struct Retry_options
+{
+	/// The wait before the first retry; it doubles with every retry.
+	std::chrono::milliseconds initial_backoff{ 1 };
+	std::chrono::milliseconds max_backoff{ 100 };
+	/// No retry starts later than this after the first attempt.
+	std::chrono::milliseconds deadline{ 5000 };
+};
+
+struct Transaction_status
+{
+	std::uint32_t retries = 0;
+	/// The time spent waiting between the attempts.
+	std::chrono::nanoseconds wait_time{ 0 };
+	std::chrono::nanoseconds elapsed{ 0 };
+};
+
 class Transaction
 {
 public:
-	Transaction(std::shared_ptr<Database> db) noexcept;
+	/**
+	 * Begins a transaction on the database.
+	 *
+	 * @param db the database
+	 * @param mode how the transaction takes its locks
+	 * @exception std::system_error if the transaction could not be started, e.g. SQLITE_BUSY for
+	 * Transaction_mode::immediate or Transaction_mode::exclusive
+	 */
+	Transaction(std::shared_ptr<Database> db, Transaction_mode mode = Transaction_mode::deferred);
 	/// The moved object will be invalid after the move operation.
 	Transaction(Transaction&& move) noexcept;
 	/// Rolls the transaction back if it was not committed.
@@ -42,6 +80,33 @@ private:
 	std::shared_ptr<Database> _db;
 };
 
+/**
+ * Runs the function in a transaction and commits it. If the function or the commit fails, the transaction is
+ * rolled back. Failures with SQLITE_BUSY or SQLITE_LOCKED run the whole function again after a backoff which
+ * doubles up to `max_backoff`; every wait is randomly shortened by up to half, so competing writers spread
+ * out. The last error is thrown once the next attempt would start after the deadline.
+ *
+ * Inside of a transaction, the function runs in a savepoint which is rolled back on failure and the mode is
+ * ignored. Nested calls do not retry; the error goes to the outermost call which retries the whole
+ * transaction.
+ *
+ * @pre the function does not end the transaction
+ *
+ * @exception std::system_error
+ *   - Error::database_is_closed
+ *   - see Database::execute()
+ * @exception any exception of the function
+ * @param database the database
+ * @param mode how the transaction begins
+ * @param function the work; it may run multiple times
+ * @param options the backoff
+ * @param[out] report (opt) receives the retries and waits also if the transaction fails
+ * @return the retries and waits
+ */
+Transaction_status run_transaction(Database& database, Transaction_mode mode,
+                                   const std::function<void(Database&)>& function,
+                                   const Retry_options& options = {}, Transaction_status* report = nullptr);
+
 } // namespace ysqlite3
 
 #endif
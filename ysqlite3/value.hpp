@@ -0,0 +1,224 @@
+#ifndef YSQLITE3_VALUE_HPP_
+#define YSQLITE3_VALUE_HPP_
+
+#include "error.hpp"
+#include "span.hpp"
+#include "sqlite3.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if __cplusplus >= 201703L
+#	include <optional>
+#	include <string_view>
+#endif
+
+namespace ysqlite3 {
+
+template<std::size_t... Indices>
+struct Index_sequence
+{};
+
+template<std::size_t Size, std::size_t... Indices>
+struct Make_index_sequence : Make_index_sequence<Size - 1, Size - 1, Indices...>
+{};
+
+template<std::size_t... Indices>
+struct Make_index_sequence<0, Indices...>
+{
+	typedef Index_sequence<Indices...> type;
+};
+
+/**
+ * Converts between a C++ type and an SQLite value for the typed statement API. Every specialization has
+ *
+ * - `owning`: whether a read value remains valid after the next step
+ * - `get(statement, column)`: reads the column of the current row without checking the index
+ * - `bind(statement, parameter, value)`: binds the 1-based parameter and returns the SQLite error code
+ *
+ * Specializations exist for integers, floating points, `std::string`, `const char*`, blobs as
+ * `std::vector<std::uint8_t>` and `Span<const std::uint8_t*>` and `std::nullptr_t` for binding. With C++17
+ * there are also `std::string_view` and `std::optional`, which reads null as `std::nullopt`. Other types read
+ * null like SQLite: as 0, an empty string or `nullptr`.
+ *
+ * @tparam Type the C++ type
+ */
+template<typename Type, typename = void>
+struct Value;
+
+template<typename Type>
+struct Value<Type, typename std::enable_if<std::is_integral<Type>::value>::type>
+{
+	constexpr static bool owning = true;
+
+	static Type get(sqlite3_stmt* statement, int column) noexcept
+	{
+		return static_cast<Type>(sqlite3_column_int64(statement, column));
+	}
+	static int bind(sqlite3_stmt* statement, int parameter, Type value) noexcept
+	{
+		return sqlite3_bind_int64(statement, parameter, static_cast<sqlite3_int64>(value));
+	}
+};
+
+template<typename Type>
+struct Value<Type, typename std::enable_if<std::is_floating_point<Type>::value>::type>
+{
+	constexpr static bool owning = true;
+
+	static Type get(sqlite3_stmt* statement, int column) noexcept
+	{
+		return static_cast<Type>(sqlite3_column_double(statement, column));
+	}
+	static int bind(sqlite3_stmt* statement, int parameter, Type value) noexcept
+	{
+		return sqlite3_bind_double(statement, parameter, static_cast<double>(value));
+	}
+};
+
+template<>
+struct Value<const char*>
+{
+	constexpr static bool owning = false;
+
+	/**
+	 * Reads the text.
+	 *
+	 * @exception std::system_error SQLite3_code::memory if the value could not be converted to text
+	 * @return the text or `nullptr` if the value is null
+	 */
+	static const char* get(sqlite3_stmt* statement, int column)
+	{
+		const auto text = reinterpret_cast<const char*>(sqlite3_column_text(statement, column));
+		// the type is only checked if conversion failed or the value is null
+		if (!text && sqlite3_column_type(statement, column) != SQLITE_NULL) {
+			throw std::system_error{ SQLite3_code::memory };
+		}
+		return text;
+	}
+	/// Binds a copy of the text or null.
+	static int bind(sqlite3_stmt* statement, int parameter, const char* value) noexcept
+	{
+		return sqlite3_bind_text(statement, parameter, value, -1, SQLITE_TRANSIENT);
+	}
+};
+
+template<>
+struct Value<std::string>
+{
+	constexpr static bool owning = true;
+
+	/// @exception see Value<const char*>::get()
+	static std::string get(sqlite3_stmt* statement, int column)
+	{
+		const auto text = Value<const char*>::get(statement, column);
+		return text ? std::string(text, static_cast<std::size_t>(sqlite3_column_bytes(statement, column)))
+		            : std::string{};
+	}
+	static int bind(sqlite3_stmt* statement, int parameter, const std::string& value) noexcept
+	{
+		return sqlite3_bind_text64(statement, parameter, value.data(), value.size(), SQLITE_TRANSIENT,
+		                           SQLITE_UTF8);
+	}
+};
+
+template<>
+struct Value<Span<const std::uint8_t*>>
+{
+	constexpr static bool owning = false;
+
+	static Span<const std::uint8_t*> get(sqlite3_stmt* statement, int column) noexcept
+	{
+		const auto blob = static_cast<const std::uint8_t*>(sqlite3_column_blob(statement, column));
+		return { blob, static_cast<std::size_t>(sqlite3_column_bytes(statement, column)) };
+	}
+	static int bind(sqlite3_stmt* statement, int parameter, Span<const std::uint8_t*> value) noexcept
+	{
+		// an empty blob is not null
+		return sqlite3_bind_blob64(statement, parameter,
+		                           value.empty() ? "" : static_cast<const void*>(value.begin()), value.size(),
+		                           SQLITE_TRANSIENT);
+	}
+};
+
+template<>
+struct Value<std::vector<std::uint8_t>>
+{
+	constexpr static bool owning = true;
+
+	static std::vector<std::uint8_t> get(sqlite3_stmt* statement, int column)
+	{
+		auto blob = Value<Span<const std::uint8_t*>>::get(statement, column);
+		return { blob.begin(), blob.end() };
+	}
+	static int bind(sqlite3_stmt* statement, int parameter, const std::vector<std::uint8_t>& value) noexcept
+	{
+		return Value<Span<const std::uint8_t*>>::bind(statement, parameter, { value.data(), value.size() });
+	}
+};
+
+template<>
+struct Value<std::nullptr_t>
+{
+	static int bind(sqlite3_stmt* statement, int parameter, std::nullptr_t) noexcept
+	{
+		return sqlite3_bind_null(statement, parameter);
+	}
+};
+
+#if __cplusplus >= 201703L
+template<>
+struct Value<std::string_view>
+{
+	constexpr static bool owning = false;
+
+	/// @exception see Value<const char*>::get()
+	static std::string_view get(sqlite3_stmt* statement, int column)
+	{
+		const auto text = Value<const char*>::get(statement, column);
+		const auto size = static_cast<std::size_t>(sqlite3_column_bytes(statement, column));
+		return text ? std::string_view{ text, size } : std::string_view{};
+	}
+	static int bind(sqlite3_stmt* statement, int parameter, std::string_view value) noexcept
+	{
+		return sqlite3_bind_text64(statement, parameter, value.data(), value.size(), SQLITE_TRANSIENT,
+		                           SQLITE_UTF8);
+	}
+};
+
+template<typename Type>
+struct Value<std::optional<Type>>
+{
+	constexpr static bool owning = Value<Type>::owning;
+
+	static std::optional<Type> get(sqlite3_stmt* statement, int column)
+	{
+		if (sqlite3_column_type(statement, column) == SQLITE_NULL) {
+			return std::nullopt;
+		}
+		return Value<Type>::get(statement, column);
+	}
+	static int bind(sqlite3_stmt* statement, int parameter, const std::optional<Type>& value) noexcept
+	{
+		return value ? Value<Type>::bind(statement, parameter, *value)
+		             : sqlite3_bind_null(statement, parameter);
+	}
+};
+#endif
+
+/// Checks whether all values of the types remain valid after the next step.
+template<typename... Types>
+struct All_owning : std::true_type
+{};
+
+template<typename Type, typename... Types>
+struct All_owning<Type, Types...>
+    : std::integral_constant<bool, Value<Type>::owning && All_owning<Types...>::value>
+{};
+
+} // namespace ysqlite3
+
+#endif
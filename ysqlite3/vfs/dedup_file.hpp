@@ -0,0 +1,354 @@
+#ifndef YSQLITE3_VFS_DEDUP_FILE_HPP_
+#define YSQLITE3_VFS_DEDUP_FILE_HPP_
+
+#include "../config.hpp"
+#include "../error.hpp"
+#include "file.hpp"
+#include "page_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+#if YSQLITE3_ENCRYPTION_BACKEND_OPENSSL
+/**
+ * Stores the pages of the main database in the Page_pool given by the URI parameter `dedup_pool`, for example
+ * `file:tenant.db?layers=dedup&dedup_pool=pages.db`. The database file itself only maps every page number
+ * to the hash of its content, so databases created from the same template share all unchanged pages. A
+ * changed page is stored under its new hash (copy on write). The URI parameter `dedup_cache_size` sets the
+ * size of the page cache shared by all databases of the pool.
+ *
+ * Written pages are buffered until the next sync or unlock. The new pages are referenced in the pool before
+ * the map is written and the old pages are released only after the map was synced, so a crash can leave
+ * unused pages in the pool but never a map which references a missing page. Unused pages are removed by the
+ * garbage collector of the pool.
+ *
+ * `PRAGMA dedup_status` returns the status of the pool.
+ *
+ * @warning The page size of a database cannot be changed after it was created.
+ */
+template<typename Parent>
+class Dedup_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	template<typename... Args>
+	Dedup_file(Args&&... args) : Parent{ std::forward<Args>(args)... }
+	{
+		const auto path = sqlite3_uri_parameter(this->name, "dedup_pool");
+		if (path && this->format == File_format::main_db) {
+			_pool = Page_pool::open(path);
+			if (const auto size = sqlite3_uri_parameter(this->name, "dedup_cache_size")) {
+				_pool->set_cache_capacity(static_cast<std::size_t>(std::strtoull(size, nullptr, 0)));
+			}
+			_load_header();
+		}
+	}
+	void close() override
+	{
+		if (_pool && (!_pending.empty() || !_released.empty())) {
+			_flush();
+			Parent::sync(Sync_flag::normal);
+			_release();
+		}
+		Parent::close();
+	}
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		if (!_pool) {
+			Parent::read(buffer, offset);
+			return;
+		}
+
+		std::vector<std::uint8_t> page;
+		for (std::size_t done = 0; done < buffer.size();) {
+			const auto position = offset + static_cast<sqlite3_int64>(done);
+			const auto number   = _page_size ? static_cast<std::uint32_t>(position / _page_size + 1) : 0;
+			const auto in_page  = _page_size ? static_cast<std::size_t>(position % _page_size) : 0;
+			const auto n        = std::min(buffer.size() - done, _page_size - in_page);
+			auto output         = buffer.begin() + done;
+
+			// read full pages directly into the buffer
+			if (n != _page_size) {
+				page.resize(_page_size);
+				output = page.data();
+			}
+			if (!number || !_read_page(number, output)) {
+				std::memset(buffer.begin() + done, 0, buffer.size() - done);
+				throw std::system_error{ SQLite3_code::short_read };
+			} else if (output == page.data()) {
+				std::memcpy(buffer.begin() + done, page.data() + in_page, n);
+			}
+			done += n;
+		}
+	}
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		if (!_pool) {
+			Parent::write(buffer, offset);
+			return;
+		}
+
+		if (!_page_size) {
+			const auto size = buffer.size();
+			if (offset || size < 512 || size > 65536 || (size & (size - 1))) {
+				throw std::system_error{ SQLite3_code::write };
+			}
+			_page_size = static_cast<std::uint32_t>(size);
+		}
+
+		for (std::size_t done = 0; done < buffer.size();) {
+			const auto position = offset + static_cast<sqlite3_int64>(done);
+			const auto number   = static_cast<std::uint32_t>(position / _page_size + 1);
+			const auto in_page  = static_cast<std::size_t>(position % _page_size);
+			const auto n        = std::min(buffer.size() - done, _page_size - in_page);
+			auto& page          = _pending[number];
+			if (n != _page_size && page.data.empty()) {
+				page.data.resize(_page_size);
+				if (!_read_page(number, page.data.data())) {
+					std::fill(page.data.begin(), page.data.end(), 0);
+				}
+			}
+			page.data.resize(_page_size);
+			std::memcpy(page.data.data() + in_page, buffer.begin() + done, n);
+			page.hash = Page_pool::hash({ page.data.data(), page.data.size() });
+			done += n;
+		}
+	}
+	void truncate(sqlite3_int64 size) override
+	{
+		if (!_pool) {
+			Parent::truncate(size);
+			return;
+		}
+
+		if (!_page_size) {
+			return;
+		}
+
+		const auto pages = static_cast<std::uint32_t>((size + _page_size - 1) / _page_size);
+		_pending.erase(_pending.upper_bound(pages), _pending.end());
+
+		// the removed pages are released after the next sync
+		const auto entries = _map_entries();
+		if (entries > pages) {
+			std::vector<std::uint8_t> hashes((entries - pages) * hash_size);
+			Parent::read({ hashes.data(), hashes.size() }, _entry_offset(pages + 1));
+			for (std::size_t i = 0; i < hashes.size(); i += hash_size) {
+				_defer_release(hashes.data() + i);
+			}
+			Parent::truncate(_entry_offset(pages + 1));
+		}
+	}
+	void sync(Sync_flag flag) override
+	{
+		_flush();
+		Parent::sync(flag);
+		_release();
+	}
+	sqlite3_int64 file_size() const override
+	{
+		if (!_pool) {
+			return Parent::file_size();
+		}
+
+		auto pages = _map_entries();
+		if (!_pending.empty()) {
+			pages = std::max(pages, _pending.rbegin()->first);
+		}
+		return static_cast<sqlite3_int64>(pages) * _page_size;
+	}
+	void lock(Lock_flag flag) override
+	{
+		Parent::lock(flag);
+		// another connection may have created the database
+		if (_pool && !_page_size) {
+			_load_header();
+		}
+	}
+	void unlock(Lock_flag flag) override
+	{
+		// other connections read the map
+		_flush();
+		Parent::unlock(flag);
+	}
+	void file_control(File_control operation, void* arg) override
+	{
+		if (_pool) {
+			if (operation == File_control::size_hint || operation == File_control::chunk_size) {
+				return;
+			} else if (is_pragma(operation, arg, "dedup_status")) {
+				const auto status = _pool->status();
+				set_pragma_result(arg, sqlite3_mprintf("pages=%llu references=%llu bytes=%llu cache_hits=%llu "
+				                                       "cache_misses=%llu collected=%llu",
+				                                       static_cast<unsigned long long>(status.pages),
+				                                       static_cast<unsigned long long>(status.references),
+				                                       static_cast<unsigned long long>(status.bytes),
+				                                       static_cast<unsigned long long>(status.cache_hits),
+				                                       static_cast<unsigned long long>(status.cache_misses),
+				                                       static_cast<unsigned long long>(status.collected)));
+				return;
+			}
+		}
+		Parent::file_control(operation, arg);
+	}
+	void fetch(sqlite3_int64 offset, int amount, void** buffer) override
+	{
+		if (_pool) {
+			*buffer = nullptr;
+		} else {
+			Parent::fetch(offset, amount, buffer);
+		}
+	}
+	void unfetch(sqlite3_int64 offset, void* buffer) override
+	{
+		if (!_pool) {
+			Parent::unfetch(offset, buffer);
+		}
+	}
+	int native_handle() const noexcept override
+	{
+		return _pool ? -1 : Parent::native_handle();
+	}
+
+private:
+	struct Pending
+	{
+		Page_pool::Hash hash;
+		std::vector<std::uint8_t> data;
+	};
+
+	constexpr static std::size_t hash_size = 32;
+	/// The first entry of the map holds the magic and the page size.
+	constexpr static char magic[] = "ysqlite3 dedup 1";
+
+	std::shared_ptr<Page_pool> _pool;
+	std::uint32_t _page_size = 0;
+	/// The written pages by page number.
+	std::map<std::uint32_t, Pending> _pending;
+	/// The pages which are released after the next sync.
+	std::vector<Page_pool::Hash> _released;
+
+	static sqlite3_int64 _entry_offset(std::uint32_t page) noexcept
+	{
+		return static_cast<sqlite3_int64>(page) * hash_size;
+	}
+	std::uint32_t _map_entries() const
+	{
+		const auto size = Parent::file_size();
+		return size > static_cast<sqlite3_int64>(hash_size) ? static_cast<std::uint32_t>(size / hash_size - 1)
+		                                                     : 0;
+	}
+	void _load_header()
+	{
+		if (Parent::file_size() >= static_cast<sqlite3_int64>(hash_size)) {
+			std::uint8_t header[hash_size];
+			Parent::read({ header, sizeof(header) }, 0);
+			if (std::memcmp(header, magic, 16)) {
+				throw std::system_error{ SQLite3_code::not_a_database };
+			}
+			_page_size = static_cast<std::uint32_t>(header[16]) << 24 | static_cast<std::uint32_t>(header[17]) << 16 |
+			             static_cast<std::uint32_t>(header[18]) << 8 | header[19];
+		}
+	}
+	/// Reads a page; returns `false` if the page does not exist.
+	bool _read_page(std::uint32_t number, std::uint8_t* output)
+	{
+		const auto pending = _pending.find(number);
+		if (pending != _pending.end()) {
+			std::memcpy(output, pending->second.data.data(), _page_size);
+			return true;
+		} else if (number > _map_entries()) {
+			return false;
+		}
+
+		Page_pool::Hash hash;
+		Parent::read({ hash.data(), hash.size() }, _entry_offset(number));
+		if (std::all_of(hash.begin(), hash.end(), [](std::uint8_t x) { return !x; })) {
+			// a gap in the map
+			std::memset(output, 0, _page_size);
+		} else if (!_pool->read(hash, { output, _page_size })) {
+			throw std::system_error{ SQLite3_code::corrupt, "page missing in pool" };
+		}
+		return true;
+	}
+	void _defer_release(const std::uint8_t* hash)
+	{
+		if (std::any_of(hash, hash + hash_size, [](std::uint8_t x) { return x; })) {
+			_released.emplace_back();
+			std::memcpy(_released.back().data(), hash, hash_size);
+		}
+	}
+	/// Stores the pending pages in the pool and writes their hashes to the map.
+	void _flush()
+	{
+		if (_pending.empty()) {
+			return;
+		}
+
+		std::vector<Page_pool::Page> pages;
+		pages.reserve(_pending.size());
+		for (const auto& i : _pending) {
+			pages.push_back({ i.second.hash, { i.second.data.data(), i.second.data.size() } });
+		}
+		_pool->acquire(pages);
+
+		if (Parent::file_size() < static_cast<sqlite3_int64>(hash_size)) {
+			std::uint8_t header[hash_size]{};
+			std::memcpy(header, magic, 16);
+			for (int i = 0; i < 4; ++i) {
+				header[16 + i] = static_cast<std::uint8_t>(_page_size >> (24 - i * 8));
+			}
+			Parent::write({ header, sizeof(header) }, 0);
+		}
+
+		// write runs of consecutive pages at once
+		const auto entries = _map_entries();
+		std::vector<std::uint8_t> run;
+		for (auto i = _pending.begin(); i != _pending.end();) {
+			const auto first = i->first;
+			auto last        = first;
+			run.clear();
+			for (; i != _pending.end() && i->first == last; ++i, ++last) {
+				run.insert(run.end(), i->second.hash.begin(), i->second.hash.end());
+			}
+
+			// the replaced pages
+			if (first <= entries) {
+				std::vector<std::uint8_t> old((std::min(last - 1, entries) - first + 1) * hash_size);
+				Parent::read({ old.data(), old.size() }, _entry_offset(first));
+				for (std::size_t j = 0; j < old.size(); j += hash_size) {
+					_defer_release(old.data() + j);
+				}
+			}
+			Parent::write({ run.data(), run.size() }, _entry_offset(first));
+		}
+		_pending.clear();
+	}
+	void _release()
+	{
+		if (!_released.empty()) {
+			_pool->release(_released);
+			_released.clear();
+		}
+	}
+};
+
+template<typename Parent>
+constexpr char Dedup_file<Parent>::magic[];
+#endif
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
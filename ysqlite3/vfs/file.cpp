@@ -184,3 +184,8 @@ int File::sector_size() const noexcept
 {
 	return 4096;
 }
+
+int File::native_handle() const noexcept
+{
+	return -1;
+}
@@ -89,6 +89,31 @@ inline const char* name_of(File_format format) noexcept
 	}
 }
 
+/**
+ * Checks whether a file control operation is the pragma with the given name.
+ *
+ * @param operation the file control operation
+ * @param arg the file control argument
+ * @param name the case-insensitive pragma name
+ * @return `true` if it is the pragma, otherwise `false`
+ */
+inline bool is_pragma(File_control operation, void* arg, const char* name) noexcept
+{
+	return operation == File_control::pragma && !sqlite3_stricmp(static_cast<char**>(arg)[1], name);
+}
+
+/// Returns the value of a pragma file control or `nullptr` if no value was given.
+inline const char* pragma_value(void* arg) noexcept
+{
+	return static_cast<char**>(arg)[2];
+}
+
+/// Sets the result of a pragma file control. The result must be allocated with sqlite3_mprintf().
+inline void set_pragma_result(void* arg, char* result) noexcept
+{
+	static_cast<char**>(arg)[0] = result;
+}
+
 class File
 {
 public:
@@ -115,6 +140,11 @@ public:
 	virtual void shm_unmap(int delete_flag)                                                     = 0;
 	virtual void fetch(sqlite3_int64 offset, int amount, void** buffer)                         = 0;
 	virtual void unfetch(sqlite3_int64 offset, void* buffer)                                    = 0;
+	/**
+	 * Returns the file descriptor which holds exactly the bytes of this file. The default implementation
+	 * returns -1; layers which change the bytes must return -1 as well.
+	 */
+	virtual int native_handle() const noexcept;
 
 protected:
 	const char* const name;
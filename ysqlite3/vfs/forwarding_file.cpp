@@ -0,0 +1,112 @@
+#include "forwarding_file.hpp"
+
+using namespace ysqlite3::vfs;
+
+Forwarding_file::Forwarding_file(const char* name, File_format format, File* next) noexcept
+    : File{ name, format }, _next{ next }
+{}
+
+void Forwarding_file::close()
+{
+	_next->close();
+}
+
+void Forwarding_file::read(Span<std::uint8_t*> buffer, sqlite3_int64 offset)
+{
+	_next->read(buffer, offset);
+}
+
+void Forwarding_file::write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset)
+{
+	_next->write(buffer, offset);
+}
+
+void Forwarding_file::truncate(sqlite3_int64 size)
+{
+	_next->truncate(size);
+}
+
+void Forwarding_file::sync(Sync_flag flag)
+{
+	_next->sync(flag);
+}
+
+sqlite3_int64 Forwarding_file::file_size() const
+{
+	return _next->file_size();
+}
+
+void Forwarding_file::lock(Lock_flag flag)
+{
+	_next->lock(flag);
+}
+
+void Forwarding_file::unlock(Lock_flag flag)
+{
+	_next->unlock(flag);
+}
+
+bool Forwarding_file::has_reserved_lock() const
+{
+	return _next->has_reserved_lock();
+}
+
+void Forwarding_file::file_control(File_control operation, void* arg)
+{
+	_next->file_control(operation, arg);
+}
+
+int Forwarding_file::sector_size() const noexcept
+{
+	return _next->sector_size();
+}
+
+int Forwarding_file::device_characteristics() const noexcept
+{
+	return _next->device_characteristics();
+}
+
+void Forwarding_file::shm_map(int page, int page_size, bool is_write, void volatile** mapped_memory)
+{
+	_next->shm_map(page, page_size, is_write, mapped_memory);
+}
+
+void Forwarding_file::shm_lock(int offset, int n, int flags)
+{
+	_next->shm_lock(offset, n, flags);
+}
+
+void Forwarding_file::shm_barrier() noexcept
+{
+	_next->shm_barrier();
+}
+
+void Forwarding_file::shm_unmap(int delete_flag)
+{
+	_next->shm_unmap(delete_flag);
+}
+
+void Forwarding_file::fetch(sqlite3_int64 offset, int amount, void** buffer)
+{
+	_next->fetch(offset, amount, buffer);
+}
+
+void Forwarding_file::unfetch(sqlite3_int64 offset, void* buffer)
+{
+	_next->unfetch(offset, buffer);
+}
+
+int Forwarding_file::native_handle() const noexcept
+{
+	return _next->native_handle();
+}
+
+File* Forwarding_file::next() const noexcept
+{
+	return _next;
+}
+
+void Forwarding_file::set_next(File* next) noexcept
+{
+	_next = next;
+}
@@ -0,0 +1,52 @@
+#ifndef YSQLITE3_VFS_FORWARDING_FILE_HPP_
+#define YSQLITE3_VFS_FORWARDING_FILE_HPP_
+
+#include "../sqlite3.h"
+#include "file.hpp"
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Forwards every call to the next file in a runtime built chain. This is the runtime counterpart of
+ * SQLite3_file_wrapper and can be used as `Parent` for layers like Crypt_file.
+ *
+ * @note The next file is not owned.
+ */
+class Forwarding_file : public File
+{
+public:
+	Forwarding_file(const char* name, File_format format, File* next) noexcept;
+	void close() override;
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override;
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override;
+	void truncate(sqlite3_int64 size) override;
+	void sync(Sync_flag flag) override;
+	sqlite3_int64 file_size() const override;
+	void lock(Lock_flag flag) override;
+	void unlock(Lock_flag flag) override;
+	bool has_reserved_lock() const override;
+	void file_control(File_control operation, void* arg) override;
+	int sector_size() const noexcept override;
+	int device_characteristics() const noexcept override;
+	void shm_map(int page, int page_size, bool is_write, void volatile** mapped_memory) override;
+	void shm_lock(int offset, int n, int flags) override;
+	void shm_barrier() noexcept override;
+	void shm_unmap(int delete_flag) override;
+	void fetch(sqlite3_int64 offset, int amount, void** buffer) override;
+	void unfetch(sqlite3_int64 offset, void* buffer) override;
+	int native_handle() const noexcept override;
+	/// Returns the next file in the chain.
+	File* next() const noexcept;
+
+protected:
+	void set_next(File* next) noexcept;
+
+private:
+	File* _next;
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
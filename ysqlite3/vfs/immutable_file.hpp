@@ -0,0 +1,224 @@
+#ifndef YSQLITE3_VFS_IMMUTABLE_FILE_HPP_
+#define YSQLITE3_VFS_IMMUTABLE_FILE_HPP_
+
+#include "../error.hpp"
+#include "file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <sys/mman.h>
+#endif
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Serves a main database which never changes from memory. On the first read the whole file is mapped; if
+ * the parent does not have a native handle with the verbatim content, for example because it is encrypted,
+ * the decoded pages are read once into anonymous memory instead. The mapping is populated immediately and
+ * huge pages are requested where available.
+ *
+ * The file reports `SQLITE_IOCAP_IMMUTABLE`, so SQLite neither locks it nor checks it for changes. Locks
+ * are no-ops, fetch() returns pointers into the mapping and all writes fail with SQLite3_code::read_only.
+ * Use `PRAGMA mmap_size` to let SQLite fetch pages instead of copying them.
+ *
+ * @note Page transforming layers like Crypt_file must be stacked below this layer.
+ */
+template<typename Parent>
+class Immutable_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	using Parent::Parent;
+
+	~Immutable_file()
+	{
+		_unmap();
+	}
+	void close() override
+	{
+		_unmap();
+		Parent::close();
+	}
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		if (this->format != File_format::main_db) {
+			Parent::read(buffer, offset);
+			return;
+		}
+
+		_load();
+		const auto available = static_cast<std::size_t>(std::max<sqlite3_int64>(
+		    std::min<sqlite3_int64>(_size - offset, static_cast<sqlite3_int64>(buffer.size())), 0));
+		std::memcpy(buffer.begin(), _data + offset, available);
+		if (available < buffer.size()) {
+			std::memset(buffer.begin() + available, 0, buffer.size() - available);
+			throw std::system_error{ SQLite3_code::short_read };
+		}
+	}
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		if (this->format == File_format::main_db) {
+			throw std::system_error{ SQLite3_code::read_only };
+		}
+		Parent::write(buffer, offset);
+	}
+	void truncate(sqlite3_int64 size) override
+	{
+		if (this->format == File_format::main_db) {
+			throw std::system_error{ SQLite3_code::read_only };
+		}
+		Parent::truncate(size);
+	}
+	sqlite3_int64 file_size() const override
+	{
+		return this->format == File_format::main_db && _loaded ? _size : Parent::file_size();
+	}
+	void lock(Lock_flag flag) override
+	{
+		if (this->format != File_format::main_db) {
+			Parent::lock(flag);
+		}
+	}
+	void unlock(Lock_flag flag) override
+	{
+		if (this->format != File_format::main_db) {
+			Parent::unlock(flag);
+		}
+	}
+	bool has_reserved_lock() const override
+	{
+		return this->format == File_format::main_db ? false : Parent::has_reserved_lock();
+	}
+	int device_characteristics() const noexcept override
+	{
+		return Parent::device_characteristics() |
+		       (this->format == File_format::main_db ? SQLITE_IOCAP_IMMUTABLE : 0);
+	}
+	void fetch(sqlite3_int64 offset, int amount, void** buffer) override
+	{
+		if (this->format != File_format::main_db) {
+			Parent::fetch(offset, amount, buffer);
+			return;
+		}
+
+		_load();
+		*buffer = offset + amount <= _size ? _data + offset : nullptr;
+	}
+	void unfetch(sqlite3_int64 offset, void* buffer) override
+	{
+		if (this->format != File_format::main_db) {
+			Parent::unfetch(offset, buffer);
+		}
+	}
+
+private:
+	bool _loaded        = false;
+	bool _mapped        = false;
+	std::uint8_t* _data = nullptr;
+	sqlite3_int64 _size = 0;
+	/// Used if the system cannot map memory.
+	std::vector<std::uint8_t> _copy;
+
+	void _load()
+	{
+		if (_loaded) {
+			return;
+		}
+
+		_size = Parent::file_size();
+		if (!_size) {
+			_loaded = true;
+			return;
+		}
+
+		const auto size = static_cast<std::size_t>(_size);
+#if defined(__unix__) || defined(__APPLE__)
+		int flags = MAP_SHARED;
+#	if defined(MAP_POPULATE)
+		flags |= MAP_POPULATE;
+#	endif
+		const auto fd = Parent::native_handle();
+		void* data    = MAP_FAILED;
+		if (fd != -1) {
+			data = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+		}
+		if (data == MAP_FAILED) {
+			data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (data == MAP_FAILED) {
+				throw std::system_error{ SQLite3_code::nomem };
+			}
+			_data   = static_cast<std::uint8_t*>(data);
+			_mapped = true;
+			_advise();
+			try {
+				_read_pages();
+			} catch (...) {
+				_unmap();
+				throw;
+			}
+			mprotect(data, size, PROT_READ);
+		} else {
+			_data   = static_cast<std::uint8_t*>(data);
+			_mapped = true;
+			_advise();
+		}
+#else
+		_copy.resize(size);
+		_data = _copy.data();
+		_read_pages();
+#endif
+		_loaded = true;
+	}
+	void _advise() noexcept
+	{
+#if defined(MADV_HUGEPAGE)
+		madvise(_data, static_cast<std::size_t>(_size), MADV_HUGEPAGE);
+#endif
+#if defined(MADV_WILLNEED)
+		madvise(_data, static_cast<std::size_t>(_size), MADV_WILLNEED);
+#endif
+	}
+	/// Reads the content page by page, so page transforming parents can decode them.
+	void _read_pages()
+	{
+		// the header is never transformed
+		const auto header = std::min<sqlite3_int64>(_size, 100);
+		Parent::read({ _data, static_cast<std::size_t>(header) }, 0);
+		std::uint32_t page_size = header >= 18 ? _data[16] << 8 | _data[17] : 0;
+		if (page_size == 1) {
+			page_size = 65536;
+		}
+		if (page_size < 512 || _size % page_size) {
+			throw std::system_error{ SQLite3_code::not_a_database };
+		}
+
+		for (sqlite3_int64 offset = 0; offset < _size; offset += page_size) {
+			Parent::read({ _data + offset, page_size }, offset);
+		}
+	}
+	void _unmap() noexcept
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		if (_mapped) {
+			munmap(_data, static_cast<std::size_t>(_size));
+		}
+#endif
+		_copy.clear();
+		_data   = nullptr;
+		_mapped = false;
+		_loaded = false;
+	}
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
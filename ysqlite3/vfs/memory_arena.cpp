@@ -0,0 +1,53 @@
+#include "memory_arena.hpp"
+
+#include <algorithm>
+
+using namespace ysqlite3::vfs;
+
+Memory_arena::Memory_arena(std::size_t budget, std::size_t chunk_size)
+    : _budget{ budget }, _chunk_size{ std::max<std::size_t>(chunk_size, 1) }
+{}
+
+std::uint8_t* Memory_arena::allocate()
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	if (_status.used + _chunk_size > _budget) {
+		return nullptr;
+	}
+
+	if (_free.empty()) {
+		_chunks.emplace_back(new std::uint8_t[_chunk_size]);
+		// deallocate() must not throw
+		_free.reserve(_chunks.size());
+		_free.push_back(_chunks.back().get());
+	}
+	const auto chunk = _free.back();
+	_free.pop_back();
+	_status.used += _chunk_size;
+	_status.peak = std::max(_status.peak, _status.used);
+	return chunk;
+}
+
+void Memory_arena::deallocate(std::uint8_t* chunk) noexcept
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	_free.push_back(chunk);
+	_status.used -= _chunk_size;
+}
+
+void Memory_arena::record_spill() noexcept
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	++_status.spills;
+}
+
+std::size_t Memory_arena::chunk_size() const noexcept
+{
+	return _chunk_size;
+}
+
+Memory_arena_status Memory_arena::status() const
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	return _status;
+}
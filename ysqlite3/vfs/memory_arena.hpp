@@ -0,0 +1,56 @@
+#ifndef YSQLITE3_VFS_MEMORY_ARENA_HPP_
+#define YSQLITE3_VFS_MEMORY_ARENA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+struct Memory_arena_status
+{
+	/// The bytes of the chunks in use.
+	std::size_t used = 0;
+	/// The highest value of `used`.
+	std::size_t peak = 0;
+	/// The files which did not fit into the budget.
+	std::uint64_t spills = 0;
+};
+
+/**
+ * Hands out fixed-size chunks up to a budget. Returned chunks are kept for reuse, so repeated sorts do not
+ * allocate again. All methods are thread-safe.
+ */
+class Memory_arena
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param budget the maximum bytes handed out at once
+	 * @param chunk_size the size of every chunk
+	 */
+	Memory_arena(std::size_t budget, std::size_t chunk_size = 64 * 1024);
+	/// Returns a chunk or `nullptr` if the budget is exhausted.
+	std::uint8_t* allocate();
+	void deallocate(std::uint8_t* chunk) noexcept;
+	void record_spill() noexcept;
+	std::size_t chunk_size() const noexcept;
+	Memory_arena_status status() const;
+
+private:
+	const std::size_t _budget;
+	const std::size_t _chunk_size;
+	mutable std::mutex _mutex;
+	std::vector<std::unique_ptr<std::uint8_t[]>> _chunks;
+	std::vector<std::uint8_t*> _free;
+	Memory_arena_status _status;
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
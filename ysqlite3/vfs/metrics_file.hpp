@@ -0,0 +1,137 @@
+#ifndef YSQLITE3_VFS_METRICS_FILE_HPP_
+#define YSQLITE3_VFS_METRICS_FILE_HPP_
+
+#include "file.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+
+namespace ysqlite3 {
+namespace vfs {
+
+struct File_metrics
+{
+	std::uint64_t reads         = 0;
+	std::uint64_t read_bytes    = 0;
+	std::uint64_t writes        = 0;
+	std::uint64_t written_bytes = 0;
+	std::uint64_t syncs         = 0;
+	std::chrono::microseconds read_time{};
+	std::chrono::microseconds write_time{};
+	std::chrono::microseconds sync_time{};
+};
+
+/**
+ * Counts the I/O operations of the file and the time spent in the underlying layers. The counters can be
+ * queried with `PRAGMA metrics` (main database only) and reset with `PRAGMA metrics=reset`.
+ */
+template<typename Parent>
+class Metrics_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	using Parent::Parent;
+
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		const auto start = Clock::now();
+		Parent::read(buffer, offset);
+		_add(_read_time, start);
+		_reads.fetch_add(1, std::memory_order_relaxed);
+		_read_bytes.fetch_add(buffer.size(), std::memory_order_relaxed);
+	}
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		const auto start = Clock::now();
+		Parent::write(buffer, offset);
+		_add(_write_time, start);
+		_writes.fetch_add(1, std::memory_order_relaxed);
+		_written_bytes.fetch_add(buffer.size(), std::memory_order_relaxed);
+	}
+	void sync(Sync_flag flag) override
+	{
+		const auto start = Clock::now();
+		Parent::sync(flag);
+		_add(_sync_time, start);
+		_syncs.fetch_add(1, std::memory_order_relaxed);
+	}
+	void file_control(File_control operation, void* arg) override
+	{
+		if (is_pragma(operation, arg, "metrics")) {
+			const auto value = pragma_value(arg);
+			if (value && !sqlite3_stricmp(value, "reset")) {
+				reset_metrics();
+				set_pragma_result(arg, sqlite3_mprintf("ok"));
+				return;
+			}
+
+			const auto m = metrics();
+			set_pragma_result(
+			    arg, sqlite3_mprintf("reads=%llu read_bytes=%llu read_us=%lld writes=%llu written_bytes=%llu "
+			                         "write_us=%lld syncs=%llu sync_us=%lld",
+			                         static_cast<unsigned long long>(m.reads),
+			                         static_cast<unsigned long long>(m.read_bytes),
+			                         static_cast<long long>(m.read_time.count()),
+			                         static_cast<unsigned long long>(m.writes),
+			                         static_cast<unsigned long long>(m.written_bytes),
+			                         static_cast<long long>(m.write_time.count()),
+			                         static_cast<unsigned long long>(m.syncs),
+			                         static_cast<long long>(m.sync_time.count())));
+			return;
+		}
+		Parent::file_control(operation, arg);
+	}
+	/// Returns a snapshot of the counters.
+	File_metrics metrics() const noexcept
+	{
+		File_metrics m;
+		m.reads         = _reads.load(std::memory_order_relaxed);
+		m.read_bytes    = _read_bytes.load(std::memory_order_relaxed);
+		m.writes        = _writes.load(std::memory_order_relaxed);
+		m.written_bytes = _written_bytes.load(std::memory_order_relaxed);
+		m.syncs         = _syncs.load(std::memory_order_relaxed);
+		m.read_time     = _microseconds(_read_time);
+		m.write_time    = _microseconds(_write_time);
+		m.sync_time     = _microseconds(_sync_time);
+		return m;
+	}
+	void reset_metrics() noexcept
+	{
+		for (auto counter : { &_reads, &_read_bytes, &_writes, &_written_bytes, &_syncs }) {
+			counter->store(0, std::memory_order_relaxed);
+		}
+		for (auto time : { &_read_time, &_write_time, &_sync_time }) {
+			time->store(0, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	std::atomic<std::uint64_t> _reads{ 0 };
+	std::atomic<std::uint64_t> _read_bytes{ 0 };
+	std::atomic<std::uint64_t> _writes{ 0 };
+	std::atomic<std::uint64_t> _written_bytes{ 0 };
+	std::atomic<std::uint64_t> _syncs{ 0 };
+	std::atomic<Clock::rep> _read_time{ 0 };
+	std::atomic<Clock::rep> _write_time{ 0 };
+	std::atomic<Clock::rep> _sync_time{ 0 };
+
+	static void _add(std::atomic<Clock::rep>& time, Clock::time_point start) noexcept
+	{
+		time.fetch_add((Clock::now() - start).count(), std::memory_order_relaxed);
+	}
+	static std::chrono::microseconds _microseconds(const std::atomic<Clock::rep>& time) noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+		    Clock::duration{ time.load(std::memory_order_relaxed) });
+	}
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,232 @@
+#include "page_pool.hpp"
+
+#if YSQLITE3_ENCRYPTION_BACKEND_OPENSSL
+#	include "../error.hpp"
+#	include "../finally.hpp"
+
+#	include <chrono>
+#	include <map>
+#	include <openssl/evp.h>
+#	include <string>
+
+using namespace ysqlite3;
+using namespace ysqlite3::vfs;
+
+namespace {
+
+std::mutex registry_mutex;
+std::map<std::string, std::weak_ptr<Page_pool>> registry;
+
+/// Gives writers of other databases time to release more pages before collecting.
+constexpr auto collector_delay = std::chrono::seconds{ 1 };
+
+} // namespace
+
+Page_pool::Page_pool(const char* path)
+{
+	_database.open(path);
+	_database.execute("PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL; PRAGMA busy_timeout=10000;"
+	                  "CREATE TABLE IF NOT EXISTS pages(id INTEGER PRIMARY KEY, hash BLOB NOT NULL UNIQUE, "
+	                  "refs INTEGER NOT NULL, data BLOB NOT NULL);");
+	_select  = _database.prepare_statement("SELECT data FROM pages WHERE hash=?");
+	_acquire = _database.prepare_statement(
+	    "INSERT INTO pages(hash, refs, data) VALUES(?, 1, ?) ON CONFLICT(hash) DO UPDATE SET refs=refs+1");
+	_release = _database.prepare_statement("UPDATE pages SET refs=refs-1 WHERE hash=?");
+	_collect = _database.prepare_statement("DELETE FROM pages WHERE refs<=0");
+}
+
+std::shared_ptr<Page_pool> Page_pool::open(const char* path)
+{
+	std::lock_guard<std::mutex> lock{ registry_mutex };
+	auto& entry = registry[path];
+	auto pool   = entry.lock();
+	if (!pool) {
+		pool.reset(new Page_pool{ path });
+		entry = pool;
+	}
+	return pool;
+}
+
+Page_pool::Hash Page_pool::hash(Span<const std::uint8_t*> page) noexcept
+{
+	Hash hash{};
+	unsigned int size = 0;
+	EVP_Digest(page.begin(), page.size(), hash.data(), &size, EVP_sha256(), nullptr);
+	return hash;
+}
+
+Page_pool::~Page_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ _collector_mutex };
+		_stop = true;
+	}
+	_collector_condition.notify_all();
+	if (_collector.joinable()) {
+		_collector.join();
+	}
+}
+
+bool Page_pool::read(const Hash& hash, Span<std::uint8_t*> page)
+{
+	{
+		std::lock_guard<std::mutex> lock{ _cache_mutex };
+		const auto entry = _cache.find(hash);
+		if (entry != _cache.end() && entry->second->second.size() == page.size()) {
+			_lru.splice(_lru.begin(), _lru, entry->second);
+			std::memcpy(page.begin(), entry->second->second.data(), page.size());
+			++_cache_hits;
+			return true;
+		}
+		++_cache_misses;
+	}
+
+	std::lock_guard<std::mutex> lock{ _database_mutex };
+	const auto _ = finally([this] { _select.reset(); });
+	_select.bind_reference(0, { hash.data(), hash.size() });
+	auto result = _select.step();
+	if (!result) {
+		return false;
+	}
+
+	auto data = result.blob(0);
+	if (data.size() != page.size()) {
+		throw std::system_error{ SQLite3_code::corrupt, "page size does not match" };
+	}
+	std::memcpy(page.begin(), data.begin(), page.size());
+	_cache_insert(hash, data);
+	return true;
+}
+
+void Page_pool::acquire(const std::vector<Page>& pages)
+{
+	std::lock_guard<std::mutex> lock{ _database_mutex };
+	_database.execute("BEGIN IMMEDIATE");
+	auto committed = false;
+	const auto _   = finally([&] {
+		if (!committed) {
+			sqlite3_exec(_database.handle(), "ROLLBACK", nullptr, nullptr, nullptr);
+		}
+	});
+
+	for (const auto& page : pages) {
+		_acquire.bind_reference(0, { page.hash.data(), page.hash.size() });
+		_acquire.bind_reference(1, page.data);
+		_acquire.finish();
+	}
+	_database.execute("COMMIT");
+	committed = true;
+}
+
+void Page_pool::release(const std::vector<Hash>& hashes)
+{
+	if (hashes.empty()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ _database_mutex };
+		_database.execute("BEGIN IMMEDIATE");
+		auto committed = false;
+		const auto _   = finally([&] {
+			if (!committed) {
+				sqlite3_exec(_database.handle(), "ROLLBACK", nullptr, nullptr, nullptr);
+			}
+		});
+
+		for (const auto& hash : hashes) {
+			_release.bind_reference(0, { hash.data(), hash.size() });
+			_release.finish();
+		}
+		_database.execute("COMMIT");
+		committed = true;
+	}
+
+	std::lock_guard<std::mutex> lock{ _collector_mutex };
+	_garbage = true;
+	if (!_collector.joinable()) {
+		_collector = std::thread{ &Page_pool::_run_collector, this };
+	} else {
+		_collector_condition.notify_one();
+	}
+}
+
+std::size_t Page_pool::collect()
+{
+	std::lock_guard<std::mutex> lock{ _database_mutex };
+	_collect.finish();
+	const auto count = static_cast<std::size_t>(sqlite3_changes(_database.handle()));
+	_collected += count;
+	return count;
+}
+
+void Page_pool::set_cache_capacity(std::size_t capacity)
+{
+	std::lock_guard<std::mutex> lock{ _cache_mutex };
+	_cache_capacity = capacity;
+	_evict();
+}
+
+Page_pool_status Page_pool::status()
+{
+	Page_pool_status status;
+	{
+		std::lock_guard<std::mutex> lock{ _cache_mutex };
+		status.cache_hits   = _cache_hits;
+		status.cache_misses = _cache_misses;
+	}
+
+	std::lock_guard<std::mutex> lock{ _database_mutex };
+	auto statement =
+	    _database.prepare_statement("SELECT count(*), total(refs), total(length(data)) FROM pages WHERE refs>0");
+	auto result       = statement.step();
+	status.pages      = static_cast<std::uint64_t>(result.integer(0));
+	status.references = static_cast<std::uint64_t>(result.real(1));
+	status.bytes      = static_cast<std::uint64_t>(result.real(2));
+	status.collected  = _collected;
+	return status;
+}
+
+void Page_pool::_cache_insert(const Hash& hash, Span<const std::uint8_t*> page)
+{
+	std::lock_guard<std::mutex> lock{ _cache_mutex };
+	if (page.size() > _cache_capacity || _cache.count(hash)) {
+		return;
+	}
+
+	_lru.emplace_front(hash, std::vector<std::uint8_t>{ page.begin(), page.end() });
+	_cache.emplace(hash, _lru.begin());
+	_cache_size += page.size();
+	_evict();
+}
+
+void Page_pool::_evict() noexcept
+{
+	while (_cache_size > _cache_capacity) {
+		_cache_size -= _lru.back().second.size();
+		_cache.erase(_lru.back().first);
+		_lru.pop_back();
+	}
+}
+
+void Page_pool::_run_collector() noexcept
+{
+	std::unique_lock<std::mutex> lock{ _collector_mutex };
+	while (true) {
+		_collector_condition.wait(lock, [this] { return _garbage || _stop; });
+		if (_stop || _collector_condition.wait_for(lock, collector_delay, [this] { return _stop; })) {
+			return;
+		}
+
+		_garbage = false;
+		lock.unlock();
+		try {
+			collect();
+		} catch (const std::system_error&) {
+			// retried with the next release
+		}
+		lock.lock();
+	}
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef YSQLITE3_VFS_PAGE_POOL_HPP_
+#define YSQLITE3_VFS_PAGE_POOL_HPP_
+
+#include "../config.hpp"
+#include "../database.hpp"
+#include "../span.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+#if YSQLITE3_ENCRYPTION_BACKEND_OPENSSL
+struct Page_pool_status
+{
+	/// The distinct pages in the pool.
+	std::uint64_t pages = 0;
+	/// The references of all databases to the pages.
+	std::uint64_t references   = 0;
+	std::uint64_t bytes        = 0;
+	std::uint64_t cache_hits   = 0;
+	std::uint64_t cache_misses = 0;
+	/// The pages removed by the garbage collector of this process.
+	std::uint64_t collected = 0;
+};
+
+/**
+ * A content-addressed store of pages shared by many databases. Every page is stored once together with the
+ * number of references to it; pages without references are removed by a background thread. The pool itself
+ * is a SQLite database and may be shared by multiple processes.
+ *
+ * Recently read pages are kept in a cache which is shared by all users of the pool in this process, so pages
+ * that many databases have in common are cached only once. All methods are thread-safe.
+ */
+class Page_pool
+{
+public:
+	typedef std::array<std::uint8_t, 32> Hash;
+
+	struct Page
+	{
+		Hash hash;
+		Span<const std::uint8_t*> data;
+	};
+
+	/**
+	 * Returns the pool stored at `path`. Pools with the same path are shared within the process.
+	 *
+	 * @exception std::system_error if the pool could not be opened
+	 * @param path the path of the pool database
+	 * @return the pool
+	 */
+	static std::shared_ptr<Page_pool> open(const char* path);
+	/// Returns the SHA-256 hash of the page.
+	static Hash hash(Span<const std::uint8_t*> page) noexcept;
+	~Page_pool();
+	/**
+	 * Reads a page.
+	 *
+	 * @exception std::system_error if the pool could not be read
+	 * @param hash the hash of the page
+	 * @param[out] page receives the content; must have the size of the stored page
+	 * @return `false` if the page is not in the pool
+	 */
+	bool read(const Hash& hash, Span<std::uint8_t*> page);
+	/**
+	 * Adds a reference to every page in one transaction. Unknown pages are stored.
+	 *
+	 * @exception std::system_error if the pool could not be written; no reference was added
+	 * @param pages the pages
+	 */
+	void acquire(const std::vector<Page>& pages);
+	/**
+	 * Removes a reference from every page. The pages are removed later by the garbage collector.
+	 *
+	 * @exception std::system_error if the pool could not be written
+	 * @param hashes the hashes of the pages
+	 */
+	void release(const std::vector<Hash>& hashes);
+	/**
+	 * Removes all pages without references.
+	 *
+	 * @exception std::system_error if the pool could not be written
+	 * @return the number of removed pages
+	 */
+	std::size_t collect();
+	/// Sets the size of the shared page cache in bytes.
+	void set_cache_capacity(std::size_t capacity);
+	/**
+	 * Returns the status of the pool.
+	 *
+	 * @exception std::system_error if the pool could not be read
+	 */
+	Page_pool_status status();
+
+private:
+	struct Hash_hasher
+	{
+		std::size_t operator()(const Hash& hash) const noexcept
+		{
+			std::size_t value;
+			std::memcpy(&value, hash.data(), sizeof(value));
+			return value;
+		}
+	};
+	typedef std::list<std::pair<Hash, std::vector<std::uint8_t>>> Lru;
+
+	std::mutex _database_mutex;
+	Database _database;
+	Statement _select{ nullptr, nullptr };
+	Statement _acquire{ nullptr, nullptr };
+	Statement _release{ nullptr, nullptr };
+	Statement _collect{ nullptr, nullptr };
+
+	std::mutex _cache_mutex;
+	std::size_t _cache_capacity = 8 * 1024 * 1024;
+	std::size_t _cache_size     = 0;
+	Lru _lru;
+	std::unordered_map<Hash, Lru::iterator, Hash_hasher> _cache;
+	std::uint64_t _cache_hits   = 0;
+	std::uint64_t _cache_misses = 0;
+	std::uint64_t _collected    = 0;
+
+	std::mutex _collector_mutex;
+	std::condition_variable _collector_condition;
+	std::thread _collector;
+	bool _garbage = false;
+	bool _stop    = false;
+
+	Page_pool(const char* path);
+	void _cache_insert(const Hash& hash, Span<const std::uint8_t*> page);
+	void _evict() noexcept;
+	void _run_collector() noexcept;
+};
+#endif
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
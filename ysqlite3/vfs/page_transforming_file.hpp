@@ -69,6 +69,11 @@ public:
 			Parent::write(buffer, offset);
 		}
 	}
+	/// The pages on disk are encoded.
+	int native_handle() const noexcept override
+	{
+		return -1;
+	}
 
 protected:
 	virtual void encode_page(Span<std::uint8_t*> page) = 0;
@@ -0,0 +1,205 @@
+#include "pipeline_vfs.hpp"
+
+#include "../config.hpp"
+#include "../error.hpp"
+#include "crypt_file.hpp"
+#include "dedup_file.hpp"
+#include "immutable_file.hpp"
+#include "metrics_file.hpp"
+#include "process_shm_file.hpp"
+#include "readahead_file.hpp"
+#include "scrubbed_file.hpp"
+#include "spilling_file.hpp"
+#include "throttled_file.hpp"
+#include "wal_shipping_file.hpp"
+#include "working_set_file.hpp"
+#include "write_behind_file.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+using namespace ysqlite3;
+using namespace ysqlite3::vfs;
+
+namespace {
+
+inline void assert_error(int ec)
+{
+	if (ec) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec) };
+	}
+}
+
+constexpr std::size_t align(std::size_t offset, std::size_t alignment) noexcept
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * The outermost file of a pipeline. It lives at the start of the one memory block which also holds the
+ * parent `sqlite3_file`, the SQLite3_file_wrapper and all layers.
+ */
+class Pipeline_file : public Forwarding_file
+{
+public:
+	Pipeline_file(const char* name, File_format format) noexcept : Forwarding_file{ name, format, nullptr }
+	{}
+	~Pipeline_file()
+	{
+		for (auto i = _count; i--;) {
+			_files[i]->~File();
+		}
+	}
+	/// The memory block was allocated with `::operator new` and this object is at its start.
+	static void operator delete(void* ptr) noexcept
+	{
+		::operator delete(ptr);
+	}
+	void push(File* file) noexcept
+	{
+		_files[_count++] = file;
+		set_next(file);
+	}
+
+private:
+	/// The wrapper followed by all layers from bottom to top.
+	std::array<File*, Pipeline_vfs::max_layers + 1> _files;
+	std::size_t _count = 0;
+};
+
+} // namespace
+
+Pipeline_vfs::Pipeline_vfs(sqlite3_vfs* parent, const char* name, const char* default_layers)
+    : SQLite3_vfs_wrapper<>{ parent, name }, _default_layers{ default_layers ? default_layers : "" }
+{
+#if YSQLITE3_ENCRYPTION_BACKEND_OPENSSL
+	register_layer("crypt", make_layer<Crypt_file<Forwarding_file>>());
+	register_layer("dedup", make_layer<Dedup_file<Forwarding_file>>());
+#endif
+	register_layer("immutable", make_layer<Immutable_file<Forwarding_file>>());
+	register_layer("metrics", make_layer<Metrics_file<Forwarding_file>>());
+	register_layer("process_shm", make_layer<Process_shm_file<Forwarding_file>>());
+	register_layer("readahead", make_layer<Readahead_file<Forwarding_file>>());
+	register_layer("scrub", make_layer<Scrubbed_file<Forwarding_file>>());
+	register_layer("throttle", make_layer<Throttled_file<Forwarding_file>>());
+	register_layer("wal_shipping", make_layer<Wal_shipping_file<Forwarding_file>>());
+	register_layer("working_set", make_layer<Working_set_file<Forwarding_file>>());
+	register_layer("write_behind", make_layer<Write_behind_file<Forwarding_file>>());
+}
+
+void Pipeline_vfs::register_layer(const char* name, Layer layer)
+{
+	if (is_registered()) {
+		throw std::system_error{ Error::vfs_already_registered };
+	} else if (!name || !name[0] || std::strchr(name, ',')) {
+		throw std::system_error{ Error::bad_arguments };
+	}
+
+	for (auto& i : _layers) {
+		if (i.first == name) {
+			i.second = layer;
+			return;
+		}
+	}
+	_layers.emplace_back(name, layer);
+}
+
+void Pipeline_vfs::set_temp_budget(std::size_t budget, std::size_t chunk_size)
+{
+	if (is_registered()) {
+		throw std::system_error{ Error::vfs_already_registered };
+	}
+	_temp_arena = budget ? std::make_shared<Memory_arena>(budget, chunk_size) : nullptr;
+}
+
+Memory_arena_status Pipeline_vfs::temp_status() const
+{
+	return _temp_arena ? _temp_arena->status() : Memory_arena_status{};
+}
+
+std::unique_ptr<File> Pipeline_vfs::open(const char* name, File_format format, Open_flags flags,
+                                         Open_flags& output_flags)
+{
+	if (_temp_arena && (format == File_format::temp_db || format == File_format::transient_db ||
+	                    format == File_format::subjournal || format == File_format::temp_journal)) {
+		// the file on disk is opened when the budget is exhausted
+		const auto open = [this, name, format, flags] {
+			Open_flags output = 0;
+			return _open_layers(name, format, flags, output);
+		};
+		output_flags = flags;
+		return std::unique_ptr<File>{ new Spilling_file{ name, format, _temp_arena, open } };
+	}
+	return _open_layers(name, format, flags, output_flags);
+}
+
+std::unique_ptr<File> Pipeline_vfs::_open_layers(const char* name, File_format format, Open_flags flags,
+                                                 Open_flags& output_flags)
+{
+	// resolve the layers from top to bottom
+	std::array<const Layer*, max_layers> layers;
+	std::size_t count = 0;
+	auto selection    = sqlite3_uri_parameter(name, "layers");
+	if (!selection) {
+		selection = _default_layers.c_str();
+	}
+	while (*selection) {
+		const auto end = std::strchr(selection, ',');
+		const auto length =
+		    end ? static_cast<std::size_t>(end - selection) : std::char_traits<char>::length(selection);
+		if (length) {
+			if (count == layers.size()) {
+				throw std::system_error{ SQLite3_code::bad_database, "too many layers" };
+			}
+			layers[count] = _find_layer(selection, length);
+			if (!layers[count++]) {
+				throw std::system_error{ SQLite3_code::bad_database, "unknown layer" };
+			}
+		}
+		selection += length + (end ? 1 : 0);
+	}
+
+	// compute the layout of the memory block
+	const auto os_file_size = static_cast<std::size_t>(parent()->szOsFile);
+	const auto os_file      = align(sizeof(Pipeline_file), alignof(std::max_align_t));
+	const auto wrapper      = align(os_file + os_file_size, alignof(SQLite3_file_wrapper));
+	std::array<std::size_t, max_layers> offsets;
+	auto size = wrapper + sizeof(SQLite3_file_wrapper);
+	for (auto i = count; i--;) {
+		offsets[i] = align(size, layers[i]->alignment);
+		size       = offsets[i] + layers[i]->size;
+	}
+
+	const auto memory = static_cast<std::uint8_t*>(::operator new(size));
+	std::unique_ptr<Pipeline_file> file{ new (memory) Pipeline_file{ name, format } };
+	const auto raw_file = reinterpret_cast<sqlite3_file*>(memory + os_file);
+	std::memset(raw_file, 0, os_file_size);
+	assert_error(parent()->xOpen(parent(), name, raw_file, flags, &output_flags));
+
+	// the parent file is owned by the memory block, hence the non-owning pointer
+	file->push(new (memory + wrapper) SQLite3_file_wrapper{
+	    name, format, std::shared_ptr<sqlite3_file>{ std::shared_ptr<sqlite3_file>{}, raw_file }, parent() });
+	try {
+		for (auto i = count; i--;) {
+			file->push(layers[i]->construct(memory + offsets[i], name, format, file->next()));
+		}
+	} catch (...) {
+		try {
+			file->close();
+		} catch (...) {
+		}
+		throw;
+	}
+	return std::unique_ptr<File>{ file.release() };
+}
+
+const Layer* Pipeline_vfs::_find_layer(const char* name, std::size_t length) const noexcept
+{
+	for (const auto& i : _layers) {
+		if (i.first.length() == length && !i.first.compare(0, length, name, length)) {
+			return &i.second;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,123 @@
+#ifndef YSQLITE3_VFS_PIPELINE_VFS_HPP_
+#define YSQLITE3_VFS_PIPELINE_VFS_HPP_
+
+#include "../sqlite3.h"
+#include "forwarding_file.hpp"
+#include "memory_arena.hpp"
+#include "sqlite3_vfs_wrapper.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/// Describes a file layer which can be stacked at runtime by the Pipeline_vfs.
+struct Layer
+{
+	std::size_t size;
+	std::size_t alignment;
+	/// Constructs the layer in `memory` on top of `next` and returns it.
+	File* (*construct)(void* memory, const char* name, File_format format, File* next);
+};
+
+/**
+ * Creates the layer description of a file layer.
+ *
+ * @tparam Layer_file the layer; must be constructible with `(name, format, next)`, for example
+ * `Crypt_file<Forwarding_file>`
+ */
+template<typename Layer_file>
+inline Layer make_layer() noexcept
+{
+	static_assert(std::is_base_of<Forwarding_file, Layer_file>::value, "Layer_file must derive Forwarding_file");
+	static_assert(alignof(Layer_file) <= alignof(std::max_align_t), "over-aligned layers are not supported");
+
+	return { sizeof(Layer_file), alignof(Layer_file),
+		       [](void* memory, const char* name, File_format format, File* next) -> File* {
+			       return new (memory) Layer_file{ name, format, next };
+		       } };
+}
+
+/**
+ * A VFS which builds the layer stack of every file at runtime. The layers are selected with the URI
+ * parameter `layers`, for example `file:my.db?layers=metrics,crypt,readahead`. The first layer is the
+ * one closest to SQLite and the last one is the closest to the disk. Layers that are not selected do not
+ * cost anything and all layers of a file are placed in one allocation.
+ *
+ * The following layers are registered by default:
+ *   - `crypt`: Crypt_file (only with an encryption backend)
+ *   - `dedup`: Dedup_file (only with an encryption backend)
+ *   - `immutable`: Immutable_file
+ *   - `metrics`: Metrics_file
+ *   - `process_shm`: Process_shm_file
+ *   - `readahead`: Readahead_file
+ *   - `scrub`: Scrubbed_file
+ *   - `throttle`: Throttled_file
+ *   - `wal_shipping`: Wal_shipping_file
+ *   - `working_set`: Working_set_file
+ *   - `write_behind`: Write_behind_file
+ *
+ * With set_temp_budget() temporary files are kept in memory instead: sorter runs, temporary tables and
+ * indices, and statement and temporary journals are moved to disk only when all temporary files of this VFS
+ * together exceed the budget.
+ */
+class Pipeline_vfs : public SQLite3_vfs_wrapper<>
+{
+public:
+	/// The maximum amount of layers per file.
+	constexpr static std::size_t max_layers = 8;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param parent the VFS doing the actual I/O
+	 * @param name the name of this VFS
+	 * @param default_layers (opt) the layers for files without the `layers` parameter; temporary files
+	 * never have one
+	 */
+	Pipeline_vfs(sqlite3_vfs* parent, const char* name, const char* default_layers = nullptr);
+	/**
+	 * Registers a layer or replaces the layer with the same name. Layers must be registered before this VFS
+	 * is registered.
+	 *
+	 * @exception std::system_error
+	 *   - Error::vfs_already_registered if this VFS is already registered
+	 *   - Error::bad_arguments if the name is empty or contains a comma
+	 * @param name the name used in the `layers` parameter
+	 * @param layer the layer; see make_layer()
+	 */
+	void register_layer(const char* name, Layer layer);
+	/**
+	 * Keeps temporary files in memory up to a budget shared by all of them. A file which does not fit
+	 * anymore is moved to disk through its layers. Must be called before this VFS is registered.
+	 *
+	 * @exception std::system_error Error::vfs_already_registered if this VFS is already registered
+	 * @param budget the memory for all temporary files in bytes; 0 disables this
+	 * @param chunk_size the allocation granularity in bytes
+	 */
+	void set_temp_budget(std::size_t budget, std::size_t chunk_size = 64 * 1024);
+	/// Returns the memory usage of the temporary files.
+	Memory_arena_status temp_status() const;
+	std::unique_ptr<File> open(const char* name, File_format format, Open_flags flags,
+	                           Open_flags& output_flags) override;
+
+private:
+	std::vector<std::pair<std::string, Layer>> _layers;
+	std::string _default_layers;
+	std::shared_ptr<Memory_arena> _temp_arena;
+
+	std::unique_ptr<File> _open_layers(const char* name, File_format format, Open_flags flags,
+	                                   Open_flags& output_flags);
+	const Layer* _find_layer(const char* name, std::size_t length) const noexcept;
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
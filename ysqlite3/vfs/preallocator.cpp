@@ -0,0 +1,161 @@
+#include "preallocator.hpp"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#	include <cerrno>
+#	include <fcntl.h>
+#	include <sys/stat.h>
+#endif
+
+using namespace ysqlite3::vfs;
+
+Preallocator::Preallocator(int fd, sqlite3_int64 chunk_size, bool background) noexcept
+    : _fd{ fd }, _background{ background }, _chunk_size{ chunk_size }
+{
+#if defined(__linux__)
+	// the existing data is already allocated
+	struct stat info;
+	if (!fstat(_fd, &info)) {
+		_reserved = info.st_size;
+	}
+
+	// reserving the chunk at the end tells whether the file system supports it
+	const auto to = _round_up(_reserved + 1);
+	if (_allocate(_reserved, to)) {
+		_reserved = to;
+	}
+#else
+	_supported = false;
+#endif
+}
+
+Preallocator::~Preallocator()
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_stop = true;
+	}
+	_condition.notify_one();
+	if (_worker.joinable()) {
+		_worker.join();
+	}
+}
+
+void Preallocator::set_chunk_size(sqlite3_int64 chunk_size) noexcept
+{
+	_chunk_size = chunk_size;
+}
+
+bool Preallocator::supported() const noexcept
+{
+	return _supported;
+}
+
+void Preallocator::reserve(sqlite3_int64 size) noexcept
+{
+	const auto from = _reserved.load();
+	const auto to   = _round_up(size);
+	if (!_supported || to <= from) {
+		return;
+	}
+
+	unsigned long generation = 0;
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		generation = _generation;
+	}
+	if (_allocate(from, to)) {
+		std::lock_guard<std::mutex> lock{ _mutex };
+		if (generation == _generation && to > _reserved) {
+			_reserved = to;
+		}
+	}
+}
+
+void Preallocator::grow(sqlite3_int64 end) noexcept
+{
+	const auto chunk_size = _chunk_size.load(std::memory_order_relaxed);
+	if (!_supported.load(std::memory_order_relaxed) || chunk_size <= 0) {
+		return;
+	} else if (!_background) {
+		if (end > _reserved) {
+			reserve(end);
+		}
+		return;
+	} else if (end + chunk_size / 2 <= _reserved) {
+		return;
+	}
+
+	// stay one chunk ahead of the writes
+	std::lock_guard<std::mutex> lock{ _mutex };
+	_target = std::max(_target, _round_up(end) + chunk_size);
+	if (!_worker.joinable()) {
+		try {
+			_worker = std::thread{ &Preallocator::_run, this };
+		} catch (...) {
+			// the writes allocate as usual
+			return;
+		}
+	}
+	_condition.notify_one();
+}
+
+void Preallocator::release(sqlite3_int64 size) noexcept
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	++_generation;
+	const auto reserved = _reserved.load();
+#if defined(__linux__)
+	if (_supported && reserved > size) {
+		fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, size, reserved - size);
+	}
+#endif
+	_reserved = std::min(reserved, size);
+	_target   = std::min(_target, size);
+}
+
+sqlite3_int64 Preallocator::_round_up(sqlite3_int64 size) const noexcept
+{
+	const auto chunk_size = _chunk_size.load(std::memory_order_relaxed);
+	return chunk_size > 0 ? (size + chunk_size - 1) / chunk_size * chunk_size : size;
+}
+
+bool Preallocator::_allocate(sqlite3_int64 from, sqlite3_int64 to) noexcept
+{
+#if defined(__linux__)
+	int result = 0;
+	do {
+		result = fallocate(_fd, FALLOC_FL_KEEP_SIZE, from, to - from);
+	} while (result && errno == EINTR);
+	if (!result) {
+		return true;
+	} else if (errno == EOPNOTSUPP || errno == ENOSYS) {
+		_supported = false;
+	}
+#endif
+	return false;
+}
+
+void Preallocator::_run() noexcept
+{
+	std::unique_lock<std::mutex> lock{ _mutex };
+	while (true) {
+		_condition.wait(lock, [this] { return _stop || _target > _reserved; });
+		if (_stop) {
+			return;
+		}
+
+		const auto generation = _generation;
+		const auto from       = _reserved.load();
+		const auto to         = _target;
+		lock.unlock();
+		const auto success = _allocate(from, to);
+		lock.lock();
+		if (!success) {
+			_target = _reserved;
+		} else if (generation == _generation && to > _reserved) {
+			_reserved = to;
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#ifndef YSQLITE3_VFS_PREALLOCATOR_HPP_
+#define YSQLITE3_VFS_PREALLOCATOR_HPP_
+
+#include "../sqlite3.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Reserves disk space beyond the end of a file in large chunks without changing the file size. Growing
+ * files stay contiguous on disk and extending writes do not have to allocate blocks. Optionally, a
+ * background thread reserves the next chunk before the writes reach the end of the reserved space.
+ *
+ * Reserving is only advisory; if it fails, for example because the disk is full, the writes allocate the
+ * space as usual. The constructor already reserves the chunk at the end of the file to find out whether the
+ * file system supports it.
+ *
+ * @note Only available on Linux; on other systems nothing is reserved.
+ */
+class Preallocator
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param fd the file descriptor; must stay open until this object is destroyed
+	 * @param chunk_size the granularity of the reservations in bytes
+	 * @param background whether a background thread reserves ahead of the writes
+	 */
+	Preallocator(int fd, sqlite3_int64 chunk_size, bool background) noexcept;
+	Preallocator(const Preallocator& copy) = delete;
+	/// Stops the background thread.
+	~Preallocator();
+	void set_chunk_size(sqlite3_int64 chunk_size) noexcept;
+	/// Returns false if the file system cannot reserve space; the writes then allocate it as usual.
+	bool supported() const noexcept;
+	/// Reserves the space up to `size` rounded up to the chunk size.
+	void reserve(sqlite3_int64 size) noexcept;
+	/**
+	 * Notifies this object about a write up to `end`. If the write is close to the end of the reserved space,
+	 * the next chunk is reserved either by the background thread or immediately.
+	 *
+	 * @param end the end of the write
+	 */
+	void grow(sqlite3_int64 end) noexcept;
+	/**
+	 * Releases the reserved space after the file was truncated.
+	 *
+	 * @param size the new size of the file
+	 */
+	void release(sqlite3_int64 size) noexcept;
+
+private:
+	int _fd;
+	bool _background;
+	/// False if the file system cannot reserve space.
+	std::atomic<bool> _supported{ true };
+	std::atomic<sqlite3_int64> _chunk_size;
+	/// All space below is reserved.
+	std::atomic<sqlite3_int64> _reserved{ 0 };
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::thread _worker;
+	sqlite3_int64 _target     = 0;
+	unsigned long _generation = 0;
+	bool _stop                = false;
+
+	sqlite3_int64 _round_up(sqlite3_int64 size) const noexcept;
+	/// Reserves the range and returns whether it succeeded.
+	bool _allocate(sqlite3_int64 from, sqlite3_int64 to) noexcept;
+	void _run() noexcept;
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
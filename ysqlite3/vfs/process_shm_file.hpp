@@ -0,0 +1,72 @@
+#ifndef YSQLITE3_VFS_PROCESS_SHM_FILE_HPP_
+#define YSQLITE3_VFS_PROCESS_SHM_FILE_HPP_
+
+#include "file.hpp"
+#include "shm_index.hpp"
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Keeps the WAL index in the heap of this process instead of the `-shm` file. The locks of the index are
+ * atomics and Shm_index::map() is only called when SQLite maps a new region, so read transactions do not
+ * need any system call. The index is released when the last connection of the database unmaps it.
+ *
+ * @warning All connections to the database must live in this process and use this layer; connections of
+ * other processes would use a different WAL index.
+ */
+template<typename Parent>
+class Process_shm_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	using Parent::Parent;
+
+	void close() override
+	{
+		shm_unmap(0);
+		Parent::close();
+	}
+	void shm_map(int page, int page_size, bool is_write, void volatile** mapped_memory) override
+	{
+		*mapped_memory = _attach().map(page, page_size, is_write);
+	}
+	void shm_lock(int offset, int n, int flags) override
+	{
+		_attach().lock(_connection, offset, n, flags);
+	}
+	void shm_barrier() noexcept override
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	void shm_unmap(int) override
+	{
+		if (_index) {
+			_index->unlock_all(_connection);
+			_index = nullptr;
+		}
+	}
+
+private:
+	std::shared_ptr<Shm_index> _index;
+	Shm_index::Connection _connection;
+
+	Shm_index& _attach()
+	{
+		if (!_index) {
+			_index = Shm_index::attach(this->name);
+		}
+		return *_index;
+	}
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef YSQLITE3_VFS_READAHEAD_FILE_HPP_
+#define YSQLITE3_VFS_READAHEAD_FILE_HPP_
+
+#include "file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Detects sequential reads of the main database and reads ahead in large blocks. The block size can be
+ * configured with the URI parameter `readahead` (in bytes; default 256 KiB).
+ *
+ * The buffer is dropped on every write, truncate and lock change, so no stale data can be returned.
+ *
+ * @note Because whole blocks are read at once, this layer must be stacked below page transforming layers
+ * like Crypt_file.
+ */
+template<typename Parent>
+class Readahead_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	template<typename... Args>
+	Readahead_file(Args&&... args) : Parent{ std::forward<Args>(args)... }
+	{
+		const auto size = sqlite3_uri_int64(this->name, "readahead", 256 * 1024);
+		_block_size     = size > 0 ? static_cast<std::size_t>(size) : 0;
+	}
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		const auto sequential = offset == _last_end;
+		_streak               = sequential ? _streak + 1 : 0;
+		_last_end             = offset + static_cast<sqlite3_int64>(buffer.size());
+
+		// serve from buffer
+		if (offset >= _buffer_offset &&
+		    _last_end <= _buffer_offset + static_cast<sqlite3_int64>(_buffer.size())) {
+			std::memcpy(buffer.begin(), _buffer.data() + (offset - _buffer_offset), buffer.size());
+			return;
+		}
+
+		if (this->format != File_format::main_db || _streak < 2 || buffer.size() >= _block_size) {
+			Parent::read(buffer, offset);
+			return;
+		}
+
+		// read ahead but never past the end of file
+		const auto available = Parent::file_size() - offset;
+		if (available < static_cast<sqlite3_int64>(buffer.size())) {
+			_drop();
+			Parent::read(buffer, offset);
+			return;
+		}
+		_buffer.resize(static_cast<std::size_t>(std::min<sqlite3_int64>(available, _block_size)));
+		_buffer_offset = offset;
+		try {
+			Parent::read({ _buffer.data(), _buffer.size() }, offset);
+		} catch (...) {
+			_drop();
+			throw;
+		}
+		std::memcpy(buffer.begin(), _buffer.data(), buffer.size());
+	}
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		_drop();
+		Parent::write(buffer, offset);
+	}
+	void truncate(sqlite3_int64 size) override
+	{
+		_drop();
+		Parent::truncate(size);
+	}
+	void lock(Lock_flag flag) override
+	{
+		_drop();
+		Parent::lock(flag);
+	}
+	void unlock(Lock_flag flag) override
+	{
+		_drop();
+		Parent::unlock(flag);
+	}
+	void shm_lock(int offset, int n, int flags) override
+	{
+		// WAL read transactions only change shm locks
+		_drop();
+		Parent::shm_lock(offset, n, flags);
+	}
+
+private:
+	std::size_t _block_size = 0;
+	std::vector<std::uint8_t> _buffer;
+	sqlite3_int64 _buffer_offset = 0;
+	sqlite3_int64 _last_end      = -1;
+	int _streak                  = 0;
+
+	void _drop() noexcept
+	{
+		_buffer.clear();
+		_streak = 0;
+	}
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef YSQLITE3_VFS_SCRUBBED_FILE_HPP_
+#define YSQLITE3_VFS_SCRUBBED_FILE_HPP_
+
+#include "file.hpp"
+#include "scrubber.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Answers `PRAGMA scrub_status` with the status of the Scrubber of the main database: whether a pass is
+ * running, the completed passes, the pages and the position of the current pass, the verified pages and the
+ * failed pages. Only the first 100 failed pages are listed.
+ */
+template<typename Parent>
+class Scrubbed_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	using Parent::Parent;
+
+	void file_control(File_control operation, void* arg) override
+	{
+		if (this->format == File_format::main_db && is_pragma(operation, arg, "scrub_status")) {
+			Scrub_status status;
+			if (!Scrubber::status_of(this->name, status)) {
+				set_pragma_result(arg, sqlite3_mprintf("no scrubber"));
+				return;
+			}
+
+			std::string pages;
+			const auto count = std::min<std::size_t>(status.failures.size(), 100);
+			for (std::size_t i = 0; i < count; ++i) {
+				pages += (i ? "," : "") + std::to_string(status.failures[i]);
+			}
+			set_pragma_result(arg, sqlite3_mprintf("running=%d passes=%llu pages=%llu position=%llu verified=%llu "
+			                                       "failures=%llu failed_pages=%s error=%s",
+			                                       status.running ? 1 : 0,
+			                                       static_cast<unsigned long long>(status.passes),
+			                                       static_cast<unsigned long long>(status.pages),
+			                                       static_cast<unsigned long long>(status.position),
+			                                       static_cast<unsigned long long>(status.verified),
+			                                       static_cast<unsigned long long>(status.failures.size()),
+			                                       pages.c_str(), status.error.c_str()));
+			return;
+		}
+		Parent::file_control(operation, arg);
+	}
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
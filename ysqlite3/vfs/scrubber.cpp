@@ -0,0 +1,322 @@
+#include "scrubber.hpp"
+
+#include "../error.hpp"
+#include "../finally.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+
+using namespace ysqlite3;
+using namespace ysqlite3::vfs;
+
+namespace {
+
+typedef std::unique_ptr<sqlite3_file, void (*)(sqlite3_file*)> File_handle;
+
+/// The page containing this offset is never written by SQLite.
+constexpr sqlite3_int64 pending_byte = 0x40000000;
+constexpr auto retry_delay           = std::chrono::milliseconds{ 10 };
+constexpr auto save_interval         = std::chrono::seconds{ 1 };
+
+std::mutex registry_mutex;
+std::map<std::string, Scrubber*> registry;
+
+inline void check(int ec)
+{
+	if (ec != SQLITE_OK) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec) };
+	}
+}
+
+File_handle open_file(sqlite3_vfs* vfs, const char* name)
+{
+	File_handle file{ static_cast<sqlite3_file*>(sqlite3_malloc(vfs->szOsFile)), [](sqlite3_file* file) {
+		                 if (file->pMethods) {
+			                 file->pMethods->xClose(file);
+		                 }
+		                 sqlite3_free(file);
+	                 } };
+	if (!file) {
+		throw std::system_error{ SQLite3_code::memory };
+	}
+
+	file->pMethods = nullptr;
+	auto flags     = SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_READONLY;
+	check(vfs->xOpen(vfs, name, file.get(), flags, &flags));
+	return file;
+}
+
+} // namespace
+
+Scrubber::Scrubber(const char* uri, const char* vfs, Scrub_options options) : _options{ options }
+{
+	_database.open(uri, open_flag_readonly | open_flag_uri, vfs);
+	_vfs  = sqlite3_vfs_find(vfs);
+	_name = sqlite3_db_filename(_database.handle(), "main");
+	if (!_options.threads) {
+		_options.threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	_options.batch_pages = std::max<std::uint32_t>(_options.batch_pages, 1);
+	_load_state();
+
+	std::lock_guard<std::mutex> lock{ registry_mutex };
+	registry[_name] = this;
+}
+
+Scrubber::~Scrubber()
+{
+	{
+		std::lock_guard<std::mutex> lock{ registry_mutex };
+		const auto entry = registry.find(_name);
+		if (entry != registry.end() && entry->second == this) {
+			registry.erase(entry);
+		}
+	}
+	stop();
+}
+
+void Scrubber::start()
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	if (_status.running) {
+		return;
+	}
+
+	// the threads of the last pass have exited or are about to
+	for (auto& i : _threads) {
+		i.join();
+	}
+	_threads.clear();
+
+	const auto file = open_file(_vfs, _name);
+	std::uint8_t header[100]{};
+	sqlite3_int64 size = 0;
+	check(file->pMethods->xFileSize(file.get(), &size));
+	if (size < static_cast<sqlite3_int64>(sizeof(header))) {
+		return;
+	}
+	check(file->pMethods->xRead(file.get(), header, sizeof(header), 0));
+	_page_size      = static_cast<std::uint32_t>(header[16]) << 8 | header[17];
+	_page_size      = _page_size == 1 ? 65536 : _page_size;
+	_status.pages   = _page_size ? static_cast<std::uint64_t>(size) / _page_size : 0;
+	_status.error   = {};
+	_status.running = true;
+
+	// verify the interrupted batches again
+	_next = _position() > _status.pages ? 1 : _position();
+	_unfinished.clear();
+
+	_stop = false;
+	_bucket.set_rate(_options.bytes_per_second);
+	_workers = _options.threads;
+	for (std::size_t i = 0; i < _options.threads; ++i) {
+		_threads.emplace_back(&Scrubber::_run, this);
+	}
+}
+
+void Scrubber::stop()
+{
+	_stop = true;
+	// wakes threads waiting for the throttle
+	_bucket.set_rate(0);
+	wait();
+}
+
+void Scrubber::wait()
+{
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		threads.swap(_threads);
+	}
+	for (auto& i : threads) {
+		i.join();
+	}
+}
+
+Scrub_status Scrubber::status() const
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	auto status     = _status;
+	status.position = _position();
+	status.failures.assign(_failures.begin(), _failures.end());
+	return status;
+}
+
+bool Scrubber::status_of(const char* path, Scrub_status& status)
+{
+	std::lock_guard<std::mutex> lock{ registry_mutex };
+	const auto entry = registry.find(path);
+	if (entry == registry.end()) {
+		return false;
+	}
+	status = entry->second->status();
+	return true;
+}
+
+std::string Scrubber::_state_path() const
+{
+	return std::string{ _name } + "-scrub";
+}
+
+void Scrubber::_run() noexcept
+{
+	try {
+		const auto file = open_file(_vfs, _name);
+		std::vector<std::uint8_t> page(_page_size);
+		auto saved = std::chrono::steady_clock::now();
+		while (!_stop) {
+			std::uint64_t first = 0;
+			std::uint64_t last  = 0;
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				if (_next > _status.pages) {
+					break;
+				}
+				first = _next;
+				last  = std::min<std::uint64_t>(first + _options.batch_pages - 1, _status.pages);
+				_next = last + 1;
+				_unfinished.insert(first);
+			}
+
+			// do not hold the lock while waiting
+			_bucket.acquire((last - first + 1) * _page_size);
+			const auto done = _verify_batch(file.get(), page, first, last);
+
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_unfinished.erase(_unfinished.find(first));
+			if (done <= last) {
+				_unfinished.insert(done);
+			}
+			if (std::chrono::steady_clock::now() - saved >= save_interval) {
+				_save_state();
+				saved = std::chrono::steady_clock::now();
+			}
+		}
+	} catch (const std::exception& e) {
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_status.error = e.what();
+		_stop         = true;
+	}
+
+	std::lock_guard<std::mutex> lock{ _mutex };
+	if (--_workers) {
+		return;
+	}
+
+	// the last thread finishes the pass
+	if (!_stop && _position() > _status.pages) {
+		++_status.passes;
+		_next = 1;
+		_unfinished.clear();
+	}
+	_status.running = false;
+	try {
+		_save_state();
+	} catch (const std::system_error& e) {
+		_status.error = e.what();
+	}
+}
+
+std::uint64_t Scrubber::_verify_batch(sqlite3_file* file, std::vector<std::uint8_t>& page, std::uint64_t first,
+                                      std::uint64_t last)
+{
+	// wait for writers in rollback journal mode
+	int ec = SQLITE_BUSY;
+	while ((ec = file->pMethods->xLock(file, SQLITE_LOCK_SHARED)) == SQLITE_BUSY) {
+		if (_stop) {
+			return first;
+		}
+		std::this_thread::sleep_for(retry_delay);
+	}
+	check(ec);
+	const auto _ = finally([file] { file->pMethods->xUnlock(file, SQLITE_LOCK_NONE); });
+
+	for (auto number = first; number <= last; ++number) {
+		if (_stop) {
+			return number;
+		}
+
+		const auto offset = static_cast<sqlite3_int64>(number - 1) * _page_size;
+		if (offset <= pending_byte && pending_byte < offset + _page_size) {
+			continue;
+		}
+
+		auto valid = _verify_page(file, page, offset);
+		if (!valid) {
+			// a checkpoint may have written the page while it was read
+			std::this_thread::sleep_for(retry_delay);
+			valid = _verify_page(file, page, offset);
+		}
+
+		std::lock_guard<std::mutex> lock{ _mutex };
+		if (valid) {
+			_failures.erase(static_cast<std::uint32_t>(number));
+		} else {
+			_failures.insert(static_cast<std::uint32_t>(number));
+		}
+		++_status.verified;
+	}
+	return last + 1;
+}
+
+bool Scrubber::_verify_page(sqlite3_file* file, std::vector<std::uint8_t>& page, sqlite3_int64 offset)
+{
+	const auto ec = file->pMethods->xRead(file, page.data(), static_cast<int>(page.size()), offset);
+	if (ec == SQLITE_IOERR_SHORT_READ) {
+		// the database was truncated
+		sqlite3_int64 size = 0;
+		return !file->pMethods->xFileSize(file, &size) && offset >= size;
+	}
+	return ec == SQLITE_OK;
+}
+
+std::uint64_t Scrubber::_position() const noexcept
+{
+	return _unfinished.empty() ? _next : std::min(_next, *_unfinished.begin());
+}
+
+void Scrubber::_load_state()
+{
+	const auto file = std::fopen(_state_path().c_str(), "r");
+	if (!file) {
+		return;
+	}
+
+	const auto _                = finally([file] { std::fclose(file); });
+	unsigned long long position = 0;
+	unsigned long long passes   = 0;
+	if (std::fscanf(file, "%llu %llu", &position, &passes) != 2) {
+		return;
+	}
+	_next              = std::max<std::uint64_t>(position, 1);
+	_status.passes     = passes;
+	unsigned long page = 0;
+	while (std::fscanf(file, "%lu", &page) == 1) {
+		_failures.insert(static_cast<std::uint32_t>(page));
+	}
+}
+
+void Scrubber::_save_state()
+{
+	const auto path      = _state_path();
+	const auto temporary = path + ".tmp";
+	const auto file      = std::fopen(temporary.c_str(), "w");
+	if (!file) {
+		throw std::system_error{ SQLite3_code::bad_database };
+	}
+
+	auto written = std::fprintf(file, "%llu %llu\n", static_cast<unsigned long long>(_position()),
+	                            static_cast<unsigned long long>(_status.passes));
+	for (const auto page : _failures) {
+		if (written >= 0) {
+			written = std::fprintf(file, "%lu\n", static_cast<unsigned long>(page));
+		}
+	}
+	if (std::fclose(file) || written < 0 || std::rename(temporary.c_str(), path.c_str())) {
+		throw std::system_error{ SQLite3_code::write };
+	}
+}
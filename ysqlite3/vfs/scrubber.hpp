@@ -0,0 +1,127 @@
+#ifndef YSQLITE3_VFS_SCRUBBER_HPP_
+#define YSQLITE3_VFS_SCRUBBER_HPP_
+
+#include "../database.hpp"
+#include "throttle.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+struct Scrub_options
+{
+	/// The number of threads verifying pages in parallel; 0 uses one thread per core.
+	std::size_t threads = 1;
+	/// The pages verified while holding a shared lock.
+	std::uint32_t batch_pages = 64;
+	/// The read rate of all threads together; 0 is unlimited.
+	std::uint64_t bytes_per_second = 0;
+};
+
+struct Scrub_status
+{
+	bool running = false;
+	/// The completed passes over the whole database.
+	std::uint64_t passes = 0;
+	/// The pages of the current pass.
+	std::uint64_t pages = 0;
+	/// The first page which was not verified yet in the current pass.
+	std::uint64_t position = 1;
+	/// The pages verified by this scrubber.
+	std::uint64_t verified = 0;
+	/// The pages which failed verification, ordered by page number.
+	std::vector<std::uint32_t> failures;
+	/// The error which stopped the last pass.
+	std::string error;
+};
+
+/**
+ * Verifies every page of a database in the background by reading it through the layers of its VFS, without
+ * involving the pager of a connection. With the `crypt` layer every page is decrypted and its authentication
+ * tag checked, with any other layer stack read errors are found. This finds corruption in cold pages long
+ * before they are needed.
+ *
+ * The pages are read in batches while holding a shared lock, so a connection in rollback journal mode never
+ * writes a page while it is verified. In WAL mode a checkpoint may still write a page while it is read; a
+ * failed page is therefore verified again before it is recorded.
+ *
+ * The position and the failed pages are stored in `<database>-scrub`; an interrupted pass resumes there.
+ * While a scrubber exists its status is returned by `PRAGMA scrub_status` of the `scrub` layer. All methods
+ * are thread-safe.
+ */
+class Scrubber
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @exception std::system_error if the database could not be opened
+	 * @param uri the URI of the database with all parameters required by the layers, like `key` for `crypt`
+	 * @param vfs the VFS of the database; `nullptr` is the default VFS
+	 * @param options the options
+	 */
+	Scrubber(const char* uri, const char* vfs = nullptr, Scrub_options options = {});
+	/// Stops the scrubber.
+	~Scrubber();
+	/**
+	 * Starts or continues a pass in the background; does nothing if a pass is running.
+	 *
+	 * @exception std::system_error if the database could not be read
+	 */
+	void start();
+	/// Stops the running pass; the next start() continues where it stopped.
+	void stop();
+	/// Waits until the running pass finished or was stopped.
+	void wait();
+	Scrub_status status() const;
+	/**
+	 * Returns the status of the scrubber of a database.
+	 *
+	 * @param path the path of the database as passed to the VFS
+	 * @param[out] status the status
+	 * @return `false` if no scrubber exists for the database
+	 */
+	static bool status_of(const char* path, Scrub_status& status);
+
+private:
+	Database _database;
+	sqlite3_vfs* _vfs;
+	/// The name passed to the VFS; includes the URI parameters.
+	const char* _name;
+	Scrub_options _options;
+	Token_bucket _bucket;
+	std::vector<std::thread> _threads;
+	std::atomic<bool> _stop{ false };
+
+	mutable std::mutex _mutex;
+	Scrub_status _status;
+	std::uint32_t _page_size = 0;
+	/// The next batch.
+	std::uint64_t _next = 1;
+	/// The first pages of the batches in progress and of the batches which were interrupted.
+	std::multiset<std::uint64_t> _unfinished;
+	std::set<std::uint32_t> _failures;
+	std::size_t _workers = 0;
+
+	std::string _state_path() const;
+	void _run() noexcept;
+	/// Returns the first page which was not verified.
+	std::uint64_t _verify_batch(sqlite3_file* file, std::vector<std::uint8_t>& page, std::uint64_t first,
+	                            std::uint64_t last);
+	bool _verify_page(sqlite3_file* file, std::vector<std::uint8_t>& page, sqlite3_int64 offset);
+	std::uint64_t _position() const noexcept;
+	void _load_state();
+	void _save_state();
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
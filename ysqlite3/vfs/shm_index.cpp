@@ -0,0 +1,127 @@
+#include "shm_index.hpp"
+
+#include "../error.hpp"
+
+#include <map>
+
+using namespace ysqlite3;
+using namespace ysqlite3::vfs;
+
+namespace {
+
+std::mutex registry_mutex;
+std::map<std::string, std::weak_ptr<Shm_index>> registry;
+
+} // namespace
+
+Shm_index::Shm_index() noexcept
+{
+	for (auto& i : _locks) {
+		i.store(0, std::memory_order_relaxed);
+	}
+}
+
+std::shared_ptr<Shm_index> Shm_index::attach(const char* name)
+{
+	std::lock_guard<std::mutex> lock{ registry_mutex };
+	auto& entry = registry[name ? name : ""];
+	auto index  = entry.lock();
+	if (!index) {
+		index.reset(new Shm_index{});
+		entry = index;
+	}
+
+	// drop the indexes of closed databases
+	for (auto i = registry.begin(); i != registry.end();) {
+		if (i->second.expired()) {
+			i = registry.erase(i);
+		} else {
+			++i;
+		}
+	}
+	return index;
+}
+
+void volatile* Shm_index::map(int region, int region_size, bool extend)
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	if (_region_size && _region_size != region_size) {
+		throw std::system_error{ SQLite3_code::shmsize };
+	}
+	_region_size = region_size;
+
+	const auto index = static_cast<std::size_t>(region);
+	if (index >= _regions.size()) {
+		if (!extend) {
+			return nullptr;
+		}
+		_regions.reserve(index + 1);
+		while (_regions.size() <= index) {
+			_regions.emplace_back(new std::uint8_t[static_cast<std::size_t>(region_size)]{});
+		}
+	}
+	return _regions[index].get();
+}
+
+void Shm_index::lock(Connection& connection, int offset, int n, int flags)
+{
+	const auto mask = static_cast<std::uint16_t>(((1 << n) - 1) << offset);
+	if (flags & SQLITE_SHM_UNLOCK) {
+		_unlock(connection, mask);
+		return;
+	}
+
+	std::uint16_t acquired = 0;
+	for (auto i = offset; i < offset + n; ++i) {
+		const auto bit = static_cast<std::uint16_t>(1 << i);
+		auto& slot     = _locks[static_cast<std::size_t>(i)];
+		if ((connection.shared | connection.exclusive) & bit) {
+			continue;
+		} else if (flags & SQLITE_SHM_SHARED) {
+			auto value = slot.load(std::memory_order_relaxed);
+			do {
+				if (value < 0) {
+					break;
+				}
+			} while (!slot.compare_exchange_weak(value, value + 1, std::memory_order_acquire,
+			                                     std::memory_order_relaxed));
+			if (value >= 0) {
+				connection.shared |= bit;
+				acquired |= bit;
+				continue;
+			}
+		} else {
+			auto value = 0;
+			if (slot.compare_exchange_strong(value, -1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				connection.exclusive |= bit;
+				acquired |= bit;
+				continue;
+			}
+		}
+
+		// all or nothing
+		_unlock(connection, acquired);
+		throw std::system_error{ SQLite3_code::busy };
+	}
+}
+
+void Shm_index::unlock_all(Connection& connection) noexcept
+{
+	_unlock(connection, static_cast<std::uint16_t>(connection.shared | connection.exclusive));
+}
+
+void Shm_index::_unlock(Connection& connection, std::uint16_t mask) noexcept
+{
+	for (std::size_t i = 0; i < _locks.size(); ++i) {
+		const auto bit = static_cast<std::uint16_t>(1 << i);
+		if (!(mask & bit)) {
+			continue;
+		} else if (connection.exclusive & bit) {
+			_locks[i].store(0, std::memory_order_release);
+		} else if (connection.shared & bit) {
+			_locks[i].fetch_sub(1, std::memory_order_release);
+		}
+	}
+	connection.shared &= static_cast<std::uint16_t>(~mask);
+	connection.exclusive &= static_cast<std::uint16_t>(~mask);
+}
@@ -0,0 +1,81 @@
+#ifndef YSQLITE3_VFS_SHM_INDEX_HPP_
+#define YSQLITE3_VFS_SHM_INDEX_HPP_
+
+#include "../sqlite3.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * A WAL index in the heap of this process. All connections of the same database share one index and the
+ * locks are plain atomics, so no system call is involved.
+ *
+ * @warning The index is not visible to other processes; all connections to the database must live in this
+ * process.
+ */
+class Shm_index
+{
+public:
+	/// The locks held by one connection.
+	struct Connection
+	{
+		std::uint16_t shared    = 0;
+		std::uint16_t exclusive = 0;
+	};
+
+	Shm_index(const Shm_index& copy) = delete;
+	/**
+	 * Returns the index of the database. The index is released when the last connection drops it.
+	 *
+	 * @exception std::system_error if the allocation failed
+	 * @param name the name of the database
+	 * @return the index
+	 */
+	static std::shared_ptr<Shm_index> attach(const char* name);
+	/**
+	 * Returns the region.
+	 *
+	 * @exception std::system_error if the region size changed
+	 * @param region the index of the region
+	 * @param region_size the size of every region
+	 * @param extend whether missing regions are allocated
+	 * @return the region or `nullptr` if it does not exist and `extend` is false
+	 */
+	void volatile* map(int region, int region_size, bool extend);
+	/**
+	 * Acquires or releases locks without blocking.
+	 *
+	 * @exception std::system_error
+	 *   - SQLite3_code::busy if the lock is held by another connection
+	 * @param[in,out] connection the locks of the connection
+	 * @param offset the first lock
+	 * @param n the amount of locks
+	 * @param flags the `SQLITE_SHM_*` flags
+	 */
+	void lock(Connection& connection, int offset, int n, int flags);
+	/// Releases all locks held by the connection.
+	void unlock_all(Connection& connection) noexcept;
+
+private:
+	std::mutex _mutex;
+	int _region_size = 0;
+	std::vector<std::unique_ptr<std::uint8_t[]>> _regions;
+	/// The amount of shared owners or -1 if exclusively locked.
+	std::array<std::atomic<int>, SQLITE_SHM_NLOCK> _locks;
+
+	Shm_index() noexcept;
+	void _unlock(Connection& connection, std::uint16_t mask) noexcept;
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,244 @@
+#include "spilling_file.hpp"
+
+#include "../error.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ysqlite3;
+using namespace ysqlite3::vfs;
+
+Spilling_file::Spilling_file(const char* name, File_format format, std::shared_ptr<Memory_arena> arena,
+                             Opener open) noexcept
+    : File{ name, format }, _arena{ std::move(arena) }, _open{ std::move(open) }
+{}
+
+Spilling_file::~Spilling_file()
+{
+	_release(0);
+}
+
+void Spilling_file::close()
+{
+	_release(0);
+	if (_spilled) {
+		_spilled->close();
+	}
+}
+
+void Spilling_file::read(Span<std::uint8_t*> buffer, sqlite3_int64 offset)
+{
+	if (_spilled) {
+		_spilled->read(buffer, offset);
+		return;
+	}
+
+	const auto chunk_size = _arena->chunk_size();
+	const auto available  = std::max<sqlite3_int64>(std::min<sqlite3_int64>(_size - offset, buffer.size()), 0);
+	for (std::size_t done = 0; done < static_cast<std::size_t>(available);) {
+		const auto position = static_cast<std::size_t>(offset) + done;
+		const auto in_chunk = position % chunk_size;
+		const auto n        = std::min(static_cast<std::size_t>(available) - done, chunk_size - in_chunk);
+		std::memcpy(buffer.begin() + done, _chunks[position / chunk_size] + in_chunk, n);
+		done += n;
+	}
+	if (static_cast<std::size_t>(available) < buffer.size()) {
+		std::memset(buffer.begin() + available, 0, buffer.size() - static_cast<std::size_t>(available));
+		throw std::system_error{ SQLite3_code::short_read };
+	}
+}
+
+void Spilling_file::write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset)
+{
+	const auto end = offset + static_cast<sqlite3_int64>(buffer.size());
+	if (!_spilled && !_reserve(end)) {
+		_spill();
+	}
+	if (_spilled) {
+		_spilled->write(buffer, offset);
+		return;
+	}
+
+	const auto chunk_size = _arena->chunk_size();
+	for (std::size_t done = 0; done < buffer.size();) {
+		const auto position = static_cast<std::size_t>(offset) + done;
+		const auto in_chunk = position % chunk_size;
+		const auto n        = std::min(buffer.size() - done, chunk_size - in_chunk);
+		std::memcpy(_chunks[position / chunk_size] + in_chunk, buffer.begin() + done, n);
+		done += n;
+	}
+	_size = std::max(_size, end);
+}
+
+void Spilling_file::truncate(sqlite3_int64 size)
+{
+	if (_spilled) {
+		_spilled->truncate(size);
+	} else if (size < _size) {
+		const auto chunk_size = static_cast<sqlite3_int64>(_arena->chunk_size());
+		_size                 = size;
+		_release(static_cast<std::size_t>((size + chunk_size - 1) / chunk_size));
+	} else if (size > _size) {
+		// the new bytes are zeros
+		if (!_reserve(size)) {
+			_spill();
+			_spilled->truncate(size);
+		} else {
+			_size = size;
+		}
+	}
+}
+
+void Spilling_file::sync(Sync_flag flag)
+{
+	if (_spilled) {
+		_spilled->sync(flag);
+	}
+}
+
+sqlite3_int64 Spilling_file::file_size() const
+{
+	return _spilled ? _spilled->file_size() : _size;
+}
+
+void Spilling_file::lock(Lock_flag flag)
+{
+	if (_spilled) {
+		_spilled->lock(flag);
+	}
+}
+
+void Spilling_file::unlock(Lock_flag flag)
+{
+	if (_spilled) {
+		_spilled->unlock(flag);
+	}
+}
+
+bool Spilling_file::has_reserved_lock() const
+{
+	return _spilled && _spilled->has_reserved_lock();
+}
+
+void Spilling_file::file_control(File_control operation, void* arg)
+{
+	if (!_spilled) {
+		throw std::system_error{ SQLite3_code::not_found };
+	}
+	_spilled->file_control(operation, arg);
+}
+
+int Spilling_file::sector_size() const noexcept
+{
+	return _spilled ? _spilled->sector_size() : File::sector_size();
+}
+
+int Spilling_file::device_characteristics() const noexcept
+{
+	return _spilled ? _spilled->device_characteristics() : SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+}
+
+void Spilling_file::shm_map(int page, int page_size, bool is_write, void volatile** mapped_memory)
+{
+	if (!_spilled) {
+		throw std::system_error{ SQLite3_code::io };
+	}
+	_spilled->shm_map(page, page_size, is_write, mapped_memory);
+}
+
+void Spilling_file::shm_lock(int offset, int n, int flags)
+{
+	if (!_spilled) {
+		throw std::system_error{ SQLite3_code::io };
+	}
+	_spilled->shm_lock(offset, n, flags);
+}
+
+void Spilling_file::shm_barrier() noexcept
+{
+	if (_spilled) {
+		_spilled->shm_barrier();
+	}
+}
+
+void Spilling_file::shm_unmap(int delete_flag)
+{
+	if (_spilled) {
+		_spilled->shm_unmap(delete_flag);
+	}
+}
+
+void Spilling_file::fetch(sqlite3_int64 offset, int amount, void** buffer)
+{
+	if (_spilled) {
+		_spilled->fetch(offset, amount, buffer);
+	} else {
+		*buffer = nullptr;
+	}
+}
+
+void Spilling_file::unfetch(sqlite3_int64 offset, void* buffer)
+{
+	if (_spilled) {
+		_spilled->unfetch(offset, buffer);
+	}
+}
+
+bool Spilling_file::spilled() const noexcept
+{
+	return static_cast<bool>(_spilled);
+}
+
+bool Spilling_file::_reserve(sqlite3_int64 size)
+{
+	const auto chunk_size = _arena->chunk_size();
+	const auto count      = static_cast<std::size_t>((size + chunk_size - 1) / chunk_size);
+	while (_chunks.size() < count) {
+		const auto chunk = _arena->allocate();
+		if (!chunk) {
+			return false;
+		}
+		_chunks.push_back(chunk);
+	}
+
+	// reused chunks contain old data
+	if (size > _size) {
+		for (auto position = static_cast<std::size_t>(_size); position < static_cast<std::size_t>(size);) {
+			const auto in_chunk = position % chunk_size;
+			const auto n        = std::min(static_cast<std::size_t>(size) - position, chunk_size - in_chunk);
+			std::memset(_chunks[position / chunk_size] + in_chunk, 0, n);
+			position += n;
+		}
+	}
+	return true;
+}
+
+void Spilling_file::_release(std::size_t keep) noexcept
+{
+	while (_chunks.size() > keep) {
+		_arena->deallocate(_chunks.back());
+		_chunks.pop_back();
+	}
+}
+
+void Spilling_file::_spill()
+{
+	auto file             = _open();
+	const auto chunk_size = _arena->chunk_size();
+	try {
+		for (std::size_t i = 0; static_cast<sqlite3_int64>(i * chunk_size) < _size; ++i) {
+			const auto n = std::min(static_cast<std::size_t>(_size) - i * chunk_size, chunk_size);
+			file->write({ _chunks[i], n }, static_cast<sqlite3_int64>(i * chunk_size));
+		}
+	} catch (...) {
+		try {
+			file->close();
+		} catch (...) {
+		}
+		throw;
+	}
+
+	_spilled = std::move(file);
+	_release(0);
+	_arena->record_spill();
+}
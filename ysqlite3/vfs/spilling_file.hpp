@@ -0,0 +1,72 @@
+#ifndef YSQLITE3_VFS_SPILLING_FILE_HPP_
+#define YSQLITE3_VFS_SPILLING_FILE_HPP_
+
+#include "file.hpp"
+#include "memory_arena.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * A private temporary file kept in the chunks of a Memory_arena. When the arena has no chunk left, the
+ * content is moved to a file opened with the given function and all further calls are forwarded to it.
+ */
+class Spilling_file : public File
+{
+public:
+	typedef std::function<std::unique_ptr<File>()> Opener;
+
+	/**
+	 * Constructor.
+	 *
+	 * @param name the name of the file; usually `nullptr`
+	 * @param format the format
+	 * @param arena the arena
+	 * @param open opens the file on disk
+	 */
+	Spilling_file(const char* name, File_format format, std::shared_ptr<Memory_arena> arena,
+	              Opener open) noexcept;
+	~Spilling_file();
+	void close() override;
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override;
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override;
+	void truncate(sqlite3_int64 size) override;
+	void sync(Sync_flag flag) override;
+	sqlite3_int64 file_size() const override;
+	void lock(Lock_flag flag) override;
+	void unlock(Lock_flag flag) override;
+	bool has_reserved_lock() const override;
+	void file_control(File_control operation, void* arg) override;
+	int sector_size() const noexcept override;
+	int device_characteristics() const noexcept override;
+	void shm_map(int page, int page_size, bool is_write, void volatile** mapped_memory) override;
+	void shm_lock(int offset, int n, int flags) override;
+	void shm_barrier() noexcept override;
+	void shm_unmap(int delete_flag) override;
+	void fetch(sqlite3_int64 offset, int amount, void** buffer) override;
+	void unfetch(sqlite3_int64 offset, void* buffer) override;
+	/// Returns `true` if the file was moved to disk.
+	bool spilled() const noexcept;
+
+private:
+	std::shared_ptr<Memory_arena> _arena;
+	Opener _open;
+	std::vector<std::uint8_t*> _chunks;
+	sqlite3_int64 _size = 0;
+	std::unique_ptr<File> _spilled;
+
+	/// Makes sure that the chunks cover `size` bytes; returns `false` if the arena is exhausted.
+	bool _reserve(sqlite3_int64 size);
+	void _release(std::size_t keep) noexcept;
+	void _spill();
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
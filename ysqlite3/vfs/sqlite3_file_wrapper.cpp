@@ -3,8 +3,51 @@
 #include "../error.hpp"
 #include "../finally.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+#	include <sys/stat.h>
+#endif
+
 using namespace ysqlite3::vfs;
 
+namespace {
+
+/// The leading members of `unixFile` of the unix VFS which are the same in all SQLite3 versions.
+struct Unix_file
+{
+	const sqlite3_io_methods* methods;
+	sqlite3_vfs* vfs;
+	void* inode;
+	int fd;
+};
+
+/**
+ * Returns the file descriptor of a file of the built-in unix VFS or -1. The layout of `unixFile` is not
+ * public, so the descriptor is only trusted if it refers to the file `name`.
+ */
+int unix_file_descriptor(const char* name, const sqlite3_file* file, const sqlite3_vfs* vfs) noexcept
+{
+#if defined(__unix__) || defined(__APPLE__)
+	// all built-in unix VFSs share their xOpen; wrappers and custom VFSs do not
+	const auto unix_vfs = sqlite3_vfs_find("unix");
+	if (!name || !vfs || !unix_vfs || vfs->xOpen != unix_vfs->xOpen || !file->pMethods) {
+		return -1;
+	}
+
+	const auto unix_file = reinterpret_cast<const Unix_file*>(file);
+	struct stat opened;
+	struct stat named;
+	if (unix_file->vfs != vfs || unix_file->fd < 0 || fstat(unix_file->fd, &opened) || stat(name, &named) ||
+	    opened.st_dev != named.st_dev || opened.st_ino != named.st_ino) {
+		return -1;
+	}
+	return unix_file->fd;
+#else
+	return -1;
+#endif
+}
+
+} // namespace
+
 inline void assert_error(int ec)
 {
 	if (ec) {
@@ -13,16 +56,24 @@ inline void assert_error(int ec)
 }
 
 SQLite3_file_wrapper::SQLite3_file_wrapper(const char* name, File_format format,
-                                           std::shared_ptr<sqlite3_file> parent) noexcept
+                                           std::shared_ptr<sqlite3_file> parent, sqlite3_vfs* vfs) noexcept
     : File{ name, format }, _parent{ std::move(parent) }
-{}
+{
+	_native_handle = unix_file_descriptor(name, _parent.get(), vfs);
+
+	if (format == File_format::main_db || format == File_format::wal) {
+		_chunk_size               = sqlite3_uri_int64(name, "chunk_size", 0);
+		_background_preallocation = sqlite3_uri_boolean(name, "background_preallocation", 0);
+	}
+}
 
 void SQLite3_file_wrapper::close()
 {
 #if PRINT_DEBUG
 	printf("closing file: %s\n", name_of(format));
 #endif
-	const auto _ = finally([this] { _parent = nullptr; });
+	_preallocator = nullptr;
+	const auto _  = finally([this] { _parent = nullptr; });
 	assert_error(_parent->pMethods->xClose(_parent.get()));
 }
 
@@ -34,6 +85,9 @@ void SQLite3_file_wrapper::read(Span<std::uint8_t*> buffer, sqlite3_int64 offset
 
 void SQLite3_file_wrapper::write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset)
 {
+	if (const auto preallocator = _get_preallocator()) {
+		preallocator->grow(offset + static_cast<sqlite3_int64>(buffer.size()));
+	}
 	assert_error(
 	    _parent->pMethods->xWrite(_parent.get(), buffer.begin(), static_cast<int>(buffer.size()), offset));
 }
@@ -41,6 +95,9 @@ void SQLite3_file_wrapper::write(Span<const std::uint8_t*> buffer, sqlite3_int64
 void SQLite3_file_wrapper::truncate(sqlite3_int64 size)
 {
 	assert_error(_parent->pMethods->xTruncate(_parent.get(), size));
+	if (_preallocator) {
+		_preallocator->release(size);
+	}
 }
 
 void SQLite3_file_wrapper::sync(Sync_flag flag)
@@ -74,6 +131,29 @@ bool SQLite3_file_wrapper::has_reserved_lock() const
 
 void SQLite3_file_wrapper::file_control(File_control operation, void* arg)
 {
+	if (_native_handle != -1 && (format == File_format::main_db || format == File_format::wal)) {
+		switch (operation) {
+		case File_control::chunk_size:
+			_chunk_size = *static_cast<int*>(arg);
+			if (_preallocator) {
+				_preallocator->set_chunk_size(_chunk_size);
+			}
+			// without support the parent extends the file in chunks like before
+			if (const auto preallocator = _get_preallocator()) {
+				if (preallocator->supported()) {
+					return;
+				}
+			}
+			break;
+		case File_control::size_hint:
+			// the parent still grows its memory map
+			if (const auto preallocator = _get_preallocator()) {
+				preallocator->reserve(*static_cast<sqlite3_int64*>(arg));
+			}
+			break;
+		default: break;
+		}
+	}
 	assert_error(_parent->pMethods->xFileControl(_parent.get(), static_cast<int>(operation), arg));
 }
 
@@ -117,3 +197,16 @@ void SQLite3_file_wrapper::unfetch(sqlite3_int64 offset, void* buffer)
 {
 	assert_error(_parent->pMethods->xUnfetch(_parent.get(), offset, buffer));
 }
+
+int SQLite3_file_wrapper::native_handle() const noexcept
+{
+	return _native_handle;
+}
+
+Preallocator* SQLite3_file_wrapper::_get_preallocator()
+{
+	if (!_preallocator && _chunk_size > 0 && _native_handle != -1) {
+		_preallocator.reset(new Preallocator{ _native_handle, _chunk_size, _background_preallocation });
+	}
+	return _preallocator.get();
+}
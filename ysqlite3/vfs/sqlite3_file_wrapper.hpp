@@ -3,17 +3,37 @@
 
 #include "../sqlite3.h"
 #include "file.hpp"
+#include "preallocator.hpp"
 
 #include <memory>
 
 namespace ysqlite3 {
 namespace vfs {
 
-/// Wraps a standard file implementation from SQLite3 into the File interface.
+/**
+ * Wraps a standard file implementation from SQLite3 into the File interface.
+ *
+ * If the parent is a file of the unix VFS on Linux and the file system supports `fallocate()`, the main
+ * database and the WAL handle File_control::chunk_size themselves and reserve the space for
+ * File_control::size_hint before forwarding it. Instead of extending the file like SQLite3 does, the space is
+ * reserved without changing the file size; see Preallocator.
+ * The chunk size can also be set with the URI parameter `chunk_size` (in bytes) and the URI parameter
+ * `background_preallocation` reserves the next chunk on a background thread. Reserved space beyond the end
+ * of the file is released when the file is truncated.
+ */
 class SQLite3_file_wrapper : public File
 {
 public:
-	SQLite3_file_wrapper(const char* name, File_format format, std::shared_ptr<sqlite3_file> parent) noexcept;
+	/**
+	 * Constructor.
+	 *
+	 * @param name the name of the file
+	 * @param format the format of the file
+	 * @param parent the opened file
+	 * @param vfs (opt) the VFS which opened the parent; required for the native handle
+	 */
+	SQLite3_file_wrapper(const char* name, File_format format, std::shared_ptr<sqlite3_file> parent,
+	                     sqlite3_vfs* vfs = nullptr) noexcept;
 	void close() override;
 	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override;
 	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override;
@@ -32,9 +52,18 @@ public:
 	void shm_unmap(int delete_flag) override;
 	void fetch(sqlite3_int64 offset, int amount, void** buffer) override;
 	void unfetch(sqlite3_int64 offset, void* buffer) override;
+	/// Returns the file descriptor of the parent if it is a file of the unix VFS, otherwise -1.
+	int native_handle() const noexcept override;
 
 private:
 	std::shared_ptr<sqlite3_file> _parent;
+	int _native_handle             = -1;
+	sqlite3_int64 _chunk_size      = 0;
+	bool _background_preallocation = false;
+	std::unique_ptr<Preallocator> _preallocator;
+
+	/// Returns the preallocator if preallocation is enabled.
+	Preallocator* _get_preallocator();
 };
 
 } // namespace vfs
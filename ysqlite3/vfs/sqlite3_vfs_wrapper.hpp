@@ -37,7 +37,7 @@ public:
 		    reinterpret_cast<sqlite3_file*>(new std::uint8_t[_parent->szOsFile]{}),
 		    [](sqlite3_file* x) { delete[] reinterpret_cast<std::uint8_t*>(x); });
 		_assert_error(_parent->xOpen(_parent, name, tmp_file.get(), flags, &output_flags));
-		std::unique_ptr<File> tmp{ new DerivedFile{ name, format, std::move(tmp_file) } };
+		std::unique_ptr<File> tmp{ new DerivedFile{ name, format, std::move(tmp_file), _parent } };
 #if PRINT_DEBUG
 		printf("opening new file (%s) '%s' done\n", name_of(format), name);
 #endif
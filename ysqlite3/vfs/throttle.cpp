@@ -0,0 +1,126 @@
+#include "throttle.hpp"
+
+#include <algorithm>
+#include <map>
+
+using namespace ysqlite3::vfs;
+
+namespace {
+
+std::mutex registry_mutex;
+std::map<std::string, std::weak_ptr<Throttle>> registry;
+
+} // namespace
+
+void Token_bucket::set_rate(std::uint64_t rate)
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_refill(Clock::now());
+		_rate = rate;
+		if (!rate) {
+			_tokens = 0;
+		}
+	}
+	_condition.notify_all();
+}
+
+std::uint64_t Token_bucket::rate() const noexcept
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	return _rate;
+}
+
+std::chrono::nanoseconds Token_bucket::acquire(std::uint64_t amount)
+{
+	std::unique_lock<std::mutex> lock{ _mutex };
+	if (!_rate) {
+		return {};
+	}
+
+	const auto start = Clock::now();
+	auto waited      = false;
+	_refill(start);
+	_tokens -= static_cast<double>(amount);
+	while (_rate && _tokens < 0) {
+		const auto debt = std::chrono::duration<double>{ -_tokens / static_cast<double>(_rate) };
+		_condition.wait_for(lock, debt);
+		_refill(Clock::now());
+		waited = true;
+	}
+	if (!_rate) {
+		_tokens = 0;
+	}
+	return waited ? Clock::now() - start : std::chrono::nanoseconds{};
+}
+
+void Token_bucket::_refill(Clock::time_point now) noexcept
+{
+	if (_rate) {
+		const auto burst   = std::max(static_cast<double>(_rate) / 10, 1.0);
+		const auto elapsed = std::chrono::duration<double>{ now - _last }.count();
+		_tokens            = std::min(_tokens + elapsed * static_cast<double>(_rate), burst);
+	}
+	_last = now;
+}
+
+std::shared_ptr<Throttle> Throttle::attach(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock{ registry_mutex };
+	auto& entry   = registry[name];
+	auto throttle = entry.lock();
+	if (!throttle) {
+		throttle = std::make_shared<Throttle>();
+		entry    = throttle;
+	}
+
+	// drop the throttles of closed databases
+	for (auto i = registry.begin(); i != registry.end();) {
+		if (i->second.expired()) {
+			i = registry.erase(i);
+		} else {
+			++i;
+		}
+	}
+	return throttle;
+}
+
+void Throttle::set_bytes_per_second(std::uint64_t rate)
+{
+	_bytes.set_rate(rate);
+}
+
+void Throttle::set_operations_per_second(std::uint64_t rate)
+{
+	_operations.set_rate(rate);
+}
+
+void Throttle::set_throttle_class(Throttle_class value) noexcept
+{
+	_class.store(value, std::memory_order_relaxed);
+}
+
+Throttle_class Throttle::throttle_class() const noexcept
+{
+	return _class.load(std::memory_order_relaxed);
+}
+
+void Throttle::acquire(std::uint64_t bytes)
+{
+	const auto waited = _operations.acquire(1) + (bytes ? _bytes.acquire(bytes) : std::chrono::nanoseconds{});
+	if (waited.count()) {
+		_throttled.fetch_add(1, std::memory_order_relaxed);
+		_waited.fetch_add(waited.count(), std::memory_order_relaxed);
+	}
+}
+
+Throttle_status Throttle::status() const noexcept
+{
+	const std::chrono::nanoseconds waited{ _waited.load(std::memory_order_relaxed) };
+	Throttle_status status;
+	status.bytes_per_second      = _bytes.rate();
+	status.operations_per_second = _operations.rate();
+	status.throttled             = _throttled.load(std::memory_order_relaxed);
+	status.waited                = std::chrono::duration_cast<std::chrono::microseconds>(waited);
+	return status;
+}
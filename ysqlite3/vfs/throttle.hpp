@@ -0,0 +1,99 @@
+#ifndef YSQLITE3_VFS_THROTTLE_HPP_
+#define YSQLITE3_VFS_THROTTLE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * A token bucket which refills with a constant rate. Callers take their tokens immediately and wait until the
+ * bucket is no longer in debt, so requests larger than the burst size are paced as well. Changing the rate
+ * wakes all waiting callers. All methods are thread-safe.
+ */
+class Token_bucket
+{
+public:
+	/**
+	 * Sets the rate; 0 disables the bucket. The burst size is a tenth of the rate.
+	 *
+	 * @param rate the tokens per second
+	 */
+	void set_rate(std::uint64_t rate);
+	std::uint64_t rate() const noexcept;
+	/**
+	 * Takes tokens and waits until they are available.
+	 *
+	 * @param amount the tokens
+	 * @return the time spent waiting
+	 */
+	std::chrono::nanoseconds acquire(std::uint64_t amount);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _condition;
+	std::uint64_t _rate = 0;
+	double _tokens      = 0;
+	Clock::time_point _last;
+
+	void _refill(Clock::time_point now) noexcept;
+};
+
+enum class Throttle_class
+{
+	/// Never waits.
+	foreground,
+	/// Paced by the limits.
+	background
+};
+
+struct Throttle_status
+{
+	std::uint64_t bytes_per_second      = 0;
+	std::uint64_t operations_per_second = 0;
+	/// The operations which had to wait.
+	std::uint64_t throttled = 0;
+	std::chrono::microseconds waited{ 0 };
+};
+
+/**
+ * The byte and operation limits of a connection or a database. Throttles are shared by name within the
+ * process. All methods are thread-safe.
+ */
+class Throttle
+{
+public:
+	/// Returns the throttle with the name; throttles are released with their last user.
+	static std::shared_ptr<Throttle> attach(const std::string& name);
+	void set_bytes_per_second(std::uint64_t rate);
+	void set_operations_per_second(std::uint64_t rate);
+	void set_throttle_class(Throttle_class value) noexcept;
+	Throttle_class throttle_class() const noexcept;
+	/**
+	 * Waits until the operation is allowed.
+	 *
+	 * @param bytes the bytes transferred by the operation
+	 */
+	void acquire(std::uint64_t bytes);
+	Throttle_status status() const noexcept;
+
+private:
+	Token_bucket _bytes;
+	Token_bucket _operations;
+	std::atomic<Throttle_class> _class{ Throttle_class::background };
+	std::atomic<std::uint64_t> _throttled{ 0 };
+	std::atomic<std::chrono::nanoseconds::rep> _waited{ 0 };
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef YSQLITE3_VFS_THROTTLED_FILE_HPP_
+#define YSQLITE3_VFS_THROTTLED_FILE_HPP_
+
+#include "../error.hpp"
+#include "file.hpp"
+#include "throttle.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Paces the reads, writes and syncs of background connections with token buckets for bytes and operations,
+ * so jobs like `VACUUM`, backups or bulk imports leave bandwidth for latency-sensitive connections.
+ *
+ * Every connection has its own limits and shares the limits of its database with all other connections to
+ * the same database in this process; an operation waits for both. The main database, its journal and its
+ * WAL are throttled together. Only connections of the class `background` are paced; `foreground`
+ * connections are never delayed.
+ *
+ * The limits are set with the URI parameters or at runtime with the pragmas of the same name:
+ *   - `throttle_bytes`, `throttle_ops`: bytes and operations per second of this connection
+ *   - `throttle_database_bytes`, `throttle_database_ops`: bytes and operations per second of the database
+ *   - `throttle_class`: `background` (default) or `foreground`
+ *
+ * Without a value the pragmas return the current setting and a limit of 0 disables it. `PRAGMA
+ * throttle_status` returns the class and the time spent waiting.
+ *
+ * @note In rollback journal mode locks are held while waiting; use WAL to keep readers unaffected.
+ */
+template<typename Parent>
+class Throttled_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	template<typename... Args>
+	Throttled_file(Args&&... args) : Parent{ std::forward<Args>(args)... }
+	{
+		if (!this->name || (this->format != File_format::main_db && this->format != File_format::main_journal &&
+		                    this->format != File_format::wal)) {
+			return;
+		}
+
+		// all files of a connection share the database name pointer of the pager
+		const auto database =
+		    this->format == File_format::main_db ? this->name : sqlite3_filename_database(this->name);
+		char connection[48];
+		sqlite3_snprintf(sizeof(connection), connection, "connection:%p", static_cast<const void*>(database));
+		_connection = Throttle::attach(connection);
+		_database   = Throttle::attach(std::string{ "database:" } + database);
+
+		// journals and WALs use the limits set by the main database
+		if (this->format == File_format::main_db) {
+			for (const auto setting : settings) {
+				const auto value = sqlite3_uri_parameter(this->name, setting);
+				if (value) {
+					_set(setting, value);
+				}
+			}
+		}
+	}
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		_throttle(buffer.size());
+		Parent::read(buffer, offset);
+	}
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		_throttle(buffer.size());
+		Parent::write(buffer, offset);
+	}
+	void sync(Sync_flag flag) override
+	{
+		_throttle(0);
+		Parent::sync(flag);
+	}
+	void file_control(File_control operation, void* arg) override
+	{
+		if (_connection && operation == File_control::pragma) {
+			const auto name = static_cast<char**>(arg)[1];
+			if (!sqlite3_stricmp(name, "throttle_status")) {
+				const auto connection = _connection->status();
+				const auto database   = _database->status();
+				set_pragma_result(
+				    arg, sqlite3_mprintf("class=%s throttled=%llu waited_us=%lld database_throttled=%llu "
+				                         "database_waited_us=%lld",
+				                         _class_name(), static_cast<unsigned long long>(connection.throttled),
+				                         static_cast<long long>(connection.waited.count()),
+				                         static_cast<unsigned long long>(database.throttled),
+				                         static_cast<long long>(database.waited.count())));
+				return;
+			}
+			for (const auto setting : settings) {
+				if (!sqlite3_stricmp(name, setting)) {
+					const auto value = pragma_value(arg);
+					if (value) {
+						_set(setting, value);
+					}
+					set_pragma_result(arg, _get(setting));
+					return;
+				}
+			}
+		}
+		Parent::file_control(operation, arg);
+	}
+
+private:
+	constexpr static const char* settings[] = { "throttle_bytes", "throttle_ops", "throttle_database_bytes",
+		                                        "throttle_database_ops", "throttle_class" };
+
+	/// Shared by all files of the connection.
+	std::shared_ptr<Throttle> _connection;
+	/// Shared by all connections to the database.
+	std::shared_ptr<Throttle> _database;
+
+	void _throttle(std::size_t bytes)
+	{
+		if (_connection && _connection->throttle_class() == Throttle_class::background) {
+			_connection->acquire(bytes);
+			_database->acquire(bytes);
+		}
+	}
+	const char* _class_name() const noexcept
+	{
+		return _connection->throttle_class() == Throttle_class::background ? "background" : "foreground";
+	}
+	/**
+	 * Changes a setting.
+	 *
+	 * @exception std::system_error if the value is invalid
+	 * @param setting one of `settings`
+	 * @param value the new value
+	 */
+	void _set(const char* setting, const char* value)
+	{
+		if (setting == settings[4]) {
+			if (!sqlite3_stricmp(value, "background")) {
+				_connection->set_throttle_class(Throttle_class::background);
+			} else if (!sqlite3_stricmp(value, "foreground")) {
+				_connection->set_throttle_class(Throttle_class::foreground);
+			} else {
+				throw std::system_error{ SQLite3_code::library_misuse, "bad throttle class" };
+			}
+			return;
+		}
+
+		char* end        = nullptr;
+		const auto rate  = std::strtoull(value, &end, 0);
+		const auto& used = setting == settings[0] || setting == settings[1] ? _connection : _database;
+		if (end == value || *end || *value == '-') {
+			throw std::system_error{ SQLite3_code::library_misuse, "bad throttle rate" };
+		} else if (setting == settings[0] || setting == settings[2]) {
+			used->set_bytes_per_second(rate);
+		} else {
+			used->set_operations_per_second(rate);
+		}
+	}
+	char* _get(const char* setting) const
+	{
+		if (setting == settings[4]) {
+			return sqlite3_mprintf("%s", _class_name());
+		}
+
+		const auto status = (setting == settings[0] || setting == settings[1] ? _connection : _database)->status();
+		const auto rate   = setting == settings[0] || setting == settings[2] ? status.bytes_per_second
+		                                                                     : status.operations_per_second;
+		return sqlite3_mprintf("%llu", static_cast<unsigned long long>(rate));
+	}
+};
+
+template<typename Parent>
+constexpr const char* Throttled_file<Parent>::settings[];
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
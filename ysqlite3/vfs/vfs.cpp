@@ -83,7 +83,7 @@ int delete_(sqlite3_vfs* vfs, const char* name, int sync_directory) noexcept
 	return wrap([&] { self(vfs)->delete_file(name, static_cast<bool>(sync_directory)); });
 }
 
-int access(sqlite3_vfs* vfs, const char* name, int flags, int* result) noexcept
+int access_(sqlite3_vfs* vfs, const char* name, int flags, int* result) noexcept
 {
 	return wrap([&] {
 		Access_flag flag;
@@ -136,7 +136,7 @@ int random_bytes(sqlite3_vfs* vfs, int size, char* buffer) noexcept
 	return self(vfs)->random({ reinterpret_cast<std::uint8_t*>(buffer), static_cast<std::size_t>(size) });
 }
 
-int sleep(sqlite3_vfs* vfs, int microseconds) noexcept
+int sleep_(sqlite3_vfs* vfs, int microseconds) noexcept
 {
 	return self(vfs)->sleep(Sleep_duration{ microseconds }).count();
 }
@@ -186,14 +186,14 @@ VFS::VFS(const char* name) : _name{ name }, _vfs{}
 	// set functions
 	_vfs.xOpen         = &::open;
 	_vfs.xDelete       = &::delete_;
-	_vfs.xAccess       = &::access;
+	_vfs.xAccess       = &::access_;
 	_vfs.xFullPathname = &::full_pathname;
 	_vfs.xDlOpen       = &::dlopen; // for extensions
 	_vfs.xDlError      = &::dlerror;
 	_vfs.xDlSym        = &::dlsym;
 	_vfs.xDlClose      = &::dlclose;
 	_vfs.xRandomness   = &::random_bytes;
-	_vfs.xSleep        = &::sleep;
+	_vfs.xSleep        = &::sleep_;
 	_vfs.xCurrentTime  = &::current_time;
 	_vfs.xGetLastError = &::last_error;
 
@@ -0,0 +1,531 @@
+#include "wal_follower.hpp"
+
+#include "../error.hpp"
+#include "../finally.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <set>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <cerrno>
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <sys/socket.h>
+#	include <sys/un.h>
+#	include <unistd.h>
+#endif
+
+using namespace ysqlite3;
+using namespace ysqlite3::vfs;
+
+namespace {
+
+typedef std::unique_ptr<sqlite3_file, void (*)(sqlite3_file*)> File_handle;
+
+constexpr int database_header_size = 100;
+constexpr std::uint8_t journal_magic[] = { 0xd9, 0xd5, 0x05, 0xf9, 0x20, 0xa1, 0x63, 0xd7 };
+
+inline std::system_error errno_error()
+{
+	return std::system_error{ errno, std::generic_category() };
+}
+
+inline void check(int ec)
+{
+	if (ec != SQLITE_OK) {
+		throw std::system_error{ static_cast<SQLite3_code>(ec) };
+	}
+}
+
+void store(std::uint8_t* buffer, std::uint32_t value) noexcept
+{
+	for (int i = 0; i < 4; ++i) {
+		buffer[i] = static_cast<std::uint8_t>(value >> (24 - i * 8));
+	}
+}
+
+std::uint32_t load(const std::uint8_t* buffer) noexcept
+{
+	return static_cast<std::uint32_t>(buffer[0]) << 24 | static_cast<std::uint32_t>(buffer[1]) << 16 |
+	       static_cast<std::uint32_t>(buffer[2]) << 8 | buffer[3];
+}
+
+std::uint32_t load_little(const std::uint8_t* buffer) noexcept
+{
+	return static_cast<std::uint32_t>(buffer[3]) << 24 | static_cast<std::uint32_t>(buffer[2]) << 16 |
+	       static_cast<std::uint32_t>(buffer[1]) << 8 | buffer[0];
+}
+
+std::uint64_t now() noexcept
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+	                                      std::chrono::system_clock::now().time_since_epoch())
+	                                      .count());
+}
+
+void close_file(sqlite3_file* file) noexcept
+{
+	if (file->pMethods) {
+		file->pMethods->xClose(file);
+	}
+	sqlite3_free(file);
+}
+
+/**
+ * A rollback journal in the format of SQLite. It keeps the old content of the pages of the replica, so if the
+ * process dies while the replica is written, SQLite finds a hot journal and restores the pages the next time
+ * the replica is opened.
+ */
+class Rollback_journal
+{
+public:
+	/**
+	 * Creates the journal `<replica>-journal`. The caller must hold an exclusive lock of the replica.
+	 *
+	 * @exception std::system_error if the journal could not be created
+	 * @param database the replica
+	 * @param file the main database file of the replica
+	 * @param page_size the page size of the replica
+	 */
+	Rollback_journal(sqlite3* database, sqlite3_file* file, std::uint32_t page_size)
+	    : _database_file{ file }, _page_size{ page_size }, _file{ nullptr, &close_file }
+	{
+		sqlite3_int64 size = 0;
+		check(file->pMethods->xFileSize(file, &size));
+		_page_count = static_cast<std::uint32_t>(size / page_size);
+		check(sqlite3_file_control(database, "main", SQLITE_FCNTL_VFS_POINTER, &_vfs));
+		_name = sqlite3_filename_journal(sqlite3_db_filename(database, "main"));
+		if (!_vfs || !_name) {
+			throw std::system_error{ SQLite3_code::bad_database };
+		}
+
+		// the header fills one sector
+		const auto sector_size = file->pMethods->xSectorSize ? file->pMethods->xSectorSize(file) : 0;
+		_header.resize(sector_size < 32 ? 512 : std::min(sector_size, 65536));
+		sqlite3_randomness(sizeof(_checksum), &_checksum);
+		std::memcpy(_header.data(), journal_magic, sizeof(journal_magic));
+		store(_header.data() + 12, _checksum);
+		store(_header.data() + 16, _page_count);
+		store(_header.data() + 20, static_cast<std::uint32_t>(_header.size()));
+		store(_header.data() + 24, page_size);
+
+		_file.reset(static_cast<sqlite3_file*>(sqlite3_malloc(_vfs->szOsFile)));
+		if (!_file) {
+			throw std::system_error{ SQLite3_code::memory };
+		}
+		_file->pMethods = nullptr;
+		auto flags      = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_MAIN_JOURNAL;
+		check(_vfs->xOpen(_vfs, _name, _file.get(), flags, &flags));
+		_offset = static_cast<sqlite3_int64>(_header.size());
+		_write(_header.data(), _header.size(), 0);
+	}
+	Rollback_journal(const Rollback_journal& copy) = delete;
+	/// Removes the journal if the replica was not written yet; otherwise it stays hot.
+	~Rollback_journal()
+	{
+		if (_file && !_hot) {
+			_file.reset();
+			_vfs->xDelete(_vfs, _name, 0);
+		}
+	}
+	/**
+	 * Saves the old content of the page unless it is beyond the old end of the replica or already saved.
+	 *
+	 * @exception std::system_error if the journal could not be written
+	 * @param page the page number
+	 */
+	void save(std::uint32_t page)
+	{
+		if (page > _page_count || !_saved.insert(page).second) {
+			return;
+		}
+
+		// the page number, the page and a checksum of some bytes of the page
+		_buffer.resize(_page_size + 8);
+		store(_buffer.data(), page);
+		check(_database_file->pMethods->xRead(_database_file, _buffer.data() + 4, static_cast<int>(_page_size),
+		                                      static_cast<sqlite3_int64>(page - 1) * _page_size));
+		auto checksum = _checksum;
+		for (auto i = static_cast<int>(_page_size) - 200; i > 0; i -= 200) {
+			checksum += _buffer[4 + i];
+		}
+		store(_buffer.data() + 4 + _page_size, checksum);
+		_write(_buffer.data(), _buffer.size(), _offset);
+		_offset += static_cast<sqlite3_int64>(_buffer.size());
+	}
+	/**
+	 * Syncs the saved pages and then records their number in the header like SQLite does, so a torn journal
+	 * is never played back. The replica may be written afterwards.
+	 *
+	 * @exception std::system_error if the journal could not be written
+	 */
+	void make_hot()
+	{
+		check(_file->pMethods->xSync(_file.get(), SQLITE_SYNC_NORMAL));
+		store(_header.data() + 8, static_cast<std::uint32_t>(_saved.size()));
+		_write(_header.data(), _header.size(), 0);
+		check(_file->pMethods->xSync(_file.get(), SQLITE_SYNC_NORMAL));
+		_hot = true;
+	}
+	/**
+	 * Deletes the journal, which commits the changes. The replica must be synced before.
+	 *
+	 * @exception std::system_error if the journal could not be deleted
+	 */
+	void commit()
+	{
+		_file.reset();
+		check(_vfs->xDelete(_vfs, _name, 1));
+	}
+
+private:
+	sqlite3_file* _database_file;
+	std::uint32_t _page_size;
+	std::uint32_t _page_count = 0;
+	std::uint32_t _checksum   = 0;
+	sqlite3_vfs* _vfs         = nullptr;
+	const char* _name         = nullptr;
+	File_handle _file;
+	sqlite3_int64 _offset = 0;
+	bool _hot             = false;
+	std::set<std::uint32_t> _saved;
+	std::vector<std::uint8_t> _header;
+	std::vector<std::uint8_t> _buffer;
+
+	void _write(const std::uint8_t* data, std::size_t size, sqlite3_int64 offset)
+	{
+		check(_file->pMethods->xWrite(_file.get(), data, static_cast<int>(size), offset));
+	}
+};
+
+} // namespace
+
+void Wal_source::seek(std::uint64_t)
+{}
+
+Directory_wal_source::Directory_wal_source(std::string directory, std::uint64_t first_sequence) noexcept
+    : _directory{ std::move(directory) }, _next{ first_sequence }
+{}
+
+bool Directory_wal_source::next(std::vector<std::uint8_t>& record)
+{
+	auto file = std::fopen((_directory + "/" + wal_record_name(_next)).c_str(), "rb");
+
+#if defined(__unix__) || defined(__APPLE__)
+	// records may have been removed; continue with the next one so that the follower sees the gap
+	if (!file) {
+		std::uint64_t next = 0;
+		if (const auto dir = opendir(_directory.c_str())) {
+			while (const auto entry = readdir(dir)) {
+				unsigned long long number = 0;
+				if (std::sscanf(entry->d_name, "%20llu.ywal", &number) == 1 && number > _next &&
+				    (!next || number < next)) {
+					next = number;
+				}
+			}
+			closedir(dir);
+		}
+		if (!next) {
+			return false;
+		}
+		_next = next;
+		file  = std::fopen((_directory + "/" + wal_record_name(_next)).c_str(), "rb");
+	}
+#endif
+
+	if (!file) {
+		return false;
+	}
+
+	const auto _ = finally([file] { std::fclose(file); });
+	record.clear();
+	std::uint8_t buffer[64 * 1024];
+	while (const auto n = std::fread(buffer, 1, sizeof(buffer), file)) {
+		record.insert(record.end(), buffer, buffer + n);
+	}
+	if (std::ferror(file)) {
+		throw std::system_error{ SQLite3_code::read };
+	}
+	++_next;
+	return true;
+}
+
+void Directory_wal_source::seek(std::uint64_t sequence)
+{
+	_next = sequence;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+Unix_socket_wal_source::Unix_socket_wal_source(std::string path) : _path{ std::move(path) }
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (_path.size() >= sizeof(address.sun_path)) {
+		throw std::system_error{ Error::bad_arguments, "socket path too long" };
+	}
+	std::memcpy(address.sun_path, _path.c_str(), _path.size() + 1);
+
+	unlink(_path.c_str());
+	_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (_socket == -1) {
+		throw errno_error();
+	} else if (bind(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) || listen(_socket, 4) ||
+	           fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL) | O_NONBLOCK)) {
+		const auto error = errno_error();
+		close(_socket);
+		throw error;
+	}
+}
+
+Unix_socket_wal_source::~Unix_socket_wal_source()
+{
+	if (_client != -1) {
+		close(_client);
+	}
+	close(_socket);
+	unlink(_path.c_str());
+}
+
+bool Unix_socket_wal_source::next(std::vector<std::uint8_t>& record)
+{
+	while (true) {
+		if (_client == -1) {
+			_client = accept(_socket, nullptr, nullptr);
+			if (_client == -1) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+					return false;
+				}
+				throw errno_error();
+			}
+			fcntl(_client, F_SETFL, fcntl(_client, F_GETFL) | O_NONBLOCK);
+			_buffer.clear();
+		}
+
+		Wal_record header;
+		if (_buffer.size() >= Wal_record::header_size) {
+			if (!header.decode_header({ _buffer.data(), _buffer.size() })) {
+				throw std::system_error{ SQLite3_code::corrupt };
+			} else if (_buffer.size() >= header.size()) {
+				record.assign(_buffer.begin(), _buffer.begin() + header.size());
+				_buffer.erase(_buffer.begin(), _buffer.begin() + header.size());
+				return true;
+			}
+		}
+
+		std::uint8_t buffer[64 * 1024];
+		const auto n = recv(_client, buffer, sizeof(buffer), 0);
+		if (n > 0) {
+			_buffer.insert(_buffer.end(), buffer, buffer + n);
+		} else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return false;
+		} else if (n == 0 || errno != EINTR) {
+			// the sink reconnects after a failure; the partial record is lost
+			close(_client);
+			_client = -1;
+			_buffer.clear();
+		}
+	}
+}
+
+#else
+
+Unix_socket_wal_source::Unix_socket_wal_source(std::string path) : _path{ std::move(path) }
+{
+	throw std::system_error{ Error::bad_arguments, "socket sources are not supported" };
+}
+
+Unix_socket_wal_source::~Unix_socket_wal_source()
+{}
+
+bool Unix_socket_wal_source::next(std::vector<std::uint8_t>&)
+{
+	return false;
+}
+
+#endif
+
+Wal_follower::Wal_follower(std::string replica, std::unique_ptr<Wal_source> source)
+    : _replica{ std::move(replica) }, _source{ std::move(source) }
+{
+	_database.open(_replica.c_str(), open_flag_readwrite);
+	_database.set_journal_mode(Journal_mode::delete_);
+	check(sqlite3_busy_timeout(_database.handle(), 5000));
+	_load_state();
+	_source->seek(_state.sequence + 1);
+}
+
+void Wal_follower::bootstrap(Database& primary, const std::string& replica)
+{
+	Database target{ replica.c_str() };
+	const auto backup = sqlite3_backup_init(target.handle(), "main", primary.handle(), "main");
+	if (!backup) {
+		throw std::system_error{ static_cast<SQLite3_code>(sqlite3_errcode(target.handle())) };
+	}
+	sqlite3_backup_step(backup, -1);
+	check(sqlite3_backup_finish(backup));
+	target.set_journal_mode(Journal_mode::delete_);
+	std::remove((replica + "-follower").c_str());
+}
+
+std::size_t Wal_follower::poll()
+{
+	std::size_t count = 0;
+	while (_source->next(_record)) {
+		Wal_record record;
+		if (!record.decode_header({ _record.data(), _record.size() }) || record.size() != _record.size()) {
+			throw std::system_error{ SQLite3_code::corrupt };
+		} else if (_state.sequence && record.sequence > _state.sequence + 1) {
+			_source->seek(_state.sequence + 1);
+			throw std::system_error{ Error::replication_gap };
+		}
+
+		// a lower sequence number means that the sink was restarted
+		_apply(record, _record.data() + Wal_record::header_size);
+		_state.sequence  = record.sequence;
+		_status.sequence = record.sequence;
+		++_status.records;
+		_save_state();
+		++count;
+	}
+	return count;
+}
+
+Replication_status Wal_follower::status() const noexcept
+{
+	return _status;
+}
+
+void Wal_follower::_apply(const Wal_record& record, const std::uint8_t* frames)
+{
+	if (record.type == Wal_record::Type::restart) {
+		_state.salts[0] = record.salts[0];
+		_state.salts[1] = record.salts[1];
+		_state.frame    = 0;
+		return;
+	}
+
+	// already applied
+	const auto last_frame = record.first_frame + record.frame_count - 1;
+	if (record.salts[0] == _state.salts[0] && record.salts[1] == _state.salts[1] &&
+	    last_frame <= _state.frame) {
+		return;
+	}
+
+	_database.execute("BEGIN EXCLUSIVE");
+	auto committed = false;
+	const auto _   = finally([&] {
+		if (!committed) {
+			sqlite3_exec(_database.handle(), "ROLLBACK", nullptr, nullptr, nullptr);
+		}
+	});
+
+	sqlite3_file* file = nullptr;
+	check(sqlite3_file_control(_database.handle(), "main", SQLITE_FCNTL_FILE_POINTER, &file));
+	if (!file || !file->pMethods) {
+		throw std::system_error{ SQLite3_code::bad_database };
+	}
+
+	sqlite3_int64 size = 0;
+	std::uint8_t header[database_header_size];
+	check(file->pMethods->xFileSize(file, &size));
+	if (size >= database_header_size) {
+		check(file->pMethods->xRead(file, header, sizeof(header), 0));
+		const auto page_size = header[16] << 8 | header[17];
+		if (static_cast<std::uint32_t>(page_size == 1 ? 65536 : page_size) != record.page_size) {
+			throw std::system_error{ SQLite3_code::corrupt, "page size of the replica does not match" };
+		}
+	}
+
+	// the pages are written directly, so the journal is written like SQLite would do it
+	Rollback_journal journal{ _database.handle(), file, record.page_size };
+	journal.save(1);
+	auto frame = frames;
+	for (std::uint32_t i = 0; i < record.frame_count; ++i, frame += 4 + record.page_size) {
+		const auto page = load_little(frame);
+		if (!page) {
+			throw std::system_error{ SQLite3_code::corrupt };
+		}
+		journal.save(page);
+	}
+	for (auto page = static_cast<std::uint64_t>(record.database_size) + 1;
+	     page <= static_cast<std::uint64_t>(size) / record.page_size; ++page) {
+		journal.save(static_cast<std::uint32_t>(page));
+	}
+	journal.make_hot();
+
+	frame = frames;
+	for (std::uint32_t i = 0; i < record.frame_count; ++i, frame += 4 + record.page_size) {
+		check(file->pMethods->xWrite(file, frame + 4, static_cast<int>(record.page_size),
+		                             static_cast<sqlite3_int64>(load_little(frame) - 1) * record.page_size));
+	}
+	check(file->pMethods->xTruncate(file, static_cast<sqlite3_int64>(record.database_size) * record.page_size));
+
+	// the replica uses a rollback journal and the change counter tells its readers to drop their cache
+	check(file->pMethods->xRead(file, header, sizeof(header), 0));
+	const auto counter = load(header + 24) + 1;
+	header[18]         = 1;
+	header[19]         = 1;
+	store(header + 24, counter);
+	store(header + 28, record.database_size);
+	store(header + 92, counter);
+	check(file->pMethods->xWrite(file, header, sizeof(header), 0));
+	check(file->pMethods->xSync(file, SQLITE_SYNC_NORMAL));
+	journal.commit();
+
+	_database.execute("COMMIT");
+	committed       = true;
+	_state.salts[0] = record.salts[0];
+	_state.salts[1] = record.salts[1];
+	_state.frame    = last_frame;
+
+	_status.last_commit = record.timestamp;
+	_status.lag         = std::chrono::microseconds{ static_cast<std::chrono::microseconds::rep>(now() -
+	                                                                                     record.timestamp) };
+}
+
+void Wal_follower::_load_state()
+{
+	const auto file = std::fopen((_replica + "-follower").c_str(), "r");
+	if (!file) {
+		return;
+	}
+
+	const auto _                = finally([file] { std::fclose(file); });
+	unsigned long long sequence = 0;
+	unsigned long salts[2]      = {};
+	unsigned long frame         = 0;
+	if (std::fscanf(file, "%llu %lu %lu %lu", &sequence, &salts[0], &salts[1], &frame) == 4) {
+		_state.sequence  = sequence;
+		_state.salts[0]  = static_cast<std::uint32_t>(salts[0]);
+		_state.salts[1]  = static_cast<std::uint32_t>(salts[1]);
+		_state.frame     = static_cast<std::uint32_t>(frame);
+		_status.sequence = _state.sequence;
+	}
+}
+
+void Wal_follower::_save_state()
+{
+	const auto path      = _replica + "-follower";
+	const auto temporary = path + ".tmp";
+	const auto file      = std::fopen(temporary.c_str(), "w");
+	if (!file) {
+		throw std::system_error{ SQLite3_code::bad_database };
+	}
+
+	const auto written =
+	    std::fprintf(file, "%llu %lu %lu %lu\n", static_cast<unsigned long long>(_state.sequence),
+	                 static_cast<unsigned long>(_state.salts[0]), static_cast<unsigned long>(_state.salts[1]),
+	                 static_cast<unsigned long>(_state.frame));
+	auto synced = !std::fflush(file);
+#if defined(__unix__) || defined(__APPLE__)
+	// the replica was synced before, so the progress never runs ahead of it
+	synced = synced && !fsync(fileno(file));
+#endif
+	if (std::fclose(file) || written < 0 || !synced || std::rename(temporary.c_str(), path.c_str())) {
+		throw std::system_error{ SQLite3_code::write };
+	}
+}
@@ -0,0 +1,150 @@
+#ifndef YSQLITE3_VFS_WAL_FOLLOWER_HPP_
+#define YSQLITE3_VFS_WAL_FOLLOWER_HPP_
+
+#include "../database.hpp"
+#include "wal_sink.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/// Produces the records shipped by a Wal_sink in order.
+class Wal_source
+{
+public:
+	virtual ~Wal_source() = default;
+	/**
+	 * Reads the next record if one is available. Does not block.
+	 *
+	 * @exception std::system_error if the source failed
+	 * @param[out] record the complete encoded record
+	 * @return `true` if a record was read
+	 */
+	virtual bool next(std::vector<std::uint8_t>& record) = 0;
+	/// Continues with the record `sequence`; sources which cannot seek ignore this.
+	virtual void seek(std::uint64_t sequence);
+};
+
+/// Reads the records written by Directory_wal_sink.
+class Directory_wal_source : public Wal_source
+{
+public:
+	Directory_wal_source(std::string directory, std::uint64_t first_sequence = 1) noexcept;
+	bool next(std::vector<std::uint8_t>& record) override;
+	void seek(std::uint64_t sequence) override;
+
+private:
+	std::string _directory;
+	std::uint64_t _next;
+};
+
+/**
+ * Listens on a Unix socket for the records of Unix_socket_wal_sink. A partial record of a connection which
+ * was closed is discarded.
+ */
+class Unix_socket_wal_source : public Wal_source
+{
+public:
+	/**
+	 * Constructor. An existing socket file is replaced.
+	 *
+	 * @exception std::system_error if the socket could not be created
+	 * @param path the path of the socket
+	 */
+	Unix_socket_wal_source(std::string path);
+	~Unix_socket_wal_source();
+	bool next(std::vector<std::uint8_t>& record) override;
+
+private:
+	std::string _path;
+	int _socket = -1;
+	int _client = -1;
+	std::vector<std::uint8_t> _buffer;
+};
+
+struct Replication_status
+{
+	/// The sequence number of the last applied record.
+	std::uint64_t sequence = 0;
+	/// The records applied by this follower.
+	std::uint64_t records = 0;
+	/// The commit time of the last applied transaction on the primary in microseconds since the epoch.
+	std::uint64_t last_commit = 0;
+	/// The time between the commit on the primary and its application to the replica.
+	std::chrono::microseconds lag{ 0 };
+};
+
+/**
+ * Applies the records shipped by Wal_shipping_file to a replica database. Every committed transaction is
+ * written page by page into the replica while holding an exclusive lock, so readers of the replica always see
+ * a consistent snapshot of the primary. The old pages are saved in a rollback journal before, so if the
+ * process dies in the middle, the next read-write connection to the replica rolls it back; read-only
+ * connections fail with `SQLITE_READONLY_ROLLBACK` until then. Records which were shipped again after a
+ * restart of the primary are skipped. The progress is stored next to the replica in `<replica>-follower`
+ * after the replica was synced.
+ *
+ * The replica must be a page by page copy of the primary made after shipping started, see bootstrap(); the
+ * replica uses a rollback journal and must not be written to by anyone else.
+ */
+class Wal_follower
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @exception std::system_error if the replica could not be opened
+	 * @param replica the path of the replica
+	 * @param source the source of the records
+	 */
+	Wal_follower(std::string replica, std::unique_ptr<Wal_source> source);
+	/**
+	 * Creates the replica from the primary with the backup API, which unlike `VACUUM INTO` keeps the page
+	 * numbers. Any progress of a previous follower of the replica is discarded.
+	 *
+	 * @exception std::system_error if the backup failed
+	 * @param primary the primary database
+	 * @param replica the path of the replica
+	 */
+	static void bootstrap(Database& primary, const std::string& replica);
+	/**
+	 * Applies all available records.
+	 *
+	 * @exception std::system_error
+	 *   - Error::replication_gap if records are missing; the replica must be bootstrapped again
+	 *   - SQLite3_code::corrupt if a record does not match the replica
+	 *   - if the replica could not be written
+	 * @return the number of applied records
+	 */
+	std::size_t poll();
+	Replication_status status() const noexcept;
+
+private:
+	struct State
+	{
+		std::uint64_t sequence = 0;
+		std::uint32_t salts[2] = {};
+		/// The last applied frame of the WAL generation identified by `salts`.
+		std::uint32_t frame = 0;
+	};
+
+	std::string _replica;
+	std::unique_ptr<Wal_source> _source;
+	Database _database;
+	State _state;
+	Replication_status _status;
+	std::vector<std::uint8_t> _record;
+
+	void _apply(const Wal_record& record, const std::uint8_t* frames);
+	void _load_state();
+	void _save_state();
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
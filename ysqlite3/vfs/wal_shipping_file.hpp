@@ -0,0 +1,291 @@
+#ifndef YSQLITE3_VFS_WAL_SHIPPING_FILE_HPP_
+#define YSQLITE3_VFS_WAL_SHIPPING_FILE_HPP_
+
+#include "file.hpp"
+#include "wal_sink.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Ships every committed transaction of the WAL to the sink given by the URI parameter `wal_sink`, for
+ * example `file:primary.db?layers=wal_shipping&wal_sink=dir:/var/replica`. Frames are collected until the
+ * commit frame is written and shipped as one Wal_record together with the salts and the checkpoint sequence
+ * of the WAL. A restart of the WAL is shipped as a record of its own. When the first connection of the
+ * process writes to an existing WAL, all committed transactions in it are shipped again, so nothing is lost
+ * if a process died before a record was delivered; Wal_follower skips frames it already applied. Every
+ * generation of the WAL is scanned only once per process, see Wal_sink::claim_generation().
+ *
+ * The status of the sink can be queried with `PRAGMA wal_shipping` on the main database.
+ *
+ * @warning All connections writing to the database must use this layer with the same sink.
+ */
+template<typename Parent>
+class Wal_shipping_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	template<typename... Args>
+	Wal_shipping_file(Args&&... args) : Parent{ std::forward<Args>(args)... }
+	{
+		const auto spec = sqlite3_uri_parameter(this->name, "wal_sink");
+		if (spec && (this->format == File_format::wal || this->format == File_format::main_db)) {
+			_sink = open_wal_sink(spec);
+		}
+	}
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		if (this->format != File_format::wal || !_sink) {
+			Parent::write(buffer, offset);
+			return;
+		} else if (!_scanned && offset) {
+			_scanned = true;
+			_scan();
+		} else if (_frames.empty() && offset) {
+			// another connection may have restarted the WAL
+			_read_header();
+		}
+
+		Parent::write(buffer, offset);
+
+		// a new header starts a new generation of the WAL
+		if (!offset) {
+			if (_parse_header(buffer)) {
+				_frames.clear();
+				_scanned = true;
+				_sink->claim_generation(_salts);
+				_ship_restart();
+			}
+			return;
+		}
+
+		const auto frame_size = _frame_size();
+		if (!_page_size || offset < header_size ||
+		    (offset - header_size) % frame_size + static_cast<sqlite3_int64>(buffer.size()) > frame_size) {
+			return;
+		}
+
+		const auto number   = static_cast<std::uint32_t>((offset - header_size) / frame_size + 1);
+		const auto position = static_cast<std::size_t>((offset - header_size) % frame_size);
+		auto& frame         = _frames[number];
+		frame.data.resize(static_cast<std::size_t>(frame_size));
+		std::memcpy(frame.data.data() + position, buffer.begin(), buffer.size());
+		frame.has_header = frame.has_header || !position;
+		frame.has_page   = frame.has_page || position + buffer.size() == frame.data.size();
+		if (_is_commit(frame)) {
+			_ship_commit(number);
+		}
+	}
+	void truncate(sqlite3_int64 size) override
+	{
+		Parent::truncate(size);
+		if (this->format == File_format::wal) {
+			_frames.clear();
+		}
+	}
+	void file_control(File_control operation, void* arg) override
+	{
+		if (_sink && is_pragma(operation, arg, "wal_shipping")) {
+			const auto status = _sink->status();
+			set_pragma_result(arg, sqlite3_mprintf("sequence=%llu records=%llu bytes=%llu dropped=%llu",
+			                                       static_cast<unsigned long long>(status.sequence),
+			                                       static_cast<unsigned long long>(status.records),
+			                                       static_cast<unsigned long long>(status.bytes),
+			                                       static_cast<unsigned long long>(status.dropped)));
+			return;
+		}
+		Parent::file_control(operation, arg);
+	}
+
+private:
+	struct Frame
+	{
+		std::vector<std::uint8_t> data;
+		bool has_header = false;
+		bool has_page   = false;
+	};
+
+	constexpr static sqlite3_int64 header_size       = 32;
+	constexpr static sqlite3_int64 frame_header_size = 24;
+
+	std::shared_ptr<Wal_sink> _sink;
+	/// The frames of the current transaction by frame number.
+	std::map<std::uint32_t, Frame> _frames;
+	bool _scanned             = false;
+	bool _big_endian          = false;
+	std::uint32_t _page_size  = 0;
+	std::uint32_t _checkpoint = 0;
+	std::uint32_t _salts[2]   = {};
+
+	/// Loads a big-endian integer.
+	static std::uint32_t _load(const std::uint8_t* data) noexcept
+	{
+		return static_cast<std::uint32_t>(data[0]) << 24 | static_cast<std::uint32_t>(data[1]) << 16 |
+		       static_cast<std::uint32_t>(data[2]) << 8 | data[3];
+	}
+	static std::uint32_t _load_little(const std::uint8_t* data) noexcept
+	{
+		return static_cast<std::uint32_t>(data[3]) << 24 | static_cast<std::uint32_t>(data[2]) << 16 |
+		       static_cast<std::uint32_t>(data[1]) << 8 | data[0];
+	}
+	/// Continues the checksum of SQLite's WAL format.
+	void _checksum(const std::uint8_t* data, std::size_t size, std::uint32_t* sum) const noexcept
+	{
+		const auto load = _big_endian ? &_load : &_load_little;
+		for (std::size_t i = 0; i + 8 <= size; i += 8) {
+			sum[0] += load(data + i) + sum[1];
+			sum[1] += load(data + i + 4) + sum[0];
+		}
+	}
+	sqlite3_int64 _frame_size() const noexcept
+	{
+		return frame_header_size + _page_size;
+	}
+	bool _is_commit(const Frame& frame) const noexcept
+	{
+		return frame.has_header && frame.has_page && _load(frame.data.data() + 4) &&
+		       _load(frame.data.data() + 8) == _salts[0] && _load(frame.data.data() + 12) == _salts[1];
+	}
+	bool _parse_header(Span<const std::uint8_t*> header) noexcept
+	{
+		if (header.size() < header_size) {
+			return false;
+		}
+
+		const auto data  = header.begin();
+		const auto magic = _load(data);
+		if ((magic & ~1u) != 0x377f0682) {
+			return false;
+		}
+		_big_endian = magic & 1;
+		_page_size  = _load(data + 8);
+		_checkpoint = _load(data + 12);
+		_salts[0]   = _load(data + 16);
+		_salts[1]   = _load(data + 20);
+		return true;
+	}
+	void _read_header()
+	{
+		std::uint8_t header[header_size];
+		if (Parent::file_size() >= header_size) {
+			Parent::read({ header, sizeof(header) }, 0);
+			_parse_header({ header, sizeof(header) });
+		}
+	}
+	/// Ships the committed transactions which are already in the WAL.
+	void _scan()
+	{
+		std::uint8_t header[header_size];
+		const auto size = Parent::file_size();
+		if (size < header_size) {
+			return;
+		}
+		Parent::read({ header, sizeof(header) }, 0);
+		if (!_parse_header({ header, sizeof(header) })) {
+			return;
+		}
+		std::uint32_t sum[2] = {};
+		_checksum(header, 24, sum);
+		if (sum[0] != _load(header + 24) || sum[1] != _load(header + 28) || !_sink->claim_generation(_salts)) {
+			return;
+		}
+
+		Frame frame;
+		frame.data.resize(static_cast<std::size_t>(_frame_size()));
+		frame.has_header = true;
+		frame.has_page   = true;
+		for (std::uint32_t number = 1;; ++number) {
+			const auto offset = header_size + (number - 1) * _frame_size();
+			if (offset + _frame_size() > size) {
+				break;
+			}
+
+			Parent::read({ frame.data.data(), frame.data.size() }, offset);
+			const auto data = frame.data.data();
+			_checksum(data, 8, sum);
+			_checksum(data + frame_header_size, _page_size, sum);
+			if (_load(data + 8) != _salts[0] || _load(data + 12) != _salts[1] || sum[0] != _load(data + 16) ||
+			    sum[1] != _load(data + 20)) {
+				break;
+			}
+			_frames[number] = frame;
+			if (_is_commit(frame)) {
+				_ship_commit(number);
+			}
+		}
+		_frames.clear();
+	}
+	void _ship_restart()
+	{
+		Wal_record record;
+		record.type       = Wal_record::Type::restart;
+		record.timestamp  = _now();
+		record.checkpoint = _checkpoint;
+		record.salts[0]   = _salts[0];
+		record.salts[1]   = _salts[1];
+		record.page_size  = _page_size;
+
+		std::vector<std::uint8_t> data(record.size());
+		record.encode_header({ data.data(), data.size() });
+		_sink->ship({ data.data(), data.size() });
+	}
+	/// Ships all frames up to the commit frame; later frames belong to a transaction that was rolled back.
+	void _ship_commit(std::uint32_t commit)
+	{
+		Wal_record record;
+		record.timestamp     = _now();
+		record.checkpoint    = _checkpoint;
+		record.salts[0]      = _salts[0];
+		record.salts[1]      = _salts[1];
+		record.page_size     = _page_size;
+		record.database_size = _load(_frames[commit].data.data() + 4);
+		for (auto& i : _frames) {
+			if (i.first > commit) {
+				break;
+			} else if (i.second.has_header && i.second.has_page) {
+				record.first_frame = record.first_frame ? record.first_frame : i.first;
+				++record.frame_count;
+			}
+		}
+
+		std::vector<std::uint8_t> data(record.size());
+		record.encode_header({ data.data(), data.size() });
+		auto output = data.data() + Wal_record::header_size;
+		for (auto& i : _frames) {
+			if (i.first > commit) {
+				break;
+			} else if (i.second.has_header && i.second.has_page) {
+				// the page number in little-endian followed by the page
+				const auto page = _load(i.second.data.data());
+				for (int j = 0; j < 4; ++j) {
+					*output++ = static_cast<std::uint8_t>(page >> (j * 8));
+				}
+				std::memcpy(output, i.second.data.data() + frame_header_size, _page_size);
+				output += _page_size;
+			}
+		}
+		_frames.clear();
+		_sink->ship({ data.data(), data.size() });
+	}
+	static std::uint64_t _now() noexcept
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		                                      std::chrono::system_clock::now().time_since_epoch())
+		                                      .count());
+	}
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,370 @@
+#include "wal_sink.hpp"
+
+#include "../error.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <cerrno>
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <poll.h>
+#	include <sys/socket.h>
+#	include <sys/un.h>
+#	include <unistd.h>
+#endif
+
+using namespace ysqlite3;
+using namespace ysqlite3::vfs;
+
+namespace {
+
+constexpr std::uint8_t magic[] = { 'Y', 'W', 'A', 'L' };
+
+std::mutex registry_mutex;
+std::map<std::string, std::weak_ptr<Wal_sink>> registry;
+
+template<typename Type>
+void store(std::uint8_t* buffer, Type value) noexcept
+{
+	for (std::size_t i = 0; i < sizeof(Type); ++i) {
+		buffer[i] = static_cast<std::uint8_t>(value >> (i * 8));
+	}
+}
+
+template<typename Type>
+Type load(const std::uint8_t* buffer) noexcept
+{
+	Type value = 0;
+	for (std::size_t i = 0; i < sizeof(Type); ++i) {
+		value |= static_cast<Type>(buffer[i]) << (i * 8);
+	}
+	return value;
+}
+
+inline std::system_error errno_error()
+{
+	return std::system_error{ errno, std::generic_category() };
+}
+
+} // namespace
+
+std::size_t Wal_record::size() const noexcept
+{
+	return header_size + frame_count * (std::size_t{ 4 } + page_size);
+}
+
+void Wal_record::encode_header(Span<std::uint8_t*> buffer) const noexcept
+{
+	const auto data = buffer.begin();
+	std::memcpy(data, magic, sizeof(magic));
+	store(data + 4, static_cast<std::uint32_t>(type));
+	store(data + 8, sequence);
+	store(data + 16, timestamp);
+	store(data + 24, checkpoint);
+	store(data + 28, salts[0]);
+	store(data + 32, salts[1]);
+	store(data + 36, page_size);
+	store(data + 40, first_frame);
+	store(data + 44, database_size);
+	store(data + 48, frame_count);
+	store(data + 52, std::uint32_t{ 0 });
+}
+
+bool Wal_record::decode_header(Span<const std::uint8_t*> buffer) noexcept
+{
+	const auto data = buffer.begin();
+	if (buffer.size() < header_size || std::memcmp(data, magic, sizeof(magic))) {
+		return false;
+	}
+
+	type          = static_cast<Type>(load<std::uint32_t>(data + 4));
+	sequence      = load<std::uint64_t>(data + 8);
+	timestamp     = load<std::uint64_t>(data + 16);
+	checkpoint    = load<std::uint32_t>(data + 24);
+	salts[0]      = load<std::uint32_t>(data + 28);
+	salts[1]      = load<std::uint32_t>(data + 32);
+	page_size     = load<std::uint32_t>(data + 36);
+	first_frame   = load<std::uint32_t>(data + 40);
+	database_size = load<std::uint32_t>(data + 44);
+	frame_count   = load<std::uint32_t>(data + 48);
+	return type == Type::commit || type == Type::restart;
+}
+
+void Wal_sink::ship(Span<std::uint8_t*> record)
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	auto sequence = _status.sequence + 1;
+	store(record.begin() + 8, sequence);
+	const auto delivered = deliver(record, sequence);
+	_status.sequence     = sequence;
+	if (delivered) {
+		++_status.records;
+		_status.bytes += record.size();
+	} else {
+		++_status.dropped;
+	}
+}
+
+Wal_sink_status Wal_sink::status()
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	return _status;
+}
+
+bool Wal_sink::claim_generation(const std::uint32_t (&salts)[2])
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	if (_claimed && _salts[0] == salts[0] && _salts[1] == salts[1]) {
+		return false;
+	}
+	_claimed  = true;
+	_salts[0] = salts[0];
+	_salts[1] = salts[1];
+	return true;
+}
+
+void Wal_sink::undelivered(std::size_t size) noexcept
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	--_status.records;
+	_status.bytes -= size;
+	++_status.dropped;
+}
+
+std::string ysqlite3::vfs::wal_record_name(std::uint64_t sequence)
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%020llu.ywal", static_cast<unsigned long long>(sequence));
+	return name;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+Directory_wal_sink::Directory_wal_sink(std::string directory) : _directory{ std::move(directory) }
+{
+	const auto dir = opendir(_directory.c_str());
+	if (!dir) {
+		throw errno_error();
+	}
+	closedir(dir);
+}
+
+bool Directory_wal_sink::deliver(Span<std::uint8_t*> record, std::uint64_t& sequence)
+{
+	// write a temporary file and link it to its final name which fails if the sequence number is taken
+	const auto temporary =
+	    _directory + "/.tmp-" + std::to_string(getpid()) + "-" + std::to_string(++_temporary);
+	const auto fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		throw errno_error();
+	}
+
+	const auto write_all = [&] {
+		for (std::size_t written = 0; written < record.size();) {
+			const auto n = pwrite(fd, record.begin() + written, record.size() - written, written);
+			if (n == -1 && errno != EINTR) {
+				return false;
+			}
+			written += n > 0 ? static_cast<std::size_t>(n) : 0;
+		}
+		return true;
+	};
+	auto success = write_all();
+	while (success) {
+		if (!link(temporary.c_str(), (_directory + "/" + wal_record_name(sequence)).c_str())) {
+			break;
+		} else if (errno != EEXIST) {
+			success = false;
+			break;
+		}
+
+		// another sink was faster; continue after the last record
+		if (const auto dir = opendir(_directory.c_str())) {
+			while (const auto entry = readdir(dir)) {
+				unsigned long long number = 0;
+				if (std::sscanf(entry->d_name, "%20llu.ywal", &number) == 1 && number >= sequence) {
+					sequence = number + 1;
+				}
+			}
+			closedir(dir);
+		}
+		store(record.begin() + 8, sequence);
+		success = write_all();
+	}
+
+	const auto error = errno;
+	close(fd);
+	unlink(temporary.c_str());
+	if (!success) {
+		throw std::system_error{ error, std::generic_category() };
+	}
+	return true;
+}
+
+Unix_socket_wal_sink::Unix_socket_wal_sink(std::string path) : _path{ std::move(path) }
+{
+	_sender = std::thread{ &Unix_socket_wal_sink::_run, this };
+}
+
+Unix_socket_wal_sink::~Unix_socket_wal_sink()
+{
+	{
+		std::lock_guard<std::mutex> lock{ _queue_mutex };
+		_stop = true;
+	}
+	_queued.notify_one();
+	_sender.join();
+	if (_socket != -1) {
+		close(_socket);
+	}
+}
+
+bool Unix_socket_wal_sink::deliver(Span<std::uint8_t*> record, std::uint64_t&)
+{
+	{
+		// never block the primary; a follower which cannot keep up loses records
+		std::lock_guard<std::mutex> lock{ _queue_mutex };
+		if (_queued_bytes && _queued_bytes + record.size() > max_queued_bytes) {
+			return false;
+		}
+		_queue.emplace_back(record.begin(), record.end());
+		_queued_bytes += record.size();
+	}
+	_queued.notify_one();
+	return true;
+}
+
+void Unix_socket_wal_sink::_run() noexcept
+{
+	std::unique_lock<std::mutex> lock{ _queue_mutex };
+	while (true) {
+		_queued.wait(lock, [this] { return _stop || !_queue.empty(); });
+		if (_queue.empty()) {
+			return;
+		}
+
+		const auto record = std::move(_queue.front());
+		_queue.pop_front();
+		_queued_bytes -= record.size();
+		lock.unlock();
+		if (!_send(record)) {
+			undelivered(record.size());
+		}
+		lock.lock();
+	}
+}
+
+bool Unix_socket_wal_sink::_send(const std::vector<std::uint8_t>& record) noexcept
+{
+	if (_socket == -1) {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (_path.size() >= sizeof(address.sun_path)) {
+			return false;
+		}
+		std::memcpy(address.sun_path, _path.c_str(), _path.size() + 1);
+
+		_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (_socket == -1) {
+			return false;
+		} else if (connect(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address))) {
+			close(_socket);
+			_socket = -1;
+			return false;
+		}
+	}
+
+	int flags = MSG_DONTWAIT;
+#	if defined(MSG_NOSIGNAL)
+	flags |= MSG_NOSIGNAL;
+#	endif
+	for (std::size_t sent = 0; sent < record.size();) {
+		const auto n = send(_socket, record.data() + sent, record.size() - sent, flags);
+		if (n >= 0) {
+			sent += static_cast<std::size_t>(n);
+			continue;
+		} else if (errno == EINTR) {
+			continue;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			// wait until the follower read something
+			pollfd descriptor{ _socket, POLLOUT, 0 };
+			const auto ready = ::poll(&descriptor, 1, stall_timeout);
+			if (ready > 0 || (ready == -1 && errno == EINTR)) {
+				continue;
+			}
+		}
+
+		// the follower discards the partial record of a closed connection
+		close(_socket);
+		_socket = -1;
+		return false;
+	}
+	return true;
+}
+
+#else
+
+Directory_wal_sink::Directory_wal_sink(std::string directory) : _directory{ std::move(directory) }
+{
+	throw std::system_error{ Error::bad_arguments, "directory sinks are not supported" };
+}
+
+bool Directory_wal_sink::deliver(Span<std::uint8_t*>, std::uint64_t&)
+{
+	return false;
+}
+
+Unix_socket_wal_sink::Unix_socket_wal_sink(std::string path) : _path{ std::move(path) }
+{
+	throw std::system_error{ Error::bad_arguments, "socket sinks are not supported" };
+}
+
+Unix_socket_wal_sink::~Unix_socket_wal_sink()
+{}
+
+bool Unix_socket_wal_sink::deliver(Span<std::uint8_t*>, std::uint64_t&)
+{
+	return false;
+}
+
+void Unix_socket_wal_sink::_run() noexcept
+{}
+
+bool Unix_socket_wal_sink::_send(const std::vector<std::uint8_t>&) noexcept
+{
+	return false;
+}
+
+#endif
+
+std::shared_ptr<Wal_sink> ysqlite3::vfs::open_wal_sink(const char* spec)
+{
+	std::lock_guard<std::mutex> lock{ registry_mutex };
+	const auto entry = registry.find(spec);
+	if (entry != registry.end()) {
+		if (auto sink = entry->second.lock()) {
+			return sink;
+		}
+	}
+
+	std::shared_ptr<Wal_sink> sink;
+	if (!std::strncmp(spec, "dir:", 4) && spec[4]) {
+		sink = std::make_shared<Directory_wal_sink>(spec + 4);
+	} else if (!std::strncmp(spec, "unix:", 5) && spec[5]) {
+		sink = std::make_shared<Unix_socket_wal_sink>(spec + 5);
+	} else {
+		throw std::system_error{ Error::bad_arguments, "bad WAL sink" };
+	}
+	registry[spec] = sink;
+	return sink;
+}
+
+std::shared_ptr<Wal_sink> ysqlite3::vfs::find_wal_sink(const char* spec)
+{
+	std::lock_guard<std::mutex> lock{ registry_mutex };
+	const auto entry = registry.find(spec);
+	return entry == registry.end() ? nullptr : entry->second.lock();
+}
@@ -0,0 +1,197 @@
+#ifndef YSQLITE3_VFS_WAL_SINK_HPP_
+#define YSQLITE3_VFS_WAL_SINK_HPP_
+
+#include "../span.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * The header of a record shipped from the WAL of a primary database. A record is either a committed
+ * transaction or a restart of the WAL. All values are encoded as little-endian; a commit record is followed
+ * by `frame_count` frames, each consisting of the page number (4 bytes) and the page content.
+ */
+struct Wal_record
+{
+	enum class Type : std::uint32_t
+	{
+		commit  = 1,
+		restart = 2
+	};
+
+	constexpr static std::size_t header_size = 56;
+
+	Type type = Type::commit;
+	/// Assigned by the sink; contiguous starting at 1.
+	std::uint64_t sequence = 0;
+	/// The commit time on the primary in microseconds since the epoch.
+	std::uint64_t timestamp  = 0;
+	std::uint32_t checkpoint = 0;
+	std::uint32_t salts[2]   = {};
+	std::uint32_t page_size  = 0;
+	/// The WAL frame number of the first frame (starting at 1).
+	std::uint32_t first_frame   = 0;
+	std::uint32_t database_size = 0;
+	std::uint32_t frame_count   = 0;
+
+	/// Returns the size of the encoded record including the frames.
+	std::size_t size() const noexcept;
+	void encode_header(Span<std::uint8_t*> buffer) const noexcept;
+	/**
+	 * Decodes a record header.
+	 *
+	 * @param buffer at least `header_size` bytes
+	 * @return `false` if the buffer does not contain a record header
+	 */
+	bool decode_header(Span<const std::uint8_t*> buffer) noexcept;
+};
+
+struct Wal_sink_status
+{
+	/// The last assigned sequence number.
+	std::uint64_t sequence = 0;
+	std::uint64_t records  = 0;
+	std::uint64_t bytes    = 0;
+	/// Records which could not be delivered; the followers have to start from a new copy.
+	std::uint64_t dropped = 0;
+};
+
+/// Receives the records of Wal_shipping_file. All methods are thread-safe.
+class Wal_sink
+{
+public:
+	virtual ~Wal_sink() = default;
+	/**
+	 * Assigns the next sequence number to the encoded record and delivers it.
+	 *
+	 * @exception std::system_error if the record could not be delivered and the sink cannot continue
+	 * @param record the encoded record; the sequence number is written into it
+	 */
+	void ship(Span<std::uint8_t*> record);
+	Wal_sink_status status();
+	/**
+	 * Claims the transactions already in a WAL generation for shipping them again. All connections of the
+	 * process share the sink, so only the first one scans the WAL.
+	 *
+	 * @param salts the salts of the WAL header which identify the generation
+	 * @return `true` if the generation was not claimed before
+	 */
+	bool claim_generation(const std::uint32_t (&salts)[2]);
+
+protected:
+	/**
+	 * Delivers the record; called with the lock held.
+	 *
+	 * @param record the encoded record
+	 * @param[in,out] sequence the proposed sequence number; may be increased if it is already taken
+	 * @return `false` if the record was dropped
+	 */
+	virtual bool deliver(Span<std::uint8_t*> record, std::uint64_t& sequence) = 0;
+	/**
+	 * Reports a record which deliver() accepted but which could not be delivered later.
+	 *
+	 * @param size the size of the record
+	 */
+	void undelivered(std::size_t size) noexcept;
+
+private:
+	std::mutex _mutex;
+	Wal_sink_status _status;
+	bool _claimed           = false;
+	std::uint32_t _salts[2] = {};
+};
+
+/**
+ * Writes every record to its own file `<sequence>.ywal` in a directory. Files are created atomically, so
+ * readers never see partial records and multiple processes can ship to the same directory.
+ */
+class Directory_wal_sink : public Wal_sink
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @exception std::system_error if the directory cannot be read
+	 * @param directory the directory
+	 */
+	Directory_wal_sink(std::string directory);
+
+protected:
+	bool deliver(Span<std::uint8_t*> record, std::uint64_t& sequence) override;
+
+private:
+	std::string _directory;
+	std::uint64_t _temporary = 0;
+};
+
+/**
+ * Streams the records to a Unix socket without blocking the primary. The records are queued and a background
+ * thread sends them as fast as the follower reads. A record is only dropped as a whole: if more than
+ * `max_queued_bytes` are waiting, if the follower is not reachable or if it does not read anything for
+ * `stall_timeout`. After a failure the connection is retried with the next record and the follower detects
+ * the gap in the sequence numbers.
+ */
+class Unix_socket_wal_sink : public Wal_sink
+{
+public:
+	/// Records are dropped while more bytes are waiting; a single larger record is still accepted.
+	constexpr static std::size_t max_queued_bytes = 64 * 1024 * 1024;
+	/// The milliseconds after which a follower which does not read is disconnected.
+	constexpr static int stall_timeout = 5000;
+
+	/**
+	 * Constructor. Connects when the first record is sent.
+	 *
+	 * @exception std::system_error if the sender thread could not be started
+	 * @param path the path of the socket
+	 */
+	Unix_socket_wal_sink(std::string path);
+	/// Sends the queued records and stops the sender thread.
+	~Unix_socket_wal_sink();
+
+protected:
+	bool deliver(Span<std::uint8_t*> record, std::uint64_t&) override;
+
+private:
+	std::string _path;
+	int _socket = -1;
+	std::mutex _queue_mutex;
+	std::condition_variable _queued;
+	std::deque<std::vector<std::uint8_t>> _queue;
+	std::size_t _queued_bytes = 0;
+	bool _stop                = false;
+	std::thread _sender;
+
+	void _run() noexcept;
+	/// Sends the whole record or closes the connection.
+	bool _send(const std::vector<std::uint8_t>& record) noexcept;
+};
+
+/**
+ * Returns the sink described by `spec`. Sinks with the same description are shared within the process.
+ *
+ * @exception std::system_error
+ *   - Error::bad_arguments if the description is invalid
+ *   - if the sink could not be created
+ * @param spec `dir:<path>` or `unix:<path>`
+ * @return the sink
+ */
+std::shared_ptr<Wal_sink> open_wal_sink(const char* spec);
+/// Returns the sink described by `spec` if it is open in this process.
+std::shared_ptr<Wal_sink> find_wal_sink(const char* spec);
+/// Returns the file name of the record in a directory sink.
+std::string wal_record_name(std::uint64_t sequence);
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,247 @@
+#include "working_set.hpp"
+
+#include "../error.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+using namespace ysqlite3;
+using namespace ysqlite3::vfs;
+
+namespace {
+
+/// The hash space of the sampling.
+constexpr std::uint32_t modulus = 1 << 24;
+constexpr std::size_t min_marks = 1024;
+
+std::uint32_t hash_page(std::uint64_t page) noexcept
+{
+	// the finalizer of MurmurHash3
+	page ^= page >> 33;
+	page *= 0xff51afd7ed558ccdULL;
+	page ^= page >> 33;
+	page *= 0xc4ceb9fe1a85ec53ULL;
+	page ^= page >> 33;
+	return static_cast<std::uint32_t>(page) & (modulus - 1);
+}
+
+std::size_t bucket_of(double distance) noexcept
+{
+	const auto n = static_cast<std::uint64_t>(distance);
+	if (n < 8) {
+		return static_cast<std::size_t>(n);
+	}
+
+	std::size_t exponent = 3;
+	while (n >> (exponent + 1)) {
+		++exponent;
+	}
+	return 8 * (exponent - 2) + static_cast<std::size_t>((n >> (exponent - 3)) & 7);
+}
+
+/// The smallest distance above the bucket.
+std::uint64_t bucket_end(std::size_t bucket) noexcept
+{
+	if (bucket < 8) {
+		return bucket + 1;
+	}
+	return static_cast<std::uint64_t>(8 + bucket % 8 + 1) << (bucket / 8 + 2 - 3);
+}
+
+} // namespace
+
+Working_set_estimator::Working_set_estimator(std::size_t max_samples)
+    : _max_samples{ std::max<std::size_t>(max_samples, 1) }
+{
+	reset();
+}
+
+void Working_set_estimator::record(std::uint64_t page)
+{
+	++_accesses;
+	const auto hash = hash_page(page);
+	if (hash >= _threshold) {
+		return;
+	}
+
+	const auto weight = static_cast<double>(modulus) / _threshold;
+	_total += weight;
+
+	const auto sample = _samples.find(page);
+	if (sample != _samples.end()) {
+		// the sampled pages accessed since the last access of this page
+		const auto distance = _count(_time) - _count(sample->second.time);
+		const auto bucket   = bucket_of(static_cast<double>(distance) * weight);
+		if (bucket >= _histogram.size()) {
+			_histogram.resize(bucket + 1);
+		}
+		_histogram[bucket] += weight;
+		_mark(sample->second.time, -1);
+		_samples.erase(sample);
+	} else {
+		_hashes.emplace(hash, page);
+	}
+
+	const auto time = _next_time();
+	_samples[page]  = { time, hash };
+	_mark(time, 1);
+	if (_samples.size() > _max_samples) {
+		_evict();
+	}
+}
+
+void Working_set_estimator::reset()
+{
+	_threshold = modulus;
+	_accesses  = 0;
+	_total     = 0;
+	_time      = 0;
+	_histogram.clear();
+	_samples.clear();
+	_hashes.clear();
+	_marks.assign(min_marks, 0);
+}
+
+std::uint64_t Working_set_estimator::accesses() const noexcept
+{
+	return _accesses;
+}
+
+double Working_set_estimator::sampling_rate() const noexcept
+{
+	return static_cast<double>(_threshold) / modulus;
+}
+
+std::uint64_t Working_set_estimator::pages() const noexcept
+{
+	return static_cast<std::uint64_t>(static_cast<double>(_samples.size()) / sampling_rate() + 0.5);
+}
+
+std::vector<Miss_ratio_point> Working_set_estimator::curve() const
+{
+	std::vector<Miss_ratio_point> curve;
+	if (!_total) {
+		return curve;
+	}
+
+	double hits = 0;
+	curve.reserve(_histogram.size());
+	for (std::size_t i = 0; i < _histogram.size(); ++i) {
+		hits += _histogram[i];
+		Miss_ratio_point point;
+		point.cache_pages = bucket_end(i);
+		point.miss_ratio  = std::max(1 - hits / _total, 0.0);
+		curve.push_back(point);
+	}
+	return curve;
+}
+
+void Working_set_estimator::_mark(std::uint64_t time, std::int32_t delta) noexcept
+{
+	for (; time <= _marks.size(); time += time & (~time + 1)) {
+		_marks[time - 1] += delta;
+	}
+}
+
+std::uint64_t Working_set_estimator::_count(std::uint64_t time) const noexcept
+{
+	std::uint64_t count = 0;
+	for (; time; time -= time & (~time + 1)) {
+		count += static_cast<std::uint64_t>(_marks[time - 1]);
+	}
+	return count;
+}
+
+std::uint64_t Working_set_estimator::_next_time()
+{
+	if (_time < _marks.size()) {
+		return ++_time;
+	}
+
+	// renumber the last accesses when the tree is full
+	std::vector<Sample*> order;
+	order.reserve(_samples.size());
+	for (auto& i : _samples) {
+		order.push_back(&i.second);
+	}
+	std::sort(order.begin(), order.end(), [](const Sample* a, const Sample* b) { return a->time < b->time; });
+
+	_marks.assign(std::max(order.size() * 2, min_marks), 0);
+	_time = 0;
+	for (const auto sample : order) {
+		sample->time = ++_time;
+		_mark(_time, 1);
+	}
+	return ++_time;
+}
+
+void Working_set_estimator::_evict()
+{
+	// lower the sampling rate until all pages with the largest hash are gone
+	_threshold = _hashes.rbegin()->first;
+	while (!_hashes.empty() && _hashes.rbegin()->first >= _threshold) {
+		const auto sample = _samples.find(_hashes.rbegin()->second);
+		_mark(sample->second.time, -1);
+		_samples.erase(sample);
+		_hashes.erase(std::prev(_hashes.end()));
+	}
+}
+
+std::vector<Miss_ratio_point> ysqlite3::vfs::working_set_curve(Database& database, const char* schema)
+{
+	auto statement   = database.prepare_statement(("PRAGMA \"" + std::string{ schema } + "\".working_set").c_str());
+	auto result      = statement.step();
+	const auto text  = result ? result.text(0) : nullptr;
+	const auto curve = text ? std::strstr(text, "curve=") : nullptr;
+	if (!curve) {
+		throw std::system_error{ Error::bad_result, "the working_set layer is not used" };
+	}
+
+	// pairs of cache pages and miss ratio
+	std::vector<Miss_ratio_point> points;
+	for (auto position = curve + 6; *position;) {
+		char* end = nullptr;
+		Miss_ratio_point point;
+		point.cache_pages = std::strtoull(position, &end, 10);
+		if (*end != ':') {
+			break;
+		}
+		point.miss_ratio = std::strtod(end + 1, &end);
+		points.push_back(point);
+		position = *end == ',' ? end + 1 : end;
+	}
+	return points;
+}
+
+std::uint64_t ysqlite3::vfs::tune_cache_size(Database& database, double hit_ratio, const char* schema)
+{
+	const auto curve   = working_set_curve(database, schema);
+	const auto quoted  = "\"" + std::string{ schema } + "\"";
+	const auto integer = [&](const std::string& sql) {
+		auto statement = database.prepare_statement(sql.c_str());
+		auto result    = statement.step();
+		if (!result) {
+			throw std::system_error{ Error::bad_result };
+		}
+		return result.integer(0);
+	};
+
+	// a negative cache size is given in KiB
+	const auto page_size = integer("PRAGMA " + quoted + ".page_size");
+	const auto size      = integer("PRAGMA " + quoted + ".cache_size");
+	auto pages           = static_cast<std::uint64_t>(size >= 0 ? size : -size * 1024 / page_size);
+	if (!curve.empty()) {
+		const auto point = std::find_if(curve.begin(), curve.end(), [hit_ratio](const Miss_ratio_point& x) {
+			return x.miss_ratio <= 1 - hit_ratio;
+		});
+		pages += point == curve.end() ? curve.back().cache_pages : point->cache_pages;
+	}
+
+	database.execute(("PRAGMA " + quoted + ".cache_size=" + std::to_string(pages) + ";PRAGMA " + quoted +
+	                  ".working_set=reset")
+	                     .c_str());
+	return pages;
+}
@@ -0,0 +1,113 @@
+#ifndef YSQLITE3_VFS_WORKING_SET_HPP_
+#define YSQLITE3_VFS_WORKING_SET_HPP_
+
+#include "../database.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+struct Miss_ratio_point
+{
+	/// The size of an LRU cache in pages.
+	std::uint64_t cache_pages = 0;
+	/// The expected fraction of accesses missing the cache.
+	double miss_ratio = 1;
+};
+
+/**
+ * Estimates the miss ratio curve of a page access stream from the reuse distances of its pages, that is the
+ * number of distinct pages accessed between two accesses of the same page. An LRU cache of `n` pages hits
+ * exactly the accesses with a reuse distance below `n`.
+ *
+ * Only a spatially hashed sample of the pages is tracked (SHARDS): a page is sampled if its hash is below a
+ * threshold, and the distances measured in the sample are scaled by the inverse sampling rate. The threshold
+ * is lowered whenever more than `max_samples` pages are sampled, so memory and time per access stay bounded
+ * for any database size. The distances are counted in buckets which are exact below 8 pages and have a
+ * relative width of 1/8 above.
+ *
+ * This class is not thread-safe.
+ */
+class Working_set_estimator
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param max_samples the maximum number of tracked pages
+	 */
+	explicit Working_set_estimator(std::size_t max_samples = 8192);
+	void record(std::uint64_t page);
+	void reset();
+	/// Returns the number of recorded accesses.
+	std::uint64_t accesses() const noexcept;
+	/// Returns the fraction of pages currently sampled.
+	double sampling_rate() const noexcept;
+	/// Returns the estimated number of distinct pages accessed.
+	std::uint64_t pages() const noexcept;
+	/**
+	 * Returns the miss ratio for every bucket boundary up to the largest observed reuse distance. The miss
+	 * ratio of larger caches is the ratio of the last point, caused by accesses of new pages.
+	 */
+	std::vector<Miss_ratio_point> curve() const;
+
+private:
+	struct Sample
+	{
+		std::uint64_t time;
+		std::uint32_t hash;
+	};
+
+	std::size_t _max_samples;
+	std::uint32_t _threshold;
+	std::uint64_t _accesses;
+	/// The weighted sampled accesses.
+	double _total;
+	/// The weighted reuse distances by bucket.
+	std::vector<double> _histogram;
+	std::unordered_map<std::uint64_t, Sample> _samples;
+	/// The sampled pages ordered by hash for lowering the threshold.
+	std::set<std::pair<std::uint32_t, std::uint64_t>> _hashes;
+	/// A Fenwick tree marking the time of the last access of every sampled page.
+	std::vector<std::int32_t> _marks;
+	std::uint64_t _time;
+
+	void _mark(std::uint64_t time, std::int32_t delta) noexcept;
+	std::uint64_t _count(std::uint64_t time) const noexcept;
+	std::uint64_t _next_time();
+	void _evict();
+};
+
+/**
+ * Returns the miss ratio curve of a database opened with the `working_set` layer.
+ *
+ * @exception std::system_error if the schema does not use the layer or see Database::prepare_statement()
+ * @param database the database
+ * @param schema the schema
+ * @return the curve
+ */
+std::vector<Miss_ratio_point> working_set_curve(Database& database, const char* schema = "main");
+/**
+ * Sizes the page cache of a connection from the miss ratio curve of the `working_set` layer and resets the
+ * estimator. The layer only sees the accesses which missed the current page cache, so the cache is grown by
+ * the size which reaches `hit_ratio` for those accesses; calling this periodically converges on the working
+ * set of the connection.
+ *
+ * @exception see working_set_curve() and Database::execute()
+ * @param database the database
+ * @param hit_ratio the desired hit ratio of the missing accesses between 0 and 1
+ * @param schema the schema
+ * @return the new cache size in pages
+ */
+std::uint64_t tune_cache_size(Database& database, double hit_ratio, const char* schema = "main");
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
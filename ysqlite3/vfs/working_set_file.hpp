@@ -0,0 +1,96 @@
+#ifndef YSQLITE3_VFS_WORKING_SET_FILE_HPP_
+#define YSQLITE3_VFS_WORKING_SET_FILE_HPP_
+
+#include "file.hpp"
+#include "working_set.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Estimates the working set of the main database from the pages read through the VFS, which are the pages
+ * missing the page cache of the connection. The estimator samples at most `working_set_samples` pages (URI
+ * parameter, default 8192).
+ *
+ * `PRAGMA working_set` returns the number of reads, the sampling rate, the estimated number of distinct pages
+ * and the miss ratio curve as `cache_pages:miss_ratio` pairs; `PRAGMA working_set=reset` starts over. See
+ * working_set_curve() and tune_cache_size() for the C++ interface.
+ *
+ * @note Pages read from the WAL are not seen.
+ */
+template<typename Parent>
+class Working_set_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	template<typename... Args>
+	Working_set_file(Args&&... args) : Parent{ std::forward<Args>(args)... }
+	{
+		if (this->format == File_format::main_db) {
+			const auto samples = sqlite3_uri_parameter(this->name, "working_set_samples");
+			_estimator.reset(new Working_set_estimator{ samples ? std::strtoull(samples, nullptr, 0) : 8192 });
+		}
+	}
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		Parent::read(buffer, offset);
+		_record(offset, buffer.size());
+	}
+	void fetch(sqlite3_int64 offset, int amount, void** buffer) override
+	{
+		Parent::fetch(offset, amount, buffer);
+		if (*buffer) {
+			_record(offset, static_cast<std::size_t>(amount));
+		}
+	}
+	void file_control(File_control operation, void* arg) override
+	{
+		if (_estimator && is_pragma(operation, arg, "working_set")) {
+			const auto value = pragma_value(arg);
+			if (value && !sqlite3_stricmp(value, "reset")) {
+				_estimator->reset();
+				set_pragma_result(arg, sqlite3_mprintf("ok"));
+				return;
+			}
+
+			std::string curve;
+			for (const auto& point : _estimator->curve()) {
+				char buffer[64];
+				sqlite3_snprintf(sizeof(buffer), buffer, "%s%llu:%.4f", curve.empty() ? "" : ",",
+				                 static_cast<unsigned long long>(point.cache_pages), point.miss_ratio);
+				curve += buffer;
+			}
+			set_pragma_result(arg, sqlite3_mprintf("reads=%llu rate=%.6f pages=%llu curve=%s",
+			                                       static_cast<unsigned long long>(_estimator->accesses()),
+			                                       _estimator->sampling_rate(),
+			                                       static_cast<unsigned long long>(_estimator->pages()),
+			                                       curve.c_str()));
+			return;
+		}
+		Parent::file_control(operation, arg);
+	}
+
+private:
+	std::unique_ptr<Working_set_estimator> _estimator;
+
+	/// Records whole page accesses; other reads like the one of the database header are ignored.
+	void _record(sqlite3_int64 offset, std::size_t size)
+	{
+		if (_estimator && size >= 512 && size <= 65536 && !(size & (size - 1)) &&
+		    !(offset % static_cast<sqlite3_int64>(size))) {
+			_estimator->record(static_cast<std::uint64_t>(offset) / size);
+		}
+	}
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
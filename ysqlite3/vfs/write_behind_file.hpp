@@ -0,0 +1,235 @@
+#ifndef YSQLITE3_VFS_WRITE_BEHIND_FILE_HPP_
+#define YSQLITE3_VFS_WRITE_BEHIND_FILE_HPP_
+
+#include "../error.hpp"
+#include "file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ysqlite3 {
+namespace vfs {
+
+/**
+ * Defers writes until the file is synced. Pending writes are kept sorted by offset and overlapping or
+ * adjacent writes are merged, so many small page writes reach the parent as few large sequential writes.
+ * Reads of pending data are served from the buffer.
+ *
+ * The buffer is flushed before every sync, unlock, checkpoint completion, fetch and close, which keeps the
+ * durability of the parent at every sync point. If the buffer grows beyond the URI parameter
+ * `write_behind_limit` (in bytes; default 16 MiB), it is flushed immediately.
+ *
+ * @note WAL files are not buffered, because other connections read new frames as soon as the WAL index
+ * was updated, which does not involve the VFS.
+ */
+template<typename Parent>
+class Write_behind_file : public Parent
+{
+public:
+	static_assert(std::is_base_of<File, Parent>::value, "Parent must derive File");
+
+	template<typename... Args>
+	Write_behind_file(Args&&... args) : Parent{ std::forward<Args>(args)... }
+	{
+		const auto limit = sqlite3_uri_int64(this->name, "write_behind_limit", 16 * 1024 * 1024);
+		_limit           = limit > 0 ? static_cast<std::size_t>(limit) : 0;
+	}
+	void close() override
+	{
+		try {
+			flush();
+		} catch (...) {
+			Parent::close();
+			throw;
+		}
+		Parent::close();
+	}
+	void read(Span<std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		const auto end = offset + static_cast<sqlite3_int64>(buffer.size());
+		auto run       = _first_run(offset, false);
+		if (run == _pending.end() || run->first >= end) {
+			Parent::read(buffer, offset);
+			return;
+		} else if (run->first <= offset && _end_of(run) >= end) {
+			std::memcpy(buffer.begin(), run->second.data() + (offset - run->first), buffer.size());
+			return;
+		}
+
+		// combine the parent data with the pending runs
+		const auto parent_size = Parent::file_size();
+		const auto from_parent = std::max<sqlite3_int64>(std::min(end, parent_size) - offset, 0);
+		if (from_parent) {
+			Parent::read(buffer.subspan(0, static_cast<std::size_t>(from_parent)), offset);
+		}
+		std::memset(buffer.begin() + from_parent, 0, buffer.size() - static_cast<std::size_t>(from_parent));
+		for (; run != _pending.end() && run->first < end; ++run) {
+			const auto first = std::max(offset, run->first);
+			const auto last  = std::min(end, _end_of(run));
+			std::memcpy(buffer.begin() + (first - offset), run->second.data() + (first - run->first),
+			            static_cast<std::size_t>(last - first));
+		}
+		if (end > std::max(parent_size, _pending_end())) {
+			throw std::system_error{ SQLite3_code::short_read };
+		}
+	}
+	void write(Span<const std::uint8_t*> buffer, sqlite3_int64 offset) override
+	{
+		if (this->format == File_format::wal || !_limit) {
+			Parent::write(buffer, offset);
+			return;
+		}
+
+		_buffer(buffer, offset);
+		if (_pending_bytes > _limit) {
+			flush();
+		}
+	}
+	void truncate(sqlite3_int64 size) override
+	{
+		// pending writes below the size are not affected by the truncation
+		auto run = _first_run(size, false);
+		if (run != _pending.end() && run->first < size) {
+			_pending_bytes -= static_cast<std::size_t>(_end_of(run) - size);
+			run->second.resize(static_cast<std::size_t>(size - run->first));
+			++run;
+		}
+		for (auto i = run; i != _pending.end(); ++i) {
+			_pending_bytes -= i->second.size();
+		}
+		_pending.erase(run, _pending.end());
+		Parent::truncate(size);
+	}
+	void sync(Sync_flag flag) override
+	{
+		flush();
+		Parent::sync(flag);
+	}
+	sqlite3_int64 file_size() const override
+	{
+		return std::max(Parent::file_size(), _pending_end());
+	}
+	void unlock(Lock_flag flag) override
+	{
+		flush();
+		Parent::unlock(flag);
+	}
+	void file_control(File_control operation, void* arg) override
+	{
+		// the checkpointer publishes the backfilled pages after this call
+		if (operation == File_control::checkpoint_done || operation == File_control::sync) {
+			flush();
+		}
+		Parent::file_control(operation, arg);
+	}
+	void fetch(sqlite3_int64 offset, int amount, void** buffer) override
+	{
+		flush();
+		Parent::fetch(offset, amount, buffer);
+	}
+	/// The pending data is not on disk yet.
+	int native_handle() const noexcept override
+	{
+		return -1;
+	}
+	/// Writes all pending data to the parent in ascending order.
+	void flush()
+	{
+		while (!_pending.empty()) {
+			const auto run = _pending.begin();
+			for (std::size_t i = 0; i < run->second.size(); i += max_write_size) {
+				const auto size = std::min(run->second.size() - i, static_cast<std::size_t>(max_write_size));
+				Parent::write({ run->second.data() + i, size }, run->first + static_cast<sqlite3_int64>(i));
+			}
+			_pending_bytes -= run->second.size();
+			_pending.erase(run);
+		}
+	}
+	/// Returns the amount of bytes waiting to be written.
+	std::size_t pending_bytes() const noexcept
+	{
+		return _pending_bytes;
+	}
+
+private:
+	typedef std::map<sqlite3_int64, std::vector<std::uint8_t>> Runs;
+
+	/// unixWrite() loops over short writes, but the unix VFS masks the size of every single write to 17 bits,
+	/// so writes of 128 KiB or more fail with SQLITE_FULL.
+	constexpr static std::size_t max_write_size = 64 * 1024;
+
+	/// Non-overlapping and non-adjacent runs of pending data.
+	Runs _pending;
+	std::size_t _pending_bytes = 0;
+	std::size_t _limit         = 0;
+
+	static sqlite3_int64 _end_of(typename Runs::const_iterator run) noexcept
+	{
+		return run->first + static_cast<sqlite3_int64>(run->second.size());
+	}
+	sqlite3_int64 _pending_end() const noexcept
+	{
+		return _pending.empty() ? 0 : _end_of(std::prev(_pending.end()));
+	}
+	/// Returns the first run which ends after `offset` (or at `offset` if `adjacent`).
+	typename Runs::iterator _first_run(sqlite3_int64 offset, bool adjacent) noexcept
+	{
+		auto run = _pending.upper_bound(offset);
+		if (run != _pending.begin()) {
+			const auto previous = std::prev(run);
+			if (_end_of(previous) > offset || (adjacent && _end_of(previous) == offset)) {
+				return previous;
+			}
+		}
+		return run;
+	}
+	void _buffer(Span<const std::uint8_t*> buffer, sqlite3_int64 offset)
+	{
+		const auto end = offset + static_cast<sqlite3_int64>(buffer.size());
+		auto first     = _first_run(offset, true);
+
+		// overwrite or append to a single run
+		if (first != _pending.end() && first->first <= offset) {
+			const auto next = std::next(first);
+			auto& data      = first->second;
+			if (end <= _end_of(first)) {
+				std::memcpy(data.data() + (offset - first->first), buffer.begin(), buffer.size());
+				return;
+			} else if (next == _pending.end() || next->first > end) {
+				_pending_bytes += static_cast<std::size_t>(end - _end_of(first));
+				data.resize(static_cast<std::size_t>(offset - first->first));
+				data.insert(data.end(), buffer.begin(), buffer.end());
+				return;
+			}
+		}
+
+		// merge all touched runs
+		auto start = offset;
+		auto stop  = end;
+		auto last  = first;
+		for (; last != _pending.end() && last->first <= end; ++last) {
+			start = std::min(start, last->first);
+			stop  = std::max(stop, _end_of(last));
+		}
+		std::vector<std::uint8_t> merged(static_cast<std::size_t>(stop - start));
+		for (auto i = first; i != last; ++i) {
+			std::memcpy(merged.data() + (i->first - start), i->second.data(), i->second.size());
+			_pending_bytes -= i->second.size();
+		}
+		std::memcpy(merged.data() + (offset - start), buffer.begin(), buffer.size());
+		_pending.erase(first, last);
+		_pending_bytes += merged.size();
+		_pending.emplace(start, std::move(merged));
+	}
+};
+
+} // namespace vfs
+} // namespace ysqlite3
+
+#endif
@@ -0,0 +1,154 @@
+#include "writer_queue.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+using namespace ysqlite3;
+
+Writer_queue::Writer_queue(Database database, Writer_queue_options options)
+    : _database{ std::move(database) }, _options{ options }
+{
+	if (!_database.is_open()) {
+		throw std::system_error{ Error::database_is_closed };
+	}
+	_thread = std::thread{ &Writer_queue::_run, this };
+}
+
+Writer_queue::~Writer_queue()
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_stop = true;
+	}
+	_queued.notify_one();
+	_thread.join();
+}
+
+std::future<void> Writer_queue::submit(Write write)
+{
+	const auto promise = std::make_shared<std::promise<void>>();
+	auto future        = promise->get_future();
+	submit(std::move(write), [promise](std::exception_ptr error) {
+		if (error) {
+			promise->set_exception(error);
+		} else {
+			promise->set_value();
+		}
+	});
+	return future;
+}
+
+void Writer_queue::submit(Write write, Callback done)
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_submissions.push_back({ std::move(write), std::move(done) });
+		++_status.submissions;
+	}
+	_queued.notify_one();
+}
+
+std::future<std::size_t> Writer_queue::submit_statement(std::string sql, Binder bind)
+{
+	const auto changes = std::make_shared<std::size_t>(0);
+	const auto promise = std::make_shared<std::promise<std::size_t>>();
+	auto future        = promise->get_future();
+	submit(
+	    [sql, bind, changes](Database& database) {
+		    auto statement = database.prepare_cached(sql.c_str());
+		    if (bind) {
+			    bind(statement);
+		    }
+		    statement.finish();
+		    *changes = static_cast<std::size_t>(sqlite3_changes(database.handle()));
+	    },
+	    [promise, changes](std::exception_ptr error) {
+		    if (error) {
+			    promise->set_exception(error);
+		    } else {
+			    promise->set_value(*changes);
+		    }
+	    });
+	return future;
+}
+
+Writer_queue_status Writer_queue::status() const
+{
+	std::lock_guard<std::mutex> lock{ _mutex };
+	auto status   = _status;
+	status.queued = _submissions.size();
+	return status;
+}
+
+void Writer_queue::_run() noexcept
+{
+	const auto max_batch = std::max<std::size_t>(_options.max_batch, 1);
+	std::vector<Submission> batch;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_queued.wait(lock, [this] { return _stop || !_submissions.empty(); });
+			if (_submissions.empty()) {
+				return;
+			}
+
+			// waits for more submissions to share the commit
+			if (!_stop && _options.max_latency.count()) {
+				_queued.wait_for(lock, _options.max_latency,
+				                 [&] { return _stop || _submissions.size() >= max_batch; });
+			}
+			const auto size = std::min(_submissions.size(), max_batch);
+			for (std::size_t i = 0; i < size; ++i) {
+				batch.push_back(std::move(_submissions.front()));
+				_submissions.pop_front();
+			}
+		}
+
+		_commit(batch);
+		batch.clear();
+	}
+}
+
+void Writer_queue::_commit(std::vector<Submission>& batch) noexcept
+{
+	std::vector<std::exception_ptr> errors(batch.size());
+	Transaction_status transaction{};
+	std::exception_ptr error;
+	try {
+		// only a busy BEGIN or COMMIT runs the batch again
+		run_transaction(
+		    _database, Transaction_mode::immediate,
+		    [&](Database& database) {
+			    for (std::size_t i = 0; i < batch.size(); ++i) {
+				    errors[i] = nullptr;
+				    try {
+					    // the savepoint only rolls back this submission
+					    run_transaction(database, Transaction_mode::deferred, batch[i].write);
+				    } catch (...) {
+					    errors[i] = std::current_exception();
+					    // for example SQLITE_FULL rolls back the whole transaction
+					    if (sqlite3_get_autocommit(database.handle())) {
+						    throw;
+					    }
+				    }
+			    }
+		    },
+		    _options.retry, &transaction);
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	std::size_t failed = 0;
+	for (std::size_t i = 0; i < batch.size(); ++i) {
+		const auto result = error ? error : errors[i];
+		failed += result != nullptr;
+		batch[i].done(result);
+	}
+
+	std::lock_guard<std::mutex> lock{ _mutex };
+	_status.failed += failed;
+	_status.retries += transaction.retries;
+	_status.largest_batch = std::max(_status.largest_batch, batch.size());
+	++_status.batches;
+}
@@ -0,0 +1,117 @@
+#ifndef YSQLITE3_WRITER_QUEUE_HPP_
+#define YSQLITE3_WRITER_QUEUE_HPP_
+
+#include "database.hpp"
+#include "transaction.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ysqlite3 {
+
+struct Writer_queue_options
+{
+	/// The most submissions committed by one transaction.
+	std::size_t max_batch = 256;
+	/// How long the writer waits for more submissions after the first one of a batch; 0 only takes the ones
+	/// already queued.
+	std::chrono::microseconds max_latency{ 0 };
+	/// The backoff if another process holds the write lock.
+	Retry_options retry;
+};
+
+struct Writer_queue_status
+{
+	std::uint64_t submissions = 0;
+	/// The submissions which failed, including those of failed commits.
+	std::uint64_t failed  = 0;
+	std::uint64_t batches = 0;
+	/// The times a batch was run again because the database was busy, also for batches which failed at last.
+	std::uint64_t retries = 0;
+	std::size_t largest_batch = 0;
+	std::size_t queued        = 0;
+};
+
+/**
+ * Serializes the writes of many threads through one connection and its own thread. The writer takes up to
+ * `max_batch` queued submissions and runs them in one `BEGIN IMMEDIATE` transaction with run_transaction(),
+ * so they share one commit and no thread of this process waits for the file lock of another.
+ *
+ * Every submission runs in its own savepoint: if it throws, even with SQLITE_BUSY or SQLITE_LOCKED, only its
+ * writes are rolled back and the others are still committed, unless SQLite rolled back the whole transaction.
+ * A submission learns about its result only after the commit; if the commit fails, all submissions of the
+ * batch fail. If `BEGIN` or `COMMIT` is busy because of another process, the whole batch runs again, so a
+ * submission may run more than once.
+ */
+class Writer_queue
+{
+public:
+	/// Writes with the connection; it must not end the transaction.
+	typedef std::function<void(Database&)> Write;
+	typedef std::function<void(Statement&)> Binder;
+	/// Called on the writer thread after the commit; it must not throw and must not wait for this queue.
+	typedef std::function<void(std::exception_ptr)> Callback;
+
+	/**
+	 * Starts the writer thread.
+	 *
+	 * @exception std::system_error Error::database_is_closed if the database is not open
+	 * @param database the open database; it is only used by the writer thread from now on
+	 * @param options the batching options
+	 */
+	Writer_queue(Database database, Writer_queue_options options = {});
+	Writer_queue(const Writer_queue& copy) = delete;
+	/// Commits the queued submissions and joins the writer thread.
+	~Writer_queue();
+	/**
+	 * Queues a write.
+	 *
+	 * @param write the write
+	 * @return the future which holds the exception of the write or the commit
+	 */
+	std::future<void> submit(Write write);
+	void submit(Write write, Callback done);
+	/**
+	 * Queues a statement.
+	 *
+	 * @param sql the SQL statement; it is cached by the statement cache of the connection
+	 * @param bind (opt) binds the parameters on the writer thread
+	 * @return the future of the rows changed by the statement
+	 */
+	std::future<std::size_t> submit_statement(std::string sql, Binder bind = nullptr);
+	Writer_queue_status status() const;
+	Writer_queue& operator=(const Writer_queue& copy) = delete;
+
+private:
+	struct Submission
+	{
+		Write write;
+		Callback done;
+	};
+
+	Database _database;
+	const Writer_queue_options _options;
+	mutable std::mutex _mutex;
+	std::condition_variable _queued;
+	std::deque<Submission> _submissions;
+	bool _stop = false;
+	Writer_queue_status _status;
+	std::thread _thread;
+
+	void _run() noexcept;
+	void _commit(std::vector<Submission>& batch) noexcept;
+};
+
+} // namespace ysqlite3
+
+#endif